@@ -0,0 +1,9 @@
+//Input
+layout (location = 0) in vec4 colorIn;
+//Output
+layout (location = 0) out vec4 fragColor;
+
+void main()
+{
+    fragColor = colorIn;
+}
@@ -0,0 +1,29 @@
+//Input
+layout(std430, binding = 1) buffer ParticleSBO
+{
+    ParticleInstance particles[];
+};
+
+uniform mat4 orthoProjection;
+
+//Output
+layout (location = 0) out vec4 colorOut;
+
+void main()
+{
+    ParticleInstance particle = particles[gl_InstanceID];
+
+    // One pixel quad
+    vec2 corners[6] =
+    {
+        vec2(0.0, 0.0), // Top Left
+        vec2(0.0, 1.0), // Bottom Left
+        vec2(1.0, 0.0), // Top Right
+        vec2(1.0, 0.0), // Top Right
+        vec2(0.0, 1.0), // Bottom Left
+        vec2(1.0, 1.0)  // Bottom Right
+    };
+
+    gl_Position = orthoProjection * vec4(particle.pos + corners[gl_VertexID], 0.0, 1.0);
+    colorOut = unpackUnorm4x8(uint(particle.color));
+}
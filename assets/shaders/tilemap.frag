@@ -0,0 +1,44 @@
+//Input
+layout (location = 0) in vec2 worldPosIn;
+//Output
+layout (location = 0) out vec4 fragColor;
+//Bindings
+layout (location = 0) uniform sampler2D textureAtlas;
+uniform usampler2D tilemap;
+uniform usampler2D lightmap;
+uniform int useLighting;
+uniform int tileSize;
+uniform ivec2 materialAtlasOrigins[MAX_TILE_MATERIALS];
+
+void main()
+{
+    ivec2 pixel = ivec2(floor(worldPosIn));
+    ivec2 tilePos = pixel / tileSize;
+
+    // The tilemap is stored column by column, so x and y are swapped
+    uvec2 tile = texelFetch(tilemap, tilePos.yx, 0).rg;
+    int materialID = int(tile.r);
+    int neighbourMask = int(tile.g);
+
+    // Air
+    if(materialID == 0)
+    {
+        discard;
+    }
+
+    ivec2 variant = ivec2(neighbourMask % TILESET_COLUMNS, neighbourMask / TILESET_COLUMNS) * tileSize;
+    ivec2 atlasPos = materialAtlasOrigins[materialID] + variant + (pixel - tilePos * tileSize);
+
+    vec4 textureColor = texelFetch(textureAtlas, atlasPos, 0);
+    if(textureColor.a == 0.0)
+    {
+        discard;
+    }
+
+    if(bool(useLighting))
+    {
+        uint lightLevel = texelFetch(lightmap, tilePos.yx, 0).r;
+        textureColor.rgb *= float(lightLevel) / float(MAX_LIGHT_LEVEL);
+    }
+    fragColor = textureColor;
+}
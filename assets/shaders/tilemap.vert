@@ -0,0 +1,24 @@
+uniform mat4 orthoProjection;
+uniform vec2 layerSize; // In pixels
+
+//Output
+layout (location = 0) out vec2 worldPosOut;
+
+void main()
+{
+    // One quad covering the whole tile layer
+    vec2 corners[6] =
+    {
+        vec2(0.0, 0.0), // Top Left
+        vec2(0.0, 1.0), // Bottom Left
+        vec2(1.0, 0.0), // Top Right
+        vec2(1.0, 0.0), // Top Right
+        vec2(0.0, 1.0), // Bottom Left
+        vec2(1.0, 1.0)  // Bottom Right
+    };
+
+    vec2 worldPos = corners[gl_VertexID] * layerSize;
+    gl_Position = orthoProjection * vec4(worldPos, 0.0, 1.0);
+
+    worldPosOut = worldPos;
+}
@@ -2,6 +2,7 @@
 
 timestamp=$(date +%s)
 
+# Add -DFIXED_SIMULATION to run movement in 16.16 fixed point
 defines="-DENGINE"
 libs="-luser32 -lopengl32 -lgdi32 -lole32"
 warnings="-Wno-writable-strings -Wno-format-security -Wno-deprecated-declarations -Wno-switch"
@@ -12,3 +13,14 @@ clang++ $includes -g src/main.cpp -o vaultsBelow.exe $libs $warnings $defines
 rm -f game_*
 clang++ -g "src/game/game.cpp" -shared -o game_$timestamp.dll $warnings $defines
 mv game_$timestamp.dll game.dll
+
+# Headless benchmarks, not needed to run the game. Add -DBENCH_WORLD_TILES=2048 for a bigger world
+# clang++ $includes -O2 src/particles_bench.cpp -o particlesBench.exe $warnings $defines
+# clang++ $includes -O2 src/move_bench.cpp -o moveBench.exe $warnings $defines
+# clang++ $includes -O2 src/chunk_bench.cpp -o chunkBench.exe $warnings $defines
+# clang++ $includes -O2 src/region_bench.cpp -o regionBench.exe $warnings $defines
+# clang++ $includes -O2 src/raycast_bench.cpp -o raycastBench.exe $warnings $defines
+# clang++ $includes -O2 src/determinism_bench.cpp -o determinismBench.exe $warnings $defines -DFIXED_SIMULATION
+# clang++ $includes -O2 src/pathfinding_bench.cpp -o pathfindingBench.exe $warnings $defines
+# clang++ $includes -O2 src/flowfield_bench.cpp -o flowfieldBench.exe $warnings $defines
+# clang++ $includes -O2 src/atlas_bench.cpp -o atlasBench.exe $warnings $defines
@@ -0,0 +1,172 @@
+// Headless atlas check. Loads the texture atlas the renderer uses and makes sure every
+// cell the game points at has something to draw, an empty cell renders as nothing:
+//   atlasBench.exe
+#include "bench_utils.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+const char *ATLAS_PATH = "assets/textures/Texture_Atlas.png";
+
+static unsigned char *atlas;
+static int atlasWidth, atlasHeight;
+
+//? Counts the texels of a rect in the atlas that aren't fully transparent
+int count_opaque_texels(IVec2 offset, IVec2 size)
+{
+    if (offset.x < 0 || offset.y < 0 || offset.x + size.x > atlasWidth || offset.y + size.y > atlasHeight)
+    {
+        return 0;
+    }
+
+    int opaqueCount = 0;
+    for (int y = offset.y; y < offset.y + size.y; y++)
+    {
+        for (int x = offset.x; x < offset.x + size.x; x++)
+        {
+            if (atlas[(y * atlasWidth + x) * 4 + 3] > 0)
+            {
+                opaqueCount++;
+            }
+        }
+    }
+    return opaqueCount;
+}
+
+//? Every variant of every solid material has to draw something
+int check_tilesets()
+{
+    int failures = 0;
+    for (int materialIdx = 0; materialIdx < MATERIAL_COUNT; materialIdx++)
+    {
+        if (!materialTable.collides[materialIdx])
+        {
+            continue;
+        }
+        for (int variant = 0; variant < TILE_VARIANT_COUNT; variant++)
+        {
+            IVec2 offset = materialTable.atlasOffsets[materialIdx][variant];
+            if (count_opaque_texels(offset, {8, 8}) == 0)
+            {
+                printf("Material %d variant %d at {%d, %d} is empty\n", materialIdx, variant, offset.x, offset.y);
+                failures++;
+            }
+            // Walls and the covering variants that hide them can't have holes
+            else if ((variant >= FIRST_COVERING_VARIANT || variant == WALL_VARIANT) &&
+                     count_opaque_texels(offset, {8, 8}) < 8 * 8)
+            {
+                printf("Material %d variant %d at {%d, %d} has holes\n", materialIdx, variant, offset.x, offset.y);
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+// Drawn stretched over an area that has to look filled
+static const SpriteID fillSprites[] = {SPRITE_WATER, SPRITE_LAVA, SPRITE_BULLET, SPRITE_MINIMAP_CELL};
+
+//? Every sprite has to draw something, the fill sprites everywhere
+int check_sprites()
+{
+    int failures = 0;
+    for (int spriteID = 0; spriteID < SPRITE_COUNT; spriteID++)
+    {
+        Sprite sprite = get_sprite((SpriteID)spriteID);
+        IVec2 size = {sprite.spriteSize.x * sprite.frameCount, sprite.spriteSize.y};
+        if (count_opaque_texels(sprite.atlasOffset, size) == 0)
+        {
+            printf("Sprite %d at {%d, %d} is empty\n", spriteID, sprite.atlasOffset.x, sprite.atlasOffset.y);
+            failures++;
+        }
+    }
+    // Overlays are drawn over the whole tile, the tile has to show through
+    for (int materialIdx = 0; materialIdx < MATERIAL_COUNT; materialIdx++)
+    {
+        SpriteID overlaySprite = materialTable.overlaySprite[materialIdx];
+        Sprite sprite = get_sprite(overlaySprite);
+        if (overlaySprite != SPRITE_BLANK &&
+            count_opaque_texels(sprite.atlasOffset, sprite.spriteSize) == sprite.spriteSize.x * sprite.spriteSize.y)
+        {
+            printf("Overlay of material %d hides the whole tile\n", materialIdx);
+            failures++;
+        }
+    }
+    for (SpriteID spriteID : fillSprites)
+    {
+        Sprite sprite = get_sprite(spriteID);
+        if (count_opaque_texels(sprite.atlasOffset, sprite.spriteSize) < sprite.spriteSize.x * sprite.spriteSize.y)
+        {
+            printf("Fill sprite %d at {%d, %d} has holes\n", spriteID, sprite.atlasOffset.x, sprite.atlasOffset.y);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+//? Builds the first chunk with a stone wall behind air and one behind a buried tile, the
+//? first has to be drawn with texels and the second hidden by a tile without holes
+int check_walls()
+{
+    memset((void *)gameState->worldGrid, 0, sizeof(gameState->worldGrid));
+    memset((void *)gameState->wallGrid, 0, sizeof(gameState->wallGrid));
+    for (int x = 4; x < 7; x++)
+    {
+        for (int y = 4; y < 7; y++)
+        {
+            gameState->worldGrid[x][y].material = MATERIAL_STONE;
+        }
+    }
+    gameState->wallGrid[1][1] = MATERIAL_STONE;
+    gameState->wallGrid[5][5] = MATERIAL_STONE;
+    refresh_world();
+
+    int failures = 0;
+    RenderRegion &region = renderData->regions[0];
+    if (region.walls.count != 1 || region.hiddenWalls != 1)
+    {
+        printf("Expected 1 drawn and 1 hidden wall, got %d and %d\n", region.walls.count, region.hiddenWalls);
+        return 1;
+    }
+
+    RenderTransform &wall = region.walls[0];
+    IVec2 wallPos = get_tile_pos(1, 1);
+    if ((int)wall.pos.x != wallPos.x || (int)wall.pos.y != wallPos.y ||
+        count_opaque_texels(wall.atlasOffset, wall.spriteSize) < wall.spriteSize.x * wall.spriteSize.y)
+    {
+        printf("The wall behind air doesn't draw a full tile\n");
+        failures++;
+    }
+
+    Tile &cover = gameState->worldGrid[5][5];
+    if (count_opaque_texels(materialTable.atlasOffsets[cover.material][cover.neighbourMask], {8, 8}) < 8 * 8)
+    {
+        printf("The tile hiding a wall, variant %d, lets it show through\n", cover.neighbourMask);
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    if (!bench_init())
+    {
+        return -1;
+    }
+    int channels;
+    atlas = stbi_load(ATLAS_PATH, &atlasWidth, &atlasHeight, &channels, 4);
+    if (!atlas)
+    {
+        LOG_ERROR("Failed to load %s", ATLAS_PATH);
+        return -1;
+    }
+
+    int failures = check_tilesets() + check_sprites() + check_walls();
+    if (failures)
+    {
+        printf("%d atlas checks failed\n", failures);
+        return 1;
+    }
+    printf("Every atlas cell the game uses has texels\n");
+    return 0;
+}
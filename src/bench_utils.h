@@ -0,0 +1,156 @@
+// Shared setup of the headless benchmarks. They build the whole game as one
+// translation unit, without a window or GPU, and get a bigger world with
+//   -DBENCH_WORLD_TILES=2048
+#pragma once
+
+#include "game/game.cpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <psapi.h>
+#endif
+
+constexpr int BENCH_TRANSIENT_SIZE = MB(64);
+
+static BumpAllocator benchTransientStorage;
+static uint32_t benchSeed = 0x9E3779B9u;
+
+//? Allocates what the platform layer would, returns false if it doesn't fit
+bool bench_init()
+{
+    gameState = (GameState *)calloc(1, sizeof(GameState));
+    renderData = (RenderData *)calloc(1, sizeof(RenderData));
+    if (!gameState || !renderData)
+    {
+        LOG_ERROR("Failed to allocate GameState");
+        return false;
+    }
+
+    benchTransientStorage = make_bump_allocator(BENCH_TRANSIENT_SIZE);
+    if (!benchTransientStorage.memory)
+    {
+        LOG_ERROR("Failed to allocate transient storage");
+        return false;
+    }
+    gameState->transientStorage = &benchTransientStorage;
+    renderData->gameCamera.zoom = 1.0f;
+    init_material_table();
+    return true;
+}
+
+//? Next number of the benchmark's own xorshift, the same on every platform
+uint32_t bench_random()
+{
+    benchSeed ^= benchSeed << 13;
+    benchSeed ^= benchSeed >> 17;
+    benchSeed ^= benchSeed << 5;
+    return benchSeed;
+}
+
+//? Caves carved by a few rounds of cellular automata, under a dirt layer and
+//? a wavy surface, with coal and gold in the stone and bedrock at the bottom
+void bench_generate_cave(uint32_t seed)
+{
+    benchSeed = seed ? seed : 1;
+    int count = WORLD_GRID.x * WORLD_GRID.y;
+    uint8_t *rock = (uint8_t *)malloc(count);
+    uint8_t *next = (uint8_t *)malloc(count);
+    for (int idx = 0; idx < count; idx++)
+    {
+        rock[idx] = bench_random() % 100 < 45;
+    }
+
+    // A cell turns into rock when most of its neighbours are, the world's edge counts as rock
+    for (int round = 0; round < 4; round++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            for (int x = 0; x < WORLD_GRID.x; x++)
+            {
+                int neighbours = 0;
+                for (int offsetY = -1; offsetY <= 1; offsetY++)
+                {
+                    for (int offsetX = -1; offsetX <= 1; offsetX++)
+                    {
+                        int neighbourX = x + offsetX;
+                        int neighbourY = y + offsetY;
+                        bool outside = neighbourX < 0 || neighbourY < 0 ||
+                                       neighbourX >= WORLD_GRID.x || neighbourY >= WORLD_GRID.y;
+                        neighbours += outside ? 1 : rock[neighbourY * WORLD_GRID.x + neighbourX];
+                    }
+                }
+                next[y * WORLD_GRID.x + x] = neighbours >= 5;
+            }
+        }
+        uint8_t *swap = rock;
+        rock = next;
+        next = swap;
+    }
+
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        int surface = WORLD_GRID.y / 8 + (int)(6.0f * sinf(x * 0.05f));
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            MaterialID material = MATERIAL_STONE;
+            if (y >= WORLD_GRID.y - 2)
+            {
+                material = MATERIAL_BEDROCK;
+            }
+            else if (y < surface || (y > surface + 10 && !rock[y * WORLD_GRID.x + x]))
+            {
+                material = MATERIAL_AIR;
+            }
+            else if (y < surface + 12)
+            {
+                material = MATERIAL_DIRT;
+            }
+            else
+            {
+                uint32_t ore = bench_random() % 100;
+                material = ore < 3 ? MATERIAL_COAL : ore < 4 ? MATERIAL_GOLD : MATERIAL_STONE;
+            }
+            gameState->worldGrid[x][y].material = material;
+        }
+    }
+    free(rock);
+    free(next);
+
+    refresh_world();
+}
+
+//? Milliseconds since start
+double bench_ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//? Memory of the process that is in RAM right now, 0 where that is unknown
+long long bench_rss_kb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters = {};
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.WorkingSetSize / 1024;
+#else
+    long long totalPages = 0;
+    long long residentPages = 0;
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file)
+    {
+        return 0;
+    }
+    if (fscanf(file, "%lld %lld", &totalPages, &residentPages) != 2)
+    {
+        residentPages = 0;
+    }
+    fclose(file);
+    return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
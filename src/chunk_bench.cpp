@@ -0,0 +1,112 @@
+// Headless benchmark of the chunk encoding. Encodes every chunk of a generated cave and
+// of random noise (the worst case) into a stream and decodes them again, then prints the
+// bytes per chunk and how fast both ways are. Materials count one byte per tile:
+//   chunkBench.exe
+#include "bench_utils.h"
+
+constexpr int CHUNK_BENCH_REPEATS = 8;
+
+//? Fills the world with materials picked at random, no runs and full palettes
+void generate_noise()
+{
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            gameState->worldGrid[x][y].material = (MaterialID)(bench_random() % MATERIAL_COUNT);
+        }
+    }
+}
+
+void bench_world(const char *name, uint8_t *materials, WorldLayers &layers)
+{
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            materials[x * WORLD_GRID.y + y] = gameState->worldGrid[x][y].material;
+        }
+    }
+
+    BumpAllocator &transientStorage = *gameState->transientStorage;
+    transientStorage.used = 0;
+    ByteWriter writer = make_byte_writer(&transientStorage, CHUNK_COUNT * MAX_ENCODED_CHUNK_SIZE);
+    if (writer.overflow)
+    {
+        LOG_ERROR("The encoded world doesn't fit into the transient storage, %d bytes",
+                  CHUNK_COUNT * MAX_ENCODED_CHUNK_SIZE);
+        return;
+    }
+
+    // Which of the three encodings each chunk picked, it is the first byte
+    int encodings[CHUNK_ENCODING_RLE + 1] = {};
+    double encodeMs = 0.0;
+    for (int repeat = 0; repeat < CHUNK_BENCH_REPEATS; repeat++)
+    {
+        writer.size = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int idx = 0; idx < CHUNK_COUNT; idx++)
+        {
+            int offset = writer.size;
+            encode_chunk(writer, {idx % CHUNK_GRID.x, idx / CHUNK_GRID.x});
+            if (repeat == 0 && writer.data[offset] <= CHUNK_ENCODING_RLE)
+            {
+                encodings[writer.data[offset]]++;
+            }
+        }
+        encodeMs += bench_ms_since(start);
+    }
+
+    double decodeMs = 0.0;
+    bool decoded = true;
+    for (int repeat = 0; repeat < CHUNK_BENCH_REPEATS; repeat++)
+    {
+        ByteReader reader = make_byte_reader(writer.data, writer.size);
+        auto start = std::chrono::steady_clock::now();
+        for (int idx = 0; idx < CHUNK_COUNT; idx++)
+        {
+            decoded &= decode_chunk(reader, {idx % CHUNK_GRID.x, idx / CHUNK_GRID.x}, layers);
+        }
+        decodeMs += bench_ms_since(start);
+        decoded &= reader.pos == reader.size;
+    }
+
+    int changed = 0;
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            changed += materials[x * WORLD_GRID.y + y] != layers.tiles[x][y];
+        }
+    }
+
+    // Megabytes of tiles, at a byte a tile
+    double tileMB = (double)WORLD_GRID.x * WORLD_GRID.y * CHUNK_BENCH_REPEATS / (1024.0 * 1024.0);
+    printf("%s %dx%d: %.1f bytes per chunk of %d tiles, %d single material, %d packed, %d runs\n", name,
+           WORLD_GRID.x, WORLD_GRID.y, (double)writer.size / CHUNK_COUNT, CHUNK_TILE_COUNT, encodings[CHUNK_ENCODING_UNIFORM],
+           encodings[CHUNK_ENCODING_PACKED], encodings[CHUNK_ENCODING_RLE]);
+    printf("  encode %.0f MB/s, decode %.0f MB/s, decoded %d, %d tiles differ\n", tileMB / (encodeMs / 1000.0),
+           tileMB / (decodeMs / 1000.0), decoded, changed);
+}
+
+int main()
+{
+    if (!bench_init())
+    {
+        return -1;
+    }
+    uint8_t *materials = (uint8_t *)malloc(WORLD_GRID.x * WORLD_GRID.y);
+    WorldLayers *layers = (WorldLayers *)malloc(sizeof(WorldLayers));
+    if (!materials || !layers)
+    {
+        LOG_ERROR("Failed to allocate the decoded world");
+        return -1;
+    }
+
+    bench_generate_cave(3);
+    bench_world("Cave", materials, *layers);
+
+    generate_noise();
+    bench_world("Noise", materials, *layers);
+    return 0;
+}
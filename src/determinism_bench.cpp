@@ -0,0 +1,135 @@
+// Headless determinism check. Plays the same scripted input into the game twice and
+// compares simulation_checksum() after every tick, the runs have to stay identical.
+// Build it with -DFIXED_SIMULATION as well, that is the mode meant to hold across machines:
+//   determinismBench.exe 100000
+#include "bench_utils.h"
+
+constexpr uint32_t DETERMINISM_BENCH_SEED = 1234;
+
+//? Holds a key down or lets it go, a key that goes down this tick was just pressed
+void bench_set_key(KeyCodeID keyCode, bool down)
+{
+    Key &key = input->keys[keyCode];
+    key.justPressed = down && !key.isDown;
+    key.justReleased = !down && key.isDown;
+    key.isDown = down;
+}
+
+//? Walks, jumps, shoots, pours water and builds walls at random, the same for every run
+void script_input(int &walkTicks, KeyCodeID &walkKey)
+{
+    if (walkTicks-- <= 0)
+    {
+        KeyCodeID walkKeys[] = {KEY_A, KEY_D, KEY_COUNT};
+        walkKey = walkKeys[bench_random() % 3];
+        walkTicks = 30 + bench_random() % 90;
+    }
+    bench_set_key(KEY_A, walkKey == KEY_A);
+    bench_set_key(KEY_D, walkKey == KEY_D);
+    bench_set_key(KEY_SPACE, bench_random() % 40 == 0);
+    bench_set_key(KEY_F, bench_random() % 20 == 0);
+    bench_set_key(KEY_MOUSE_MIDDLE, bench_random() % 10 == 0);
+    bench_set_key(KEY_B, bench_random() % 50 == 0);
+    bench_set_key(KEY_X, bench_random() % 200 == 0);
+    bench_set_key(KEY_Z, bench_random() % 300 == 0);
+    bench_set_key(KEY_W, bench_random() % 2000 == 0);
+    input->mousePosWorld = {(int)(bench_random() % WORLD_WIDTH), (int)(bench_random() % (WORLD_GRID.y * TILESIZE))};
+}
+
+//? Starts the game over from the same world, as a freshly started process would
+void start_run()
+{
+    BumpAllocator *transientStorage = gameState->transientStorage;
+    memset(gameState, 0, sizeof(GameState));
+    gameState->transientStorage = transientStorage;
+    memset(renderData, 0, sizeof(RenderData));
+    memset(input, 0, sizeof(Input));
+    soundState->allocatedSounds.clear();
+    soundState->playingSounds.clear();
+    soundState->bytesUsed = 0;
+    world = ecs::World();
+
+    bench_generate_cave(DETERMINISM_BENCH_SEED);
+    gameState->player.pos = {WORLD_WIDTH / 2, TILESIZE};
+    update_game(gameState, renderData, input, soundState, 0.0f);
+}
+
+//? Runs tickCount ticks and writes the checksum after each into checksums
+double run_ticks(uint32_t *checksums, int tickCount)
+{
+    int walkTicks = 0;
+    KeyCodeID walkKey = KEY_COUNT;
+    double totalMs = 0.0;
+    for (int tick = 0; tick < tickCount; tick++)
+    {
+        script_input(walkTicks, walkKey);
+
+        auto start = std::chrono::steady_clock::now();
+        fixed_update();
+        totalMs += bench_ms_since(start);
+
+        checksums[tick] = gameState->checksum;
+        gameState->transientStorage->used = 0;
+        soundState->playingSounds.clear();
+    }
+    return totalMs;
+}
+
+int main(int argc, char **argv)
+{
+    int tickCount = argc > 1 ? atoi(argv[1]) : 100000;
+    if (tickCount <= 0)
+    {
+        LOG_ERROR("Tick count has to be above 0");
+        return -1;
+    }
+    if (!bench_init())
+    {
+        return -1;
+    }
+    input = (Input *)calloc(1, sizeof(Input));
+    soundState = (SoundState *)calloc(1, sizeof(SoundState));
+    uint32_t *checksums[2] = {(uint32_t *)malloc(tickCount * sizeof(uint32_t)),
+                              (uint32_t *)malloc(tickCount * sizeof(uint32_t))};
+    if (!input || !soundState || !checksums[0] || !checksums[1])
+    {
+        LOG_ERROR("Failed to allocate the runs");
+        return -1;
+    }
+    soundState->transientStorage = gameState->transientStorage;
+    soundState->allocatedsoundsBuffer = (char *)calloc(1, SOUNDS_BUFFER_SIZE);
+
+    double runMs[2];
+    for (int run = 0; run < 2; run++)
+    {
+        benchSeed = DETERMINISM_BENCH_SEED;
+        start_run();
+        runMs[run] = run_ticks(checksums[run], tickCount);
+    }
+
+    int firstDifference = -1;
+    for (int tick = 0; tick < tickCount && firstDifference < 0; tick++)
+    {
+        if (checksums[0][tick] != checksums[1][tick])
+        {
+            firstDifference = tick;
+        }
+    }
+
+#ifdef FIXED_SIMULATION
+    const char *mode = "fixed point";
+#else
+    const char *mode = "float";
+#endif
+    printf("%s simulation, 2 runs of %d ticks: %.3f and %.3f ms per tick, final checksums %08x and %08x\n", mode,
+           tickCount, runMs[0] / tickCount, runMs[1] / tickCount, checksums[0][tickCount - 1],
+           checksums[1][tickCount - 1]);
+    if (firstDifference >= 0)
+    {
+        printf("The runs split at tick %d: %08x vs %08x\n", firstDifference, checksums[0][firstDifference],
+               checksums[1][firstDifference]);
+        return 1;
+    }
+    printf("Every tick matched\n");
+    return 0;
+}
@@ -11,6 +11,12 @@ enum SpriteID
     SPRITE_PLAYER,
     SPRITE_PLAYER_RUN,
     SPRITE_PLAYER_JUMP,
+    SPRITE_WATER,
+    SPRITE_LAVA,
+    SPRITE_BULLET,
+    SPRITE_MINIMAP_CELL,
+    SPRITE_ORE_COAL,
+    SPRITE_ORE_GOLD,
 
     SPRITE_COUNT
 };
@@ -60,6 +66,42 @@ Sprite get_sprite(SpriteID spriteID)
         sprite.spriteSize = {16, 16};
         break;
     }
+    case SPRITE_WATER:
+    {
+        sprite.atlasOffset = {160, 0};
+        sprite.spriteSize = {8, 8};
+        break;
+    }
+    case SPRITE_LAVA:
+    {
+        sprite.atlasOffset = {168, 0};
+        sprite.spriteSize = {8, 8};
+        break;
+    }
+    case SPRITE_BULLET:
+    {
+        sprite.atlasOffset = {176, 0};
+        sprite.spriteSize = {2, 2};
+        break;
+    }
+    case SPRITE_MINIMAP_CELL:
+    {
+        sprite.atlasOffset = {184, 0};
+        sprite.spriteSize = {8, 8};
+        break;
+    }
+    case SPRITE_ORE_COAL:
+    {
+        sprite.atlasOffset = {192, 0};
+        sprite.spriteSize = {8, 8};
+        break;
+    }
+    case SPRITE_ORE_GOLD:
+    {
+        sprite.atlasOffset = {200, 0};
+        sprite.spriteSize = {8, 8};
+        break;
+    }
     }
     return sprite;
 }
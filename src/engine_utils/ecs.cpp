@@ -1,6 +1,9 @@
-#include <cstdint> //for uint32_t
-#include <vector>  // For storage
-#include <memory>  // For std::shared_ptr, std::make_shared
+#include <cstdint>   //for uint32_t
+#include <vector>    // For storage
+#include <memory>    // For std::shared_ptr, std::make_shared
+#include <algorithm> // For std::sort, std::inplace_merge
+#include <chrono>    // For timing the broadphase
+#include <xmmintrin.h>
 #include "../vaultEngine_lib.h"
 
 namespace ecs
@@ -105,8 +108,8 @@ namespace ecs
 
             // move last element into removed slot
             dense[idx] = dense[last];
-            Entity movedEnt = denseEnt[last];
-            denseEnt[idx] = movedEnt;
+            Entity movedEnt = entities[last];
+            entities[idx] = movedEnt;
             sparse[movedEnt] = idx;
 
             // remove component from sparse set
@@ -150,6 +153,24 @@ namespace ecs
         char *path;
     };
 
+    // Axis aligned box around the TransformHot position
+    struct BoxCollider
+    {
+        float halfWidth{}, halfHeight{};
+    };
+
+    // Moved through the tile grid by the PhysicsSystem. Speeds are in pixels per
+    // tick, the body sits on whole pixels and the rest of the speed waits in remainder
+    struct PhysicsBody
+    {
+        SimVec2 speed{};
+        SimVec2 remainder{};
+        IVec2 aabb{}; // Size of the box centred on the TransformHot position
+        bool hasCollided{};
+        bool isGrounded{};
+        bool driven{}; // Speed.x was steered this tick, so no drag. Cleared every update
+    };
+
     // systems
     struct ISystem
     {
@@ -195,6 +216,202 @@ namespace ecs
         }
     };
 
+    //  -----------------------=== Broadphase ===-----------------------
+    //      Finds the pairs of colliders whose boxes overlap (sort and sweep)
+
+    struct OverlapPair
+    {
+        Entity a, b;
+    };
+
+    struct BroadphaseSystem : public ISystem
+    {
+        ComponentStorage<TransformHot> &pos;
+        ComponentStorage<BoxCollider> &colliders;
+
+        // Box of every tracked collider, kept sorted by minX between updates.
+        // Bodies barely move in a tick, so the insertion sort has little to do
+        struct SweepEntry
+        {
+            float minX, maxX, minY, maxY;
+            Entity e;
+        };
+        std::vector<SweepEntry> entries;
+        std::vector<char> tracked; // Entity is in entries
+        std::vector<float> sweepMinX, sweepMinY, sweepMaxY;
+
+        // Pairs of the last update, they live in pairArena until the next one
+        BumpAllocator pairArena = {};
+        OverlapPair *pairs = nullptr;
+        int pairCount = 0;
+        int swaps = 0; // Insertion sort moves of the last update
+        float updateMs = 0.0f;
+
+        BroadphaseSystem(ComponentStorage<TransformHot> &p, ComponentStorage<BoxCollider> &c)
+            : pos(p), colliders(c)
+        {
+            pairArena = make_bump_allocator(1024 * sizeof(OverlapPair));
+        }
+
+        ~BroadphaseSystem() override
+        {
+            free(pairArena.memory);
+        }
+
+        //? Drops colliders that are gone, refreshes the boxes and appends new colliders.
+        //? Returns how many entries were already tracked, they come first
+        size_t sync_entries()
+        {
+            size_t kept = 0;
+            for (size_t idx = 0; idx < entries.size(); idx++)
+            {
+                Entity e = entries[idx].e;
+                if (!colliders.has(e) || !pos.has(e))
+                {
+                    tracked[e] = false;
+                    continue;
+                }
+                entries[kept++] = make_entry(e);
+            }
+            entries.resize(kept);
+
+            if (tracked.size() < colliders.sparse.size())
+            {
+                tracked.resize(colliders.sparse.size(), false);
+            }
+            for (Entity e : colliders.view())
+            {
+                if (!tracked[e] && pos.has(e))
+                {
+                    tracked[e] = true;
+                    entries.push_back(make_entry(e));
+                }
+            }
+            return kept;
+        }
+
+        SweepEntry make_entry(Entity e)
+        {
+            TransformHot &p = pos.get(e);
+            BoxCollider &c = colliders.get(e);
+            return {p.x - c.halfWidth, p.x + c.halfWidth, p.y - c.halfHeight, p.y + c.halfHeight, e};
+        }
+
+        //? The old entries are nearly sorted, the new ones are sorted on their own and merged in
+        void sort_entries(size_t oldCount)
+        {
+            swaps = 0;
+            for (size_t idx = 1; idx < oldCount; idx++)
+            {
+                SweepEntry entry = entries[idx];
+                size_t slot = idx;
+                while (slot > 0 && entries[slot - 1].minX > entry.minX)
+                {
+                    entries[slot] = entries[slot - 1];
+                    slot--;
+                }
+                entries[slot] = entry;
+                swaps += (int)(idx - slot);
+            }
+
+            auto byMinX = [](const SweepEntry &a, const SweepEntry &b)
+            { return a.minX < b.minX; };
+            std::sort(entries.begin() + oldCount, entries.end(), byMinX);
+            std::inplace_merge(entries.begin(), entries.begin() + oldCount, entries.end(), byMinX);
+        }
+
+        //? Writes the overlapping pairs into the arena as far as it has room, returns how many there are
+        int sweep()
+        {
+            pairs = (OverlapPair *)pairArena.memory;
+            int maxPairs = (int)(pairArena.capacity / sizeof(OverlapPair));
+            int found = 0;
+
+            // The other entry of a pair starts before a ends, those are tested
+            // 4 at a time against copies of the bounds in their own arrays.
+            // The padding never overlaps anything
+            size_t count = entries.size();
+            sweepMinX.resize(count + 4);
+            sweepMinY.resize(count + 4);
+            sweepMaxY.resize(count + 4);
+            for (size_t idx = 0; idx < count; idx++)
+            {
+                sweepMinX[idx] = entries[idx].minX;
+                sweepMinY[idx] = entries[idx].minY;
+                sweepMaxY[idx] = entries[idx].maxY;
+            }
+            for (size_t idx = count; idx < count + 4; idx++)
+            {
+                sweepMinX[idx] = INFINITY;
+                sweepMinY[idx] = INFINITY;
+                sweepMaxY[idx] = -INFINITY;
+            }
+
+            // end only moves forward, past the last entry any earlier one reached.
+            // The x test drops the ones beyond a's own end
+            size_t end = 0;
+            for (size_t idx = 0; idx < count; idx++)
+            {
+                const SweepEntry &a = entries[idx];
+                end = end > idx + 1 ? end : idx + 1;
+                while (end < count && sweepMinX[end] <= a.maxX)
+                {
+                    end++;
+                }
+
+                __m128 aMaxX = _mm_set1_ps(a.maxX);
+                __m128 aMinY = _mm_set1_ps(a.minY);
+                __m128 aMaxY = _mm_set1_ps(a.maxY);
+                for (size_t other = idx + 1; other < end; other += 4)
+                {
+                    __m128 overlapX = _mm_cmple_ps(_mm_loadu_ps(&sweepMinX[other]), aMaxX);
+                    __m128 overlapY = _mm_and_ps(_mm_cmple_ps(aMinY, _mm_loadu_ps(&sweepMaxY[other])),
+                                                 _mm_cmple_ps(_mm_loadu_ps(&sweepMinY[other]), aMaxY));
+                    int mask = _mm_movemask_ps(_mm_and_ps(overlapX, overlapY));
+                    while (mask)
+                    {
+                        size_t hit = other + __builtin_ctz(mask);
+                        mask &= mask - 1;
+                        if (hit >= end)
+                        {
+                            break;
+                        }
+                        if (found < maxPairs)
+                        {
+                            pairs[found] = {a.e, entries[hit].e};
+                        }
+                        found++;
+                    }
+                }
+            }
+            return found;
+        }
+
+        void update(float dt) override
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            size_t oldCount = sync_entries();
+            sort_entries(oldCount);
+
+            // The arena is reused every update and only grows when a sweep
+            // finds more pairs than it holds
+            int found = sweep();
+            if (found > (int)(pairArena.capacity / sizeof(OverlapPair)))
+            {
+                free(pairArena.memory);
+                pairArena = make_bump_allocator(found * 2 * sizeof(OverlapPair));
+                found = sweep();
+            }
+            pairCount = found;
+            pairArena.used = found * sizeof(OverlapPair);
+
+            updateMs = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        }
+    };
+
     //  -----------------------=== World ===-----------------------
     //              Works like the central ECS manager
 
@@ -239,6 +456,8 @@ namespace ecs
         ComponentStorage<TransformHot> transforms;
         ComponentStorage<Velocity> velocities;
         ComponentStorage<Script> scripts;
+        ComponentStorage<BoxCollider> colliders;
+        ComponentStorage<PhysicsBody> bodies;
 
         // -----------------------=== System ===-----------------------
 
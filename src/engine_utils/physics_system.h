@@ -1,19 +1,71 @@
-#include "ecs.h"
+#pragma once
 
-namespace ect
+// ################################     Physics System   ################################
+// Moves every PhysicsBody through the tile grid the way the player moves. Gravity
+// and drag are one pass over the dense body array that touches nothing else, then
+// every body is moved and collided with move_box(). Needs ecs.cpp and game.h
+// included ahead of it, game.cpp does that
+
+namespace ecs
 {
-    struct PhysicsBody
+    struct PhysicsSystem : public ISystem
     {
-        float vx, vy;
-    };
+        ComponentStorage<TransformHot> &pos;
+        ComponentStorage<PhysicsBody> &bodies;
 
-    // A physics system that integrates velocity into transform each frame
-    void PhysicsSystem(Registry &reg, float dt)
-    {
-        reg.view2<TransformHot, PhysicsBody>([&](Entity, TransformHot &t, const Velocity &v)
-                                          {
-        t.x += v.vx * dt;
-        t.y += v.vy * dt; });
-    }
+        float gravity = 13.0f; // Speed gained per second, up to fallSpeed
+        float fallSpeed = 3.6f;
+        float groundDrag = 22.0f; // Speed lost per second while not driven
+        float airDrag = 12.0f;
+
+        int movedBodies = 0;
+        float updateMs = 0.0f;
+
+        PhysicsSystem(ComponentStorage<TransformHot> &p, ComponentStorage<PhysicsBody> &b)
+            : pos(p), bodies(b) {}
 
-}
\ No newline at end of file
+        void update(float dt) override
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            // Forces, the steps are worked out once so fixed point runs see the same numbers
+            SimFloat zero = SimFloat(0.0f);
+            SimFloat maxFall = SimFloat(fallSpeed);
+            SimFloat gravityStep = SimFloat(gravity * dt);
+            SimFloat groundDragStep = SimFloat(groundDrag * dt);
+            SimFloat airDragStep = SimFloat(airDrag * dt);
+            for (PhysicsBody &body : bodies.dense)
+            {
+                if (!body.driven)
+                {
+                    body.speed.x = approach(body.speed.x, zero, body.isGrounded ? groundDragStep : airDragStep);
+                }
+                body.speed.y = approach(body.speed.y, maxFall, gravityStep);
+                body.driven = false;
+            }
+
+            // Tile collision, bodies without a position stay where they are
+            movedBodies = 0;
+            for (size_t idx = 0; idx < bodies.dense.size(); idx++)
+            {
+                Entity e = bodies.entities[idx];
+                if (!pos.has(e))
+                {
+                    continue;
+                }
+
+                TransformHot &p = pos.get(e);
+                PhysicsBody &body = bodies.dense[idx];
+                IVec2 pixelPos = {(int)roundf(p.x), (int)roundf(p.y)};
+                move_box(pixelPos, body.aabb, body.speed, body.remainder, body.hasCollided, body.isGrounded);
+                p.x = (float)pixelPos.x;
+                p.y = (float)pixelPos.y;
+                movedBodies++;
+            }
+
+            updateMs = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+        }
+    };
+}
@@ -21,6 +21,11 @@ int RENDERING_OPTION_FLIP_X = BIT(0);
 int RENDERING_OPTION_FLIP_Y = BIT(1);
 int RENDERING_OPTION_FONT = BIT(2);
 
+// Tilesets in the atlas are 4 variants wide, materials index the atlas origins
+#define TILESET_COLUMNS 4
+#define MAX_TILE_MATERIALS 16
+#define MAX_LIGHT_LEVEL 15
+
 // #############################################################################
 //                           Rendering Structs
 // #############################################################################
@@ -38,6 +43,14 @@ struct RenderTransform
   int padding;
 };
 
+// Written by the particle system, drawn as a one pixel quad each
+struct ParticleInstance
+{
+  vec2 pos;  // In world pixels
+  int color; // RGBA8, red in the lowest byte
+  int padding;
+};
+
 struct Material
 {
 	// Operator inside the Engine to compare materials
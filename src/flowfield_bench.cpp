@@ -0,0 +1,139 @@
+// Headless benchmark of the flow field. Builds the field of a generated cave, moves the
+// goal every tick like a walking player, then digs and fills random tiles and times
+// patching them in. The patched field is checked against a full build of the same grid:
+//   flowfieldBench.exe 1000
+#include "bench_utils.h"
+
+constexpr int FLOWFIELD_BENCH_WALK_TICKS = 600;
+
+IVec2 random_tile(bool solid)
+{
+    while (true)
+    {
+        IVec2 tile = {(int)(bench_random() % WORLD_GRID.x), (int)(bench_random() % WORLD_GRID.y)};
+        if (is_solid(tile.x, tile.y) == solid)
+        {
+            return tile;
+        }
+    }
+}
+
+//? Runs flow_update() until the build is done, returns the ticks it took
+int finish_build(FlowField &field, double &ms)
+{
+    int ticks = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (field.stage != FLOW_IDLE)
+    {
+        flow_update(field);
+        ticks++;
+    }
+    ms = bench_ms_since(start);
+    return ticks;
+}
+
+//? Builds the field again from scratch and counts the open tiles whose cost or direction differs
+int count_wrong_tiles(FlowField &field, FlowLayer *patched)
+{
+    double buildMs;
+    memcpy((void *)patched, &field.layers[field.front], sizeof(FlowLayer));
+    flow_start_build(field, field.goal);
+    finish_build(field, buildMs);
+
+    FlowLayer &built = field.layers[field.front];
+    int wrong = 0;
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            wrong += !is_solid(x, y) && (patched->costs[x][y] != built.costs[x][y] ||
+                                         patched->directions[x][y] != built.directions[x][y]);
+        }
+    }
+    return wrong;
+}
+
+int main(int argc, char **argv)
+{
+    int editCount = argc > 1 ? atoi(argv[1]) : 1000;
+    if (editCount <= 0)
+    {
+        LOG_ERROR("Edit count has to be above 0");
+        return -1;
+    }
+    if (!bench_init())
+    {
+        return -1;
+    }
+    FlowLayer *patched = (FlowLayer *)malloc(sizeof(FlowLayer));
+    if (!patched)
+    {
+        LOG_ERROR("Failed to allocate the patched layer");
+        return -1;
+    }
+    bench_generate_cave(5);
+    FlowField &field = gameState->playerFlow;
+
+    IVec2 goal = random_tile(false);
+    flow_set_goal(field, goal);
+    double buildMs;
+    int buildTicks = finish_build(field, buildMs);
+    printf("%dx%d cave: full build %.1f ms over %d ticks\n", WORLD_GRID.x, WORLD_GRID.y, buildMs, buildTicks);
+
+    // A goal that moves every tick, builds have to finish anyway. Tiles change under them too
+    int buildsBefore = field.builds;
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < FLOWFIELD_BENCH_WALK_TICKS; tick++)
+    {
+        if (tick % 10 == 0)
+        {
+            bool fill = tick % 20 == 0;
+            IVec2 tile = random_tile(!fill);
+            set_tile_material(tile.x, tile.y, fill ? MATERIAL_STONE : MATERIAL_AIR);
+        }
+
+        int dir = bench_random() % 4;
+        IVec2 next = {goal.x + (dir == 1 ? -1 : dir == 2 ? 1 : 0), goal.y + (dir == 0 ? -1 : dir == 3 ? 1 : 0)};
+        if (!is_solid(next.x, next.y))
+        {
+            goal = next;
+        }
+        flow_set_goal(field, goal);
+        flow_update(field);
+    }
+    double walkMs = bench_ms_since(start);
+    finish_build(field, buildMs);
+    printf("  goal moving for %d ticks: %d builds finished, %.3f ms per tick\n", FLOWFIELD_BENCH_WALK_TICKS,
+           field.builds - buildsBefore, walkMs / FLOWFIELD_BENCH_WALK_TICKS);
+    int wrong = count_wrong_tiles(field, patched);
+
+    // The edits go in with the field switched off, so only the patch itself is timed
+    double patchMs[2] = {};
+    double worstMs[2] = {};
+    int patchCount[2] = {};
+    buildsBefore = field.builds;
+    for (int edit = 0; edit < editCount; edit++)
+    {
+        bool fill = edit % 2 == 0;
+        IVec2 tile = random_tile(!fill);
+        field.valid = false;
+        set_tile_material(tile.x, tile.y, fill ? MATERIAL_STONE : MATERIAL_AIR);
+        field.valid = true;
+
+        start = std::chrono::steady_clock::now();
+        flow_patch_tile(field, tile.x, tile.y);
+        double ms = bench_ms_since(start);
+        patchMs[fill] += ms;
+        worstMs[fill] = fmax(worstMs[fill], ms);
+        patchCount[fill]++;
+        finish_build(field, buildMs);
+    }
+    printf("  %d tiles dug: avg %.3f ms, worst %.3f ms\n", patchCount[0], patchMs[0] / max(patchCount[0], 1),
+           worstMs[0]);
+    printf("  %d tiles filled: avg %.3f ms, worst %.3f ms, %d fell back to a full build\n", patchCount[1],
+           patchMs[1] / max(patchCount[1], 1), worstMs[1], field.builds - buildsBefore);
+
+    wrong += count_wrong_tiles(field, patched);
+    printf("  patched field against a full build: %d tiles differ in total\n", wrong);
+    return wrong ? 1 : 0;
+}
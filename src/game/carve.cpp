@@ -0,0 +1,249 @@
+#include "game.h"
+
+// ################################     Carve Functions   ################################
+// Shapes are rasterized one row at a time. Every shape gives one or more spans
+// of tile centers per row, and a span is removed in a single tight loop.
+// Autotiling is not done here, the touched chunks are marked dirty and updated
+// once in flush_dirty_chunks()
+
+//? Horizontal interval [left, right] where the row at rowY is inside the circle
+bool circle_row_interval(Vec2 center, float radius, float rowY, float *left, float *right)
+{
+  float dy = rowY - center.y;
+  float halfSquared = radius * radius - dy * dy;
+  if (halfSquared < 0.0f)
+  {
+    return false;
+  }
+
+  float half = sqrtf(halfSquared);
+  *left = center.x - half;
+  *right = center.x + half;
+  return true;
+}
+
+//? Collects where the row at rowY crosses the edges of the polygon, sorted from left to right
+int polygon_row_crossings(Vec2 *points, int pointCount, float rowY, float *crossings)
+{
+  int crossingCount = 0;
+  for (int idx = 0; idx < pointCount; idx++)
+  {
+    Vec2 a = points[idx];
+    Vec2 b = points[(idx + 1) % pointCount];
+
+    // Half open so a vertex exactly on the row only counts once
+    if ((a.y <= rowY) == (b.y <= rowY))
+    {
+      continue;
+    }
+
+    float x = a.x + (rowY - a.y) * (b.x - a.x) / (b.y - a.y);
+
+    // Insertion sort, there are never more crossings than points
+    int slot = crossingCount++;
+    while (slot > 0 && crossings[slot - 1] > x)
+    {
+      crossings[slot] = crossings[slot - 1];
+      slot--;
+    }
+    crossings[slot] = x;
+  }
+  return crossingCount;
+}
+
+//? Removes every tile in row y whose center is inside [left, right]
+void carve_span(int y, float left, float right, CarveResult *result, IVec2 *minTile, IVec2 *maxTile)
+{
+  int x0 = max((int)ceilf(left - 0.5f), 0);
+  int x1 = min((int)floorf(right - 0.5f), WORLD_GRID.x - 1);
+  if (x0 > x1)
+  {
+    return;
+  }
+
+  bool removed = false;
+  for (int x = x0; x <= x1; x++)
+  {
+    Tile *tile = &gameState->worldGrid[x][y];
+    MaterialID material = tile->material;
+
+    // Air has nothing to remove and bedrock can't be removed
+    if (material == MATERIAL_AIR || materialTable.hardness[material] == INFINITY)
+    {
+      continue;
+    }
+
+    result->removed[material]++;
+    tile->material = MATERIAL_AIR;
+    on_tile_changed(x, y, material, MATERIAL_AIR);
+    removed = true;
+  }
+
+  if (removed)
+  {
+    minTile->x = min(minTile->x, x0);
+    minTile->y = min(minTile->y, y);
+    maxTile->x = max(maxTile->x, x1);
+    maxTile->y = max(maxTile->y, y);
+  }
+}
+
+void carve_shape(CarveShape &shape, CarveResult *result, IVec2 *minTile, IVec2 *maxTile)
+{
+  // Bounding rows of the shape
+  float top, bottom;
+  Vec2 capsuleQuad[4];
+
+  switch (shape.type)
+  {
+  case CARVE_CIRCLE:
+  {
+    top = shape.start.y - shape.radius;
+    bottom = shape.start.y + shape.radius;
+    break;
+  }
+  case CARVE_CAPSULE:
+  {
+    top = min(shape.start.y, shape.end.y) - shape.radius;
+    bottom = max(shape.start.y, shape.end.y) + shape.radius;
+
+    // The body of the capsule is the segment pushed out by radius on both sides
+    Vec2 dir = shape.end - shape.start;
+    float length = sqrtf(dir.x * dir.x + dir.y * dir.y);
+    Vec2 normal = {};
+    if (length > 0.0f)
+    {
+      normal = Vec2{-dir.y, dir.x} * (shape.radius / length);
+    }
+    capsuleQuad[0] = shape.start + normal;
+    capsuleQuad[1] = shape.end + normal;
+    capsuleQuad[2] = shape.end - normal;
+    capsuleQuad[3] = shape.start - normal;
+    break;
+  }
+  case CARVE_POLYGON:
+  {
+    if (shape.points.count < 3)
+    {
+      return;
+    }
+    top = bottom = shape.points.elements[0].y;
+    for (int idx = 1; idx < shape.points.count; idx++)
+    {
+      top = min(top, shape.points.elements[idx].y);
+      bottom = max(bottom, shape.points.elements[idx].y);
+    }
+    break;
+  }
+  }
+
+  // Only rows inside the world are visited, a huge explosion costs no more than the world
+  int y0 = max((int)ceilf(top - 0.5f), 0);
+  int y1 = min((int)floorf(bottom - 0.5f), WORLD_GRID.y - 1);
+
+  for (int y = y0; y <= y1; y++)
+  {
+    float rowY = y + 0.5f;
+
+    switch (shape.type)
+    {
+    case CARVE_CIRCLE:
+    {
+      float left, right;
+      if (circle_row_interval(shape.start, shape.radius, rowY, &left, &right))
+      {
+        carve_span(y, left, right, result, minTile, maxTile);
+      }
+      break;
+    }
+    case CARVE_CAPSULE:
+    {
+      // A capsule is convex, so the row is one span covering the end caps and the body
+      float left = 0.0f, right = 0.0f;
+      bool hit = false;
+
+      float capLeft, capRight;
+      if (circle_row_interval(shape.start, shape.radius, rowY, &capLeft, &capRight))
+      {
+        left = capLeft;
+        right = capRight;
+        hit = true;
+      }
+      if (circle_row_interval(shape.end, shape.radius, rowY, &capLeft, &capRight))
+      {
+        left = hit ? min(left, capLeft) : capLeft;
+        right = hit ? max(right, capRight) : capRight;
+        hit = true;
+      }
+
+      float crossings[4];
+      int crossingCount = polygon_row_crossings(capsuleQuad, 4, rowY, crossings);
+      if (crossingCount >= 2)
+      {
+        left = hit ? min(left, crossings[0]) : crossings[0];
+        right = hit ? max(right, crossings[crossingCount - 1]) : crossings[crossingCount - 1];
+        hit = true;
+      }
+
+      if (hit)
+      {
+        carve_span(y, left, right, result, minTile, maxTile);
+      }
+      break;
+    }
+    case CARVE_POLYGON:
+    {
+      // Even-odd fill, concave polygons can give several spans per row
+      float crossings[MAX_CARVE_POINTS];
+      int crossingCount = polygon_row_crossings(shape.points.elements, shape.points.count,
+                                                rowY, crossings);
+      for (int idx = 0; idx + 1 < crossingCount; idx += 2)
+      {
+        carve_span(y, crossings[idx], crossings[idx + 1], result, minTile, maxTile);
+      }
+      break;
+    }
+    }
+  }
+}
+
+//? Removes all tiles covered by the shapes and returns what was removed.
+//? Touched chunks are only marked dirty, the autotile runs once for the whole batch
+CarveResult carve(CarveShape *shapes, int shapeCount)
+{
+  CarveResult result = {};
+
+  for (int idx = 0; idx < shapeCount; idx++)
+  {
+    // Corners of the removed tiles, nothing removed leaves them inverted
+    IVec2 minTile = {WORLD_GRID.x, WORLD_GRID.y};
+    IVec2 maxTile = {-1, -1};
+    carve_shape(shapes[idx], &result, &minTile, &maxTile);
+
+    if (minTile.x <= maxTile.x)
+    {
+      mark_tiles_dirty(minTile.x, minTile.y, maxTile.x, maxTile.y);
+    }
+  }
+
+  return result;
+}
+
+CarveResult carve_circle(Vec2 center, float radius)
+{
+  CarveShape shape = {};
+  shape.type = CARVE_CIRCLE;
+  shape.start = center;
+  shape.radius = radius;
+  return carve(&shape, 1);
+}
+
+CarveResult carve_capsule(Vec2 start, Vec2 end, float radius)
+{
+  CarveShape shape = {};
+  shape.type = CARVE_CAPSULE;
+  shape.start = start;
+  shape.end = end;
+  shape.radius = radius;
+  return carve(&shape, 1);
+}
@@ -0,0 +1,278 @@
+#include "game.h"
+
+#include <chrono>
+
+// ################################     Damage Functions   ################################
+// Mining takes as many hits as the material is hard, and a tile that stops being
+// hit heals one hit at a time after DAMAGE_REGEN_DELAY. Only the damaged tiles
+// are stored, in a hash from tile index to node. Every node waits in a timer
+// wheel of TIMER_WHEEL_LEVELS levels: level 0 has a slot per tick, every level
+// above a slot per TIMER_WHEEL_SLOTS slots of the one below. Whenever level 0
+// wraps around, the next slot of level 1 is spread over level 0 (and so on up),
+// so a tick only looks at the timers that are due plus its share of the moves
+
+//? Empties the hash and the wheel, every node goes on the free list
+void damage_reset()
+{
+  TileDamage &damage = gameState->damage;
+  memset(damage.hash, -1, sizeof(damage.hash));
+  memset(damage.wheel, -1, sizeof(damage.wheel));
+  for (int idx = 0; idx < MAX_DAMAGED_TILES; idx++)
+  {
+    damage.nodes[idx].next = idx + 1 < MAX_DAMAGED_TILES ? idx + 1 : -1;
+  }
+  damage.freeNode = 0;
+  damage.count = 0;
+  damage.initialized = true;
+}
+
+uint32_t damage_key(int x, int y)
+{
+  return (uint32_t)(x * WORLD_GRID.y + y);
+}
+
+int damage_hash_slot(uint32_t key)
+{
+  return (int)((key * 0x9E3779B1u) >> (32 - DAMAGE_HASH_BITS));
+}
+
+//? Hash slot holding key, or the empty slot it would go into
+int damage_find_slot(uint32_t key)
+{
+  TileDamage &damage = gameState->damage;
+  int slot = damage_hash_slot(key);
+  while (damage.hash[slot] != -1 && damage.nodes[damage.hash[slot]].key != key)
+  {
+    slot = (slot + 1) & (DAMAGE_HASH_SIZE - 1);
+  }
+  return slot;
+}
+
+//? Empties slot and moves later nodes of the same run back, so lookups never see a hole
+void damage_hash_remove(int slot)
+{
+  TileDamage &damage = gameState->damage;
+  damage.hash[slot] = -1;
+
+  int next = (slot + 1) & (DAMAGE_HASH_SIZE - 1);
+  while (damage.hash[next] != -1)
+  {
+    int home = damage_hash_slot(damage.nodes[damage.hash[next]].key);
+    if (((next - home) & (DAMAGE_HASH_SIZE - 1)) >= ((next - slot) & (DAMAGE_HASH_SIZE - 1)))
+    {
+      damage.hash[slot] = damage.hash[next];
+      damage.hash[next] = -1;
+      slot = next;
+    }
+    next = (next + 1) & (DAMAGE_HASH_SIZE - 1);
+  }
+}
+
+// Timer wheel
+void damage_wheel_link(int nodeIdx)
+{
+  TileDamage &damage = gameState->damage;
+  DamagedTile &node = damage.nodes[nodeIdx];
+
+  // Lowest level whose slots still reach the tick
+  uint32_t delta = node.expireTick - damage.tick;
+  int level = 0;
+  while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1u << (TIMER_WHEEL_BITS * (level + 1))))
+  {
+    level++;
+  }
+  int slot = (node.expireTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1);
+
+  node.wheelSlot = level * TIMER_WHEEL_SLOTS + slot;
+  node.prev = -1;
+  node.next = damage.wheel[node.wheelSlot];
+  if (node.next != -1)
+  {
+    damage.nodes[node.next].prev = nodeIdx;
+  }
+  damage.wheel[node.wheelSlot] = nodeIdx;
+}
+
+void damage_wheel_unlink(int nodeIdx)
+{
+  TileDamage &damage = gameState->damage;
+  DamagedTile &node = damage.nodes[nodeIdx];
+  if (node.prev != -1)
+  {
+    damage.nodes[node.prev].next = node.next;
+  }
+  else
+  {
+    damage.wheel[node.wheelSlot] = node.next;
+  }
+  if (node.next != -1)
+  {
+    damage.nodes[node.next].prev = node.prev;
+  }
+}
+
+//? Takes the node out of the hash and the wheel and frees it
+void damage_remove(int slot)
+{
+  TileDamage &damage = gameState->damage;
+  int nodeIdx = damage.hash[slot];
+  damage_wheel_unlink(nodeIdx);
+  damage_hash_remove(slot);
+
+  damage.nodes[nodeIdx].next = damage.freeNode;
+  damage.freeNode = nodeIdx;
+  damage.count--;
+}
+
+//? Hits the tile, returns true if that broke it
+bool damage_tile(int x, int y, float amount)
+{
+  if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+  {
+    return false;
+  }
+
+  MaterialID material = gameState->worldGrid[x][y].material;
+  float hardness = materialTable.hardness[material];
+  if (material == MATERIAL_AIR || isinf(hardness))
+  {
+    return false;
+  }
+
+  TileDamage &damage = gameState->damage;
+  if (!damage.initialized)
+  {
+    damage_reset();
+  }
+
+  uint32_t key = damage_key(x, y);
+  int slot = damage_find_slot(key);
+  int nodeIdx = damage.hash[slot];
+  float taken = nodeIdx != -1 ? damage.nodes[nodeIdx].damage + amount : amount;
+
+  // Breaking also forgets the damage, through damage_on_tile_changed()
+  if (taken >= hardness)
+  {
+    set_tile_material(x, y, MATERIAL_AIR);
+    return true;
+  }
+
+  if (nodeIdx == -1)
+  {
+    if (damage.freeNode == -1)
+    {
+      LOG_WARN("Too many damaged tiles, the hit on %d, %d is lost", x, y);
+      return false;
+    }
+    nodeIdx = damage.freeNode;
+    damage.freeNode = damage.nodes[nodeIdx].next;
+    damage.hash[slot] = nodeIdx;
+    damage.nodes[nodeIdx].key = key;
+    damage.count++;
+  }
+  else
+  {
+    damage_wheel_unlink(nodeIdx);
+  }
+
+  DamagedTile &node = damage.nodes[nodeIdx];
+  node.damage = taken;
+  node.expireTick = damage.tick + DAMAGE_REGEN_DELAY;
+  damage_wheel_link(nodeIdx);
+  return false;
+}
+
+//? Hits the tile has taken and not healed yet
+float get_tile_damage(int x, int y)
+{
+  TileDamage &damage = gameState->damage;
+  if (!damage.initialized || !damage.count)
+  {
+    return 0.0f;
+  }
+
+  int nodeIdx = damage.hash[damage_find_slot(damage_key(x, y))];
+  return nodeIdx != -1 ? damage.nodes[nodeIdx].damage : 0.0f;
+}
+
+//? A tile that changed material (broken, carved, built over) starts undamaged
+void damage_on_tile_changed(int x, int y, MaterialID oldMaterial, MaterialID newMaterial)
+{
+  TileDamage &damage = gameState->damage;
+  if (!damage.initialized || !damage.count)
+  {
+    return;
+  }
+
+  int slot = damage_find_slot(damage_key(x, y));
+  if (damage.hash[slot] != -1)
+  {
+    damage_remove(slot);
+  }
+}
+
+//? Advances the wheel by one tick and heals the tiles that are due
+void damage_update()
+{
+  TileDamage &damage = gameState->damage;
+  damage.healedHits = 0;
+  damage.cascadedTimers = 0;
+  if (!damage.initialized)
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  damage.tick++;
+
+  // Spread the next slot of every level that wrapped over the levels below
+  for (int level = 1; level < TIMER_WHEEL_LEVELS; level++)
+  {
+    if ((damage.tick >> (TIMER_WHEEL_BITS * (level - 1))) & (TIMER_WHEEL_SLOTS - 1))
+    {
+      break;
+    }
+
+    int slot = level * TIMER_WHEEL_SLOTS + ((damage.tick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+    int nodeIdx = damage.wheel[slot];
+    damage.wheel[slot] = -1;
+    while (nodeIdx != -1)
+    {
+      int next = damage.nodes[nodeIdx].next;
+      damage_wheel_link(nodeIdx);
+      damage.cascadedTimers++;
+      nodeIdx = next;
+    }
+  }
+
+  // Everything left in the level 0 slot is due now
+  int slot = damage.tick & (TIMER_WHEEL_SLOTS - 1);
+  int nodeIdx = damage.wheel[slot];
+  damage.wheel[slot] = -1;
+  while (nodeIdx != -1)
+  {
+    DamagedTile &node = damage.nodes[nodeIdx];
+    int next = node.next;
+
+    node.damage -= 1.0f;
+    damage.healedHits++;
+    if (node.damage > 0.0f)
+    {
+      node.expireTick = damage.tick + DAMAGE_REGEN_INTERVAL;
+      damage_wheel_link(nodeIdx);
+    }
+    else
+    {
+      // Already out of the wheel, only the hash and the free list are left
+      damage_hash_remove(damage_find_slot(node.key));
+      node.next = damage.freeNode;
+      damage.freeNode = nodeIdx;
+      damage.count--;
+    }
+    nodeIdx = next;
+  }
+
+  damage.updateMs = std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+}
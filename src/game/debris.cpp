@@ -0,0 +1,253 @@
+#include "game.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+// ################################     Debris Functions   ################################
+// Islands cut loose by the integrity search become rigid bodies made of their
+// tiles. Bodies fall straight down without turning, so they always fit the grid
+// again and collide with the grid and each other through whole tiles: every body
+// marks the tiles it covers in debris.occupant, and only its bottom faces (tiles
+// with nothing of the same body below them) are tested when it moves. Bodies move
+// lowest first, so one resting on another sees where that one went this tick.
+// Bodies touching each other form an island, and once every body of an island
+// has rested for DEBRIS_SLEEP_TICKS the island sleeps: its tiles go back into the
+// grid and cost nothing until something cuts them loose again
+
+//? Forgets every body, the grid keeps whatever already settled
+void debris_reset()
+{
+  DebrisState &debris = gameState->debris;
+  debris.bodies.clear();
+  debris.tileCount = 0;
+  memset(debris.occupant, 0, sizeof(debris.occupant));
+}
+
+void debris_set_occupant(DebrisBody &body, uint16_t value)
+{
+  DebrisState &debris = gameState->debris;
+  for (int idx = body.firstTile; idx < body.firstTile + body.tileCount; idx++)
+  {
+    IVec2 pos = debris.tiles[idx].pos;
+    debris.occupant[pos.x][pos.y + body.row] = value;
+  }
+}
+
+//? Root of the island the body belongs to, halving the path on the way
+int debris_find_island(int bodyIdx)
+{
+  DebrisBody *bodies = gameState->debris.bodies.elements;
+  while (bodies[bodyIdx].island != bodyIdx)
+  {
+    bodies[bodyIdx].island = bodies[bodies[bodyIdx].island].island;
+    bodyIdx = bodies[bodyIdx].island;
+  }
+  return bodyIdx;
+}
+
+//? Takes the tiles out of the grid as one body, returns false if there is no room for it
+bool debris_spawn(IVec2 *tiles, int count)
+{
+  DebrisState &debris = gameState->debris;
+  if (debris.bodies.is_full() || debris.tileCount + count > MAX_DEBRIS_TILES)
+  {
+    return false;
+  }
+
+  uint16_t id = (uint16_t)(debris.bodies.count + 1);
+  for (int idx = 0; idx < count; idx++)
+  {
+    debris.occupant[tiles[idx].x][tiles[idx].y] = id;
+  }
+
+  // Bottom faces first, they are all debris_update() has to look at
+  DebrisBody body = {};
+  body.firstTile = debris.tileCount;
+  body.tileCount = count;
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (int idx = 0; idx < count; idx++)
+    {
+      IVec2 pos = tiles[idx];
+      bool face = pos.y + 1 >= WORLD_GRID.y || debris.occupant[pos.x][pos.y + 1] != id;
+      if (face != (pass == 0))
+      {
+        continue;
+      }
+      debris.tiles[debris.tileCount++] = {pos, gameState->worldGrid[pos.x][pos.y]};
+      body.faceCount += face;
+      body.bottom = max(body.bottom, pos.y);
+    }
+  }
+  debris.bodies.add(body);
+
+  for (int idx = 0; idx < count; idx++)
+  {
+    set_tile_material(tiles[idx].x, tiles[idx].y, MATERIAL_AIR);
+  }
+  return true;
+}
+
+//? Moves the body down as far as its speed takes it this tick, joins it to the island of every body it lands on
+void debris_move(int bodyIdx, float dt)
+{
+  DebrisState &debris = gameState->debris;
+  DebrisBody &body = debris.bodies[bodyIdx];
+  uint16_t id = (uint16_t)(bodyIdx + 1);
+  float oldFallen = body.fallen;
+
+  body.speed = min(body.speed + FALL_GRAVITY * dt, MAX_FALL_SPEED);
+  float target = body.fallen + body.speed * dt;
+
+  // Row by row, so fast bodies can't skip over anything. Every face is tested
+  // even after one is blocked, to find all the bodies it comes to rest on
+  int row = body.row;
+  bool blocked = false;
+  while (!blocked && row < target)
+  {
+    for (int idx = body.firstTile; idx < body.firstTile + body.faceCount; idx++)
+    {
+      IVec2 pos = debris.tiles[idx].pos;
+      int y = pos.y + row + 1;
+      if (is_solid(pos.x, y))
+      {
+        blocked = true;
+        target = min(target, (float)row);
+        body.speed = 0.0f;
+        continue;
+      }
+
+      uint16_t other = debris.occupant[pos.x][y];
+      if (!other || other == id)
+      {
+        continue;
+      }
+
+      // Keeps the same distance to the body below as the tiles have
+      DebrisBody &support = debris.bodies[other - 1];
+      blocked = true;
+      target = min(target, support.fallen - support.row + row);
+      body.speed = min(body.speed, support.speed);
+      debris.contacts++;
+
+      int root = debris_find_island(bodyIdx);
+      int otherRoot = debris_find_island(other - 1);
+      if (root != otherRoot)
+      {
+        debris.bodies[root].island = otherRoot;
+      }
+    }
+
+    if (!blocked)
+    {
+      row++;
+    }
+  }
+
+  if (row != body.row)
+  {
+    debris_set_occupant(body, 0);
+    body.row = row;
+    debris_set_occupant(body, id);
+  }
+  body.fallen = max(target, oldFallen);
+  body.restTicks = body.fallen == oldFallen ? body.restTicks + 1 : 0;
+}
+
+//? Moves every body, puts resting islands back into the grid
+void debris_update(float dt)
+{
+  DebrisState &debris = gameState->debris;
+  Array<DebrisBody, MAX_DEBRIS_BODIES> &bodies = debris.bodies;
+  debris.contacts = 0;
+  debris.sleptIslands = 0;
+  if (!bodies.count)
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Lowest first, so a body sees where the one below it went this tick
+  for (int idx = 0; idx < bodies.count; idx++)
+  {
+    debris.order[idx] = idx;
+    bodies[idx].island = idx;
+  }
+  std::sort(debris.order, debris.order + bodies.count, [&bodies](int a, int b)
+            { return bodies.elements[a].bottom + bodies.elements[a].row >
+                     bodies.elements[b].bottom + bodies.elements[b].row; });
+
+  for (int orderIdx = 0; orderIdx < bodies.count; orderIdx++)
+  {
+    debris_move(debris.order[orderIdx], dt);
+  }
+
+  // An island sleeps once the body that rested the shortest has rested long enough
+  int islandRest[MAX_DEBRIS_BODIES];
+  for (int idx = 0; idx < bodies.count; idx++)
+  {
+    islandRest[idx] = INT_MAX;
+  }
+  for (int idx = 0; idx < bodies.count; idx++)
+  {
+    int root = debris_find_island(idx);
+    islandRest[root] = min(islandRest[root], bodies[idx].restTicks);
+  }
+
+  bool asleep[MAX_DEBRIS_BODIES];
+  bool anyAsleep = false;
+  for (int idx = 0; idx < bodies.count; idx++)
+  {
+    int root = debris_find_island(idx);
+    asleep[idx] = islandRest[root] >= DEBRIS_SLEEP_TICKS;
+    if (!asleep[idx])
+    {
+      continue;
+    }
+
+    DebrisBody &body = bodies[idx];
+    debris_set_occupant(body, 0);
+    for (int tileIdx = body.firstTile; tileIdx < body.firstTile + body.tileCount; tileIdx++)
+    {
+      FallingTile &fallingTile = debris.tiles[tileIdx];
+      set_tile_material(fallingTile.pos.x, fallingTile.pos.y + body.row, fallingTile.tile.material);
+    }
+    debris.sleptIslands += root == idx;
+    anyAsleep = true;
+  }
+
+  // Close the gaps, tiles are kept in body order so they only ever move down
+  if (anyAsleep)
+  {
+    int bodyCount = 0;
+    int tileCount = 0;
+    for (int idx = 0; idx < bodies.count; idx++)
+    {
+      if (asleep[idx])
+      {
+        continue;
+      }
+
+      DebrisBody body = bodies[idx];
+      if (body.firstTile != tileCount)
+      {
+        memmove(&debris.tiles[tileCount], &debris.tiles[body.firstTile], body.tileCount * sizeof(FallingTile));
+        body.firstTile = tileCount;
+      }
+      if (idx != bodyCount)
+      {
+        debris_set_occupant(body, (uint16_t)(bodyCount + 1));
+      }
+      tileCount += body.tileCount;
+      bodies.elements[bodyCount++] = body;
+    }
+    bodies.count = bodyCount;
+    debris.tileCount = tileCount;
+  }
+
+  debris.updateMs = std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+}
@@ -0,0 +1,355 @@
+#include "game.h"
+
+#include <chrono>
+#include <xmmintrin.h>
+
+// ################################     Environment Functions   ################################
+// Heat and gas spread with a 5 point stencil, from one buffer into the other so
+// every cell sees the values of the last tick. Heat moves through everything and
+// slowly fades, gas only moves between open cells and keeps its amount. Both are
+// updated per region, a region that changed less than ENV_EPSILON goes to sleep
+// until something touches it. The regions next to an awake one are updated with
+// it, and the border to a sleeping region is closed, so gas is never lost on the
+// way. Sources live in the other systems: lava heats, water cools, mined coal
+// releases gas and gas that gets hot enough burns
+
+void env_wake(int x, int y)
+{
+  gameState->environment.activeRegions[x / ENV_CELL_SIZE / ENV_REGION_SIZE][y / ENV_CELL_SIZE / ENV_REGION_SIZE] = true;
+}
+
+void env_update_open(int cellX, int cellY)
+{
+  int airTiles = 0;
+  for (int x = cellX * ENV_CELL_SIZE; x < (cellX + 1) * ENV_CELL_SIZE; x++)
+  {
+    for (int y = cellY * ENV_CELL_SIZE; y < (cellY + 1) * ENV_CELL_SIZE; y++)
+    {
+      airTiles += !is_solid(x, y);
+    }
+  }
+  gameState->environment.open[cellX + 1][cellY + 1] = airTiles * (1.0f / (ENV_CELL_SIZE * ENV_CELL_SIZE));
+}
+
+//? Empty fields, openness from the tiles and every region asleep
+void env_reset()
+{
+  EnvironmentGrid &env = gameState->environment;
+  memset(&env, 0, sizeof(env));
+  for (int cellX = 0; cellX < ENV_GRID.x; cellX++)
+  {
+    for (int cellY = 0; cellY < ENV_GRID.y; cellY++)
+    {
+      env_update_open(cellX, cellY);
+    }
+  }
+  env.initialized = true;
+}
+
+void env_add_heat(int x, int y, float heat)
+{
+  EnvironmentGrid &env = gameState->environment;
+  if (!env.initialized)
+  {
+    env_reset();
+  }
+  env.heat[env.front][x / ENV_CELL_SIZE + 1][y / ENV_CELL_SIZE + 1] += heat;
+  env_wake(x, y);
+}
+
+void env_add_gas(int x, int y, float gas)
+{
+  EnvironmentGrid &env = gameState->environment;
+  if (!env.initialized)
+  {
+    env_reset();
+  }
+  env.gas[env.front][x / ENV_CELL_SIZE + 1][y / ENV_CELL_SIZE + 1] += gas;
+  env_wake(x, y);
+}
+
+//? Heat of the cell the tile is in
+float env_get_heat(int x, int y)
+{
+  EnvironmentGrid &env = gameState->environment;
+  return env.heat[env.front][x / ENV_CELL_SIZE + 1][y / ENV_CELL_SIZE + 1];
+}
+
+float env_get_gas(int x, int y)
+{
+  EnvironmentGrid &env = gameState->environment;
+  return env.gas[env.front][x / ENV_CELL_SIZE + 1][y / ENV_CELL_SIZE + 1];
+}
+
+void env_on_tile_changed(int x, int y, MaterialID oldMaterial, MaterialID newMaterial)
+{
+  EnvironmentGrid &env = gameState->environment;
+  if (!env.initialized || (oldMaterial == MATERIAL_AIR) == (newMaterial == MATERIAL_AIR))
+  {
+    return;
+  }
+
+  env_update_open(x / ENV_CELL_SIZE, y / ENV_CELL_SIZE);
+  if (oldMaterial == MATERIAL_COAL)
+  {
+    env_add_gas(x, y, ENV_COAL_GAS);
+  }
+  env_wake(x, y);
+}
+
+//? Whether the region is updated this tick, outside of the world counts as updated
+bool env_is_stepping(int regionX, int regionY)
+{
+  if (regionX < 0 || regionX >= ENV_REGION_GRID.x || regionY < 0 || regionY >= ENV_REGION_GRID.y)
+  {
+    return true;
+  }
+  return gameState->environment.stepping[regionX][regionY];
+}
+
+//? Diffuses heat and gas of one region into the back buffer, returns the biggest change of a cell.
+//? Sleeping neighbours are treated as walls, nothing is lost to a region that doesn't update
+float env_diffuse_region(IVec2 region)
+{
+  EnvironmentGrid &env = gameState->environment;
+  int back = env.front ^ 1;
+
+  // Cells are offset by the border
+  int minX = region.x * ENV_REGION_SIZE + 1;
+  int minY = region.y * ENV_REGION_SIZE + 1;
+  int maxX = min(minX + ENV_REGION_SIZE, ENV_GRID.x + 1);
+  int count = min(ENV_REGION_SIZE, ENV_GRID.y + 1 - minY);
+
+  bool closedLeft = !env_is_stepping(region.x - 1, region.y);
+  bool closedRight = !env_is_stepping(region.x + 1, region.y);
+  bool closedTop = !env_is_stepping(region.x, region.y - 1);
+  bool closedBottom = !env_is_stepping(region.x, region.y + 1);
+
+  __m128 heatRate = _mm_set1_ps(ENV_HEAT_DIFFUSION);
+  __m128 heatKeep = _mm_set1_ps(1.0f - ENV_HEAT_LOSS);
+  __m128 gasRate = _mm_set1_ps(ENV_GAS_DIFFUSION);
+  __m128 four = _mm_set1_ps(4.0f);
+  __m128 signBit = _mm_set1_ps(-0.0f);
+  __m128 maxChange = _mm_setzero_ps();
+  float maxChangeTail = 0.0f;
+
+  // The column with the cells above and below it, those repeat the edge of the region
+  // when that side is closed so nothing flows through it
+  float heatColumn[ENV_REGION_SIZE + 2];
+  float gasColumn[ENV_REGION_SIZE + 2];
+
+  for (int x = minX; x < maxX; x++)
+  {
+    memcpy(heatColumn, &env.heat[env.front][x][minY - 1], (count + 2) * sizeof(float));
+    memcpy(gasColumn, &env.gas[env.front][x][minY - 1], (count + 2) * sizeof(float));
+    if (closedTop)
+    {
+      heatColumn[0] = heatColumn[1];
+      gasColumn[0] = gasColumn[1];
+    }
+    if (closedBottom)
+    {
+      heatColumn[count + 1] = heatColumn[count];
+      gasColumn[count + 1] = gasColumn[count];
+    }
+
+    // Everything is indexed from the cell above the region
+    float *heat = heatColumn;
+    float *heatLeft = x == minX && closedLeft ? heatColumn : &env.heat[env.front][x - 1][minY - 1];
+    float *heatRight = x == maxX - 1 && closedRight ? heatColumn : &env.heat[env.front][x + 1][minY - 1];
+    float *heatOut = &env.heat[back][x][minY - 1];
+    float *gas = gasColumn;
+    float *gasLeft = x == minX && closedLeft ? gasColumn : &env.gas[env.front][x - 1][minY - 1];
+    float *gasRight = x == maxX - 1 && closedRight ? gasColumn : &env.gas[env.front][x + 1][minY - 1];
+    float *gasOut = &env.gas[back][x][minY - 1];
+    float *open = &env.open[x][minY - 1];
+    float *openLeft = &env.open[x - 1][minY - 1];
+    float *openRight = &env.open[x + 1][minY - 1];
+
+    int y = 1;
+    for (; y + 4 <= count + 1; y += 4)
+    {
+      __m128 center = _mm_loadu_ps(heat + y);
+      __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(heatLeft + y), _mm_loadu_ps(heatRight + y)),
+                              _mm_add_ps(_mm_loadu_ps(heat + y - 1), _mm_loadu_ps(heat + y + 1)));
+      __m128 newHeat = _mm_mul_ps(_mm_add_ps(center, _mm_mul_ps(heatRate, _mm_sub_ps(sum, _mm_mul_ps(four, center)))),
+                                  heatKeep);
+      _mm_storeu_ps(heatOut + y, newHeat);
+      maxChange = _mm_max_ps(maxChange, _mm_andnot_ps(signBit, _mm_sub_ps(newHeat, center)));
+
+      // Every pair of cells trades gas by how open both of them are
+      __m128 gasCenter = _mm_loadu_ps(gas + y);
+      __m128 flow = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(openLeft + y), _mm_sub_ps(_mm_loadu_ps(gasLeft + y), gasCenter)),
+                     _mm_mul_ps(_mm_loadu_ps(openRight + y), _mm_sub_ps(_mm_loadu_ps(gasRight + y), gasCenter))),
+          _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(open + y - 1), _mm_sub_ps(_mm_loadu_ps(gas + y - 1), gasCenter)),
+                     _mm_mul_ps(_mm_loadu_ps(open + y + 1), _mm_sub_ps(_mm_loadu_ps(gas + y + 1), gasCenter))));
+      __m128 newGas = _mm_add_ps(gasCenter, _mm_mul_ps(_mm_mul_ps(gasRate, _mm_loadu_ps(open + y)), flow));
+      _mm_storeu_ps(gasOut + y, newGas);
+      maxChange = _mm_max_ps(maxChange, _mm_andnot_ps(signBit, _mm_sub_ps(newGas, gasCenter)));
+    }
+
+    // Same as above for the cells that don't fill 4 lanes
+    for (; y < count + 1; y++)
+    {
+      float center = heat[y];
+      float sum = heatLeft[y] + heatRight[y] + heat[y - 1] + heat[y + 1];
+      heatOut[y] = (center + ENV_HEAT_DIFFUSION * (sum - 4.0f * center)) * (1.0f - ENV_HEAT_LOSS);
+      maxChangeTail = max(maxChangeTail, fabsf(heatOut[y] - center));
+
+      float gasCenter = gas[y];
+      float flow = openLeft[y] * (gasLeft[y] - gasCenter) + openRight[y] * (gasRight[y] - gasCenter) +
+                   open[y - 1] * (gas[y - 1] - gasCenter) + open[y + 1] * (gas[y + 1] - gasCenter);
+      gasOut[y] = gasCenter + ENV_GAS_DIFFUSION * open[y] * flow;
+      maxChangeTail = max(maxChangeTail, fabsf(gasOut[y] - gasCenter));
+    }
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, maxChange);
+  return max(max(max(lanes[0], lanes[1]), max(lanes[2], lanes[3])), maxChangeTail);
+}
+
+//? Lava, water and burning gas in the back buffer of one region, returns the biggest change of a cell
+float env_apply_sources(IVec2 region)
+{
+  EnvironmentGrid &env = gameState->environment;
+  LiquidGrid &liquid = gameState->liquid;
+  int back = env.front ^ 1;
+
+  int minCellX = region.x * ENV_REGION_SIZE;
+  int minCellY = region.y * ENV_REGION_SIZE;
+  int maxCellX = min(minCellX + ENV_REGION_SIZE, ENV_GRID.x);
+  int maxCellY = min(minCellY + ENV_REGION_SIZE, ENV_GRID.y);
+
+  // Chunks without liquid are skipped as a whole
+  bool wet = false;
+  int minChunkX = minCellX * ENV_CELL_SIZE / CHUNK_SIZE;
+  int minChunkY = minCellY * ENV_CELL_SIZE / CHUNK_SIZE;
+  int maxChunkX = (min(maxCellX * ENV_CELL_SIZE, WORLD_GRID.x) - 1) / CHUNK_SIZE;
+  int maxChunkY = (min(maxCellY * ENV_CELL_SIZE, WORLD_GRID.y) - 1) / CHUNK_SIZE;
+  for (int chunkX = minChunkX; chunkX <= maxChunkX && !wet; chunkX++)
+  {
+    for (int chunkY = minChunkY; chunkY <= maxChunkY && !wet; chunkY++)
+    {
+      wet = liquid.wetChunks[chunkX][chunkY];
+    }
+  }
+
+  float maxChange = 0.0f;
+  for (int cellX = minCellX; cellX < maxCellX; cellX++)
+  {
+    for (int cellY = minCellY; cellY < maxCellY; cellY++)
+    {
+      float &heat = env.heat[back][cellX + 1][cellY + 1];
+      float &gas = env.gas[back][cellX + 1][cellY + 1];
+      float oldHeat = heat;
+      float oldGas = gas;
+
+      if (wet)
+      {
+        float lava = 0.0f;
+        float water = 0.0f;
+        for (int x = cellX * ENV_CELL_SIZE; x < min((cellX + 1) * ENV_CELL_SIZE, WORLD_GRID.x); x++)
+        {
+          for (int y = cellY * ENV_CELL_SIZE; y < min((cellY + 1) * ENV_CELL_SIZE, WORLD_GRID.y); y++)
+          {
+            float mass = min(liquid.mass[x][y], LIQUID_MAX_MASS);
+            lava += liquid.type[x][y] == LIQUID_LAVA ? mass : 0.0f;
+            water += liquid.type[x][y] == LIQUID_WATER ? mass : 0.0f;
+          }
+        }
+        heat += lava * ENV_LAVA_HEAT;
+        heat -= heat * min(water * ENV_WATER_COOLING, 1.0f);
+      }
+
+      if (gas > ENV_IGNITE_GAS && heat > ENV_IGNITE_HEAT)
+      {
+        float burned = gas * ENV_BURN_RATE;
+        gas -= burned;
+        heat += burned * ENV_BURN_HEAT;
+      }
+
+      maxChange = max(maxChange, max(fabsf(heat - oldHeat), fabsf(gas - oldGas)));
+    }
+  }
+  return maxChange;
+}
+
+//? Copies the region from the back buffer to the front one, so both agree while it sleeps
+void env_settle_region(IVec2 region)
+{
+  EnvironmentGrid &env = gameState->environment;
+  int back = env.front ^ 1;
+  int minX = region.x * ENV_REGION_SIZE + 1;
+  int minY = region.y * ENV_REGION_SIZE + 1;
+  int maxX = min(minX + ENV_REGION_SIZE, ENV_GRID.x + 1);
+  int count = min(ENV_REGION_SIZE, ENV_GRID.y + 1 - minY);
+  for (int x = minX; x < maxX; x++)
+  {
+    memcpy(&env.heat[env.front][x][minY], &env.heat[back][x][minY], count * sizeof(float));
+    memcpy(&env.gas[env.front][x][minY], &env.gas[back][x][minY], count * sizeof(float));
+  }
+}
+
+void env_update()
+{
+  EnvironmentGrid &env = gameState->environment;
+  if (!env.initialized)
+  {
+    env_reset();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  // Awake regions and their neighbours, so what leaves an awake region arrives somewhere
+  for (int regionX = 0; regionX < ENV_REGION_GRID.x; regionX++)
+  {
+    for (int regionY = 0; regionY < ENV_REGION_GRID.y; regionY++)
+    {
+      env.stepping[regionX][regionY] =
+          env.activeRegions[regionX][regionY] ||
+          (regionX > 0 && env.activeRegions[regionX - 1][regionY]) ||
+          (regionX < ENV_REGION_GRID.x - 1 && env.activeRegions[regionX + 1][regionY]) ||
+          (regionY > 0 && env.activeRegions[regionX][regionY - 1]) ||
+          (regionY < ENV_REGION_GRID.y - 1 && env.activeRegions[regionX][regionY + 1]);
+    }
+  }
+
+  int stepped = 0;
+  for (int regionX = 0; regionX < ENV_REGION_GRID.x; regionX++)
+  {
+    for (int regionY = 0; regionY < ENV_REGION_GRID.y; regionY++)
+    {
+      env.activeRegions[regionX][regionY] = false;
+      if (!env.stepping[regionX][regionY])
+      {
+        continue;
+      }
+      stepped++;
+
+      float change = env_diffuse_region({regionX, regionY});
+      change = max(change, env_apply_sources({regionX, regionY}));
+      env.activeRegions[regionX][regionY] = change >= ENV_EPSILON;
+    }
+  }
+
+  // Regions going to sleep hold the same values in both buffers. Only done once
+  // every region has read the front buffer
+  for (int regionX = 0; regionX < ENV_REGION_GRID.x; regionX++)
+  {
+    for (int regionY = 0; regionY < ENV_REGION_GRID.y; regionY++)
+    {
+      if (env.stepping[regionX][regionY] && !env.activeRegions[regionX][regionY])
+      {
+        env_settle_region({regionX, regionY});
+      }
+    }
+  }
+  env.front ^= 1;
+
+  env.steppedRegions = stepped;
+  env.updateMs = std::chrono::duration<float, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+}
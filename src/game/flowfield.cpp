@@ -0,0 +1,433 @@
+#include "game.h"
+
+#include <algorithm>
+#include <chrono>
+
+// ################################     Flow Field Functions   ################################
+// One field answers "which way to the goal" for every tile at once, so any number
+// of agents chasing the same goal cost a single lookup each. The costs are a
+// breadth first search out from the goal (every step costs 1), then every tile
+// points at its cheapest neighbour.
+// A new goal is built into the back layer with a budget per tick while agents keep
+// following the front layer. A goal that moves during a build waits for it to finish.
+// Edits are patched into the front layer right away: an opened tile lowers the costs
+// around it, a new wall raises the ones that led through it. Edits during a build are
+// patched into the new layer once it is done
+
+// Top, Left, Right, Bottom, Topleft, Topright, Bottomleft, Bottomright, same order as the neighbourMask
+static const int flowOffsets[16] = {0, -1, -1, 0, 1, 0, 0, 1,
+                                    -1, -1, 1, -1, -1, 1, 1, 1};
+static const Vec2 flowDirections[FLOW_DIR_NONE + 1] = {
+    {0.0f, -1.0f}, {-1.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f},
+    {-0.7071f, -0.7071f}, {0.7071f, -0.7071f}, {-0.7071f, 0.7071f}, {0.7071f, 0.7071f},
+    {0.0f, 0.0f}};
+
+//? Cheapest neighbour of the tile, diagonals can't cut past solid corners
+uint8_t flow_pick_direction(FlowLayer &layer, int x, int y)
+{
+  int best = layer.costs[x][y];
+  uint8_t direction = FLOW_DIR_NONE;
+  if (best == NAV_UNREACHABLE)
+  {
+    return direction;
+  }
+
+  for (int dir = 0; dir < 8; dir++)
+  {
+    int nx = x + flowOffsets[dir * 2];
+    int ny = y + flowOffsets[dir * 2 + 1];
+    if (is_solid(nx, ny) || layer.costs[nx][ny] >= best)
+    {
+      continue;
+    }
+    if (dir >= 4 && (is_solid(nx, y) || is_solid(x, ny)))
+    {
+      continue;
+    }
+
+    best = layer.costs[nx][ny];
+    direction = (uint8_t)dir;
+  }
+  return direction;
+}
+
+//? Starts building the field for goal into the back layer
+void flow_start_build(FlowField &field, IVec2 goal)
+{
+  FlowLayer &layer = field.layers[1 - field.front];
+  memset(layer.costs, 0xFF, sizeof(layer.costs));
+
+  field.stage = FLOW_INTEGRATE;
+  field.restart = false;
+  field.changedTiles.clear();
+  field.buildGoal = goal;
+  field.queueHead = field.queueTail = 0;
+  field.directionColumn = 0;
+
+  if (!is_solid(goal.x, goal.y))
+  {
+    layer.costs[goal.x][goal.y] = 0;
+    field.queue[field.queueTail++] = goal.x * WORLD_GRID.y + goal.y;
+  }
+}
+
+//? Agents head to goal (in tiles) once the field for it is built
+void flow_set_goal(FlowField &field, IVec2 goal)
+{
+  goal.x = min(max(goal.x, 0), WORLD_GRID.x - 1);
+  goal.y = min(max(goal.y, 0), WORLD_GRID.y - 1);
+
+  // Restarting on every step of the player would never finish a build
+  if (field.stage != FLOW_IDLE)
+  {
+    field.goalPending = goal.x != field.buildGoal.x || goal.y != field.buildGoal.y;
+    field.pendingGoal = goal;
+    return;
+  }
+  if (field.valid && goal.x == field.goal.x && goal.y == field.goal.y)
+  {
+    return;
+  }
+  flow_start_build(field, goal);
+}
+
+//? Points the open tiles of the rect (clamped to the world) at their cheapest neighbour again
+void flow_refresh_directions(FlowLayer &layer, int minX, int minY, int maxX, int maxY)
+{
+  for (int x = max(minX, 0); x <= min(maxX, WORLD_GRID.x - 1); x++)
+  {
+    for (int y = max(minY, 0); y <= min(maxY, WORLD_GRID.y - 1); y++)
+    {
+      if (!is_solid(x, y))
+      {
+        layer.directions[x][y] = flow_pick_direction(layer, x, y);
+      }
+    }
+  }
+}
+
+//? Spreads lowered costs from the first seedCount tiles of the queue, sorted by cost.
+//? The seeds and the tiles they lower are taken cheapest first, like a breadth first
+//? search, so most tiles are only visited once. False if the queue ran out
+bool flow_spread(FlowField &field, int seedCount)
+{
+  FlowLayer &layer = field.layers[field.front];
+  uint16_t *costs = &layer.costs[0][0];
+  int seedHead = 0;
+  field.queueHead = field.queueTail = seedCount;
+
+  while (seedHead < seedCount || field.queueHead < field.queueTail)
+  {
+    uint32_t idx;
+    if (field.queueHead == field.queueTail ||
+        (seedHead < seedCount && costs[field.queue[seedHead]] <= costs[field.queue[field.queueHead]]))
+    {
+      idx = field.queue[seedHead++];
+    }
+    else
+    {
+      idx = field.queue[field.queueHead++];
+    }
+    int tileX = idx / WORLD_GRID.y;
+    int tileY = idx % WORLD_GRID.y;
+    int cost = layer.costs[tileX][tileY] + 1;
+
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = tileX + flowOffsets[dir * 2];
+      int ny = tileY + flowOffsets[dir * 2 + 1];
+      if (is_solid(nx, ny) || layer.costs[nx][ny] <= cost)
+      {
+        continue;
+      }
+      if (field.queueTail == (int)ArraySize(field.queue))
+      {
+        return false;
+      }
+      layer.costs[nx][ny] = (uint16_t)cost;
+      field.queue[field.queueTail++] = nx * WORLD_GRID.y + ny;
+    }
+
+    // Cheaper tiles change where their neighbours point
+    for (int dir = -1; dir < 8; dir++)
+    {
+      int nx = dir < 0 ? tileX : tileX + flowOffsets[dir * 2];
+      int ny = dir < 0 ? tileY : tileY + flowOffsets[dir * 2 + 1];
+      if (!is_solid(nx, ny))
+      {
+        layer.directions[nx][ny] = flow_pick_direction(layer, nx, ny);
+      }
+    }
+  }
+  return true;
+}
+
+//? Lowers the costs around an opened tile, the change spreads until it stops helping
+void flow_patch_opened(FlowField &field, int x, int y)
+{
+  FlowLayer &layer = field.layers[field.front];
+
+  int best = NAV_UNREACHABLE;
+  for (int dir = 0; dir < 4; dir++)
+  {
+    int nx = x + flowOffsets[dir * 2];
+    int ny = y + flowOffsets[dir * 2 + 1];
+    if (!is_solid(nx, ny))
+    {
+      best = min(best, (int)layer.costs[nx][ny]);
+    }
+  }
+  if (best == NAV_UNREACHABLE || best + 1 >= layer.costs[x][y])
+  {
+    // No cost drops, but diagonals can cut past the tile now
+    flow_refresh_directions(layer, x - 1, y - 1, x + 1, y + 1);
+    return;
+  }
+
+  // The queue is free while no build is running
+  layer.costs[x][y] = (uint16_t)(best + 1);
+  field.queue[0] = x * WORLD_GRID.y + y;
+  if (!flow_spread(field, 1))
+  {
+    flow_start_build(field, field.goal);
+  }
+}
+
+//? Raises the costs that led through a new wall. A tile left without a neighbour one
+//? step closer to the goal loses its cost, and so can the tiles that leaned on it.
+//? Tiles are checked in order of cost, the neighbours they could lean on are settled
+//? by then. The lost tiles take the cheapest cost left around them and spread it
+void flow_patch_closed(FlowField &field, int x, int y)
+{
+  FlowLayer &layer = field.layers[field.front];
+  int wallCost = layer.costs[x][y];
+  layer.costs[x][y] = NAV_UNREACHABLE;
+  layer.directions[x][y] = FLOW_DIR_NONE;
+
+  // Directions next to the wall change even if no cost does, diagonals can't cut past it
+  int minX = x - 1, minY = y - 1, maxX = x + 1, maxY = y + 1;
+
+  // The queue is free while no build is running
+  field.queueHead = field.queueTail = 0;
+  for (int dir = 0; dir < 4 && wallCost != NAV_UNREACHABLE; dir++)
+  {
+    int nx = x + flowOffsets[dir * 2];
+    int ny = y + flowOffsets[dir * 2 + 1];
+    if (!is_solid(nx, ny) && layer.costs[nx][ny] == wallCost + 1)
+    {
+      field.queue[field.queueTail++] = nx * WORLD_GRID.y + ny;
+    }
+  }
+
+  while (field.queueHead < field.queueTail)
+  {
+    uint32_t idx = field.queue[field.queueHead++];
+    int tileX = idx / WORLD_GRID.y;
+    int tileY = idx % WORLD_GRID.y;
+    int cost = layer.costs[tileX][tileY];
+    if (cost == NAV_UNREACHABLE)
+    {
+      continue;
+    }
+
+    bool supported = false;
+    for (int dir = 0; dir < 4 && !supported; dir++)
+    {
+      int nx = tileX + flowOffsets[dir * 2];
+      int ny = tileY + flowOffsets[dir * 2 + 1];
+      supported = !is_solid(nx, ny) && layer.costs[nx][ny] == cost - 1;
+    }
+    if (supported)
+    {
+      continue;
+    }
+
+    layer.costs[tileX][tileY] = NAV_UNREACHABLE;
+    layer.directions[tileX][tileY] = FLOW_DIR_NONE;
+    minX = min(minX, tileX - 1);
+    minY = min(minY, tileY - 1);
+    maxX = max(maxX, tileX + 1);
+    maxY = max(maxY, tileY + 1);
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = tileX + flowOffsets[dir * 2];
+      int ny = tileY + flowOffsets[dir * 2 + 1];
+      if (is_solid(nx, ny) || layer.costs[nx][ny] != cost + 1)
+      {
+        continue;
+      }
+      if (field.queueTail == (int)ArraySize(field.queue))
+      {
+        flow_start_build(field, field.goal);
+        return;
+      }
+      field.queue[field.queueTail++] = nx * WORLD_GRID.y + ny;
+    }
+  }
+
+  // The lost tiles are still in the queue, the ones next to a kept tile become the seeds
+  int seedCount = 0;
+  for (int queueIdx = 0; queueIdx < field.queueTail; queueIdx++)
+  {
+    uint32_t idx = field.queue[queueIdx];
+    int tileX = idx / WORLD_GRID.y;
+    int tileY = idx % WORLD_GRID.y;
+    if (layer.costs[tileX][tileY] != NAV_UNREACHABLE)
+    {
+      continue;
+    }
+
+    int best = NAV_UNREACHABLE;
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = tileX + flowOffsets[dir * 2];
+      int ny = tileY + flowOffsets[dir * 2 + 1];
+      if (!is_solid(nx, ny))
+      {
+        best = min(best, (int)layer.costs[nx][ny]);
+      }
+    }
+    if (best != NAV_UNREACHABLE)
+    {
+      layer.costs[tileX][tileY] = (uint16_t)(best + 1);
+      field.queue[seedCount++] = idx;
+    }
+  }
+  uint16_t *costs = &layer.costs[0][0];
+  std::sort(field.queue, field.queue + seedCount, [costs](uint32_t a, uint32_t b)
+            { return costs[a] < costs[b]; });
+
+  if (!flow_spread(field, seedCount))
+  {
+    flow_start_build(field, field.goal);
+    return;
+  }
+
+  // Tiles that can't reach the goal anymore were never spread to, their neighbours still point at them
+  flow_refresh_directions(layer, minX, minY, maxX, maxY);
+}
+
+//? Patches the edit into the front layer, or remembers it for the layer being built
+void flow_patch_tile(FlowField &field, int x, int y)
+{
+  if (is_solid(x, y))
+  {
+    flow_patch_closed(field, x, y);
+  }
+  else
+  {
+    flow_patch_opened(field, x, y);
+  }
+}
+
+void flow_on_tile_changed(FlowField &field, int x, int y)
+{
+  if (field.stage != FLOW_IDLE)
+  {
+    if (field.changedTiles.is_full())
+    {
+      field.restart = true;
+    }
+    else
+    {
+      field.changedTiles.add({x, y});
+    }
+    return;
+  }
+  if (field.valid)
+  {
+    flow_patch_tile(field, x, y);
+  }
+}
+
+//? Continues the build of the back layer, swaps it to the front when done
+void flow_update(FlowField &field)
+{
+  if (field.stage == FLOW_IDLE)
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  if (field.restart)
+  {
+    flow_start_build(field, field.goalPending ? field.pendingGoal : field.buildGoal);
+    field.goalPending = false;
+  }
+
+  FlowLayer &layer = field.layers[1 - field.front];
+  int budget = FLOW_BUDGET;
+
+  while (field.stage == FLOW_INTEGRATE && budget > 0)
+  {
+    if (field.queueHead == field.queueTail)
+    {
+      field.stage = FLOW_DIRECTIONS;
+      break;
+    }
+
+    uint32_t idx = field.queue[field.queueHead++];
+    int x = idx / WORLD_GRID.y;
+    int y = idx % WORLD_GRID.y;
+    int cost = layer.costs[x][y] + 1;
+    budget--;
+
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = x + flowOffsets[dir * 2];
+      int ny = y + flowOffsets[dir * 2 + 1];
+      if (is_solid(nx, ny) || layer.costs[nx][ny] != NAV_UNREACHABLE)
+      {
+        continue;
+      }
+      layer.costs[nx][ny] = (uint16_t)cost;
+      field.queue[field.queueTail++] = nx * WORLD_GRID.y + ny;
+    }
+  }
+
+  while (field.stage == FLOW_DIRECTIONS && budget > 0)
+  {
+    int x = field.directionColumn++;
+    for (int y = 0; y < WORLD_GRID.y; y++)
+    {
+      layer.directions[x][y] = flow_pick_direction(layer, x, y);
+    }
+    budget -= WORLD_GRID.y;
+
+    if (field.directionColumn == WORLD_GRID.x)
+    {
+      field.front = 1 - field.front;
+      field.goal = field.buildGoal;
+      field.valid = true;
+      field.stage = FLOW_IDLE;
+      field.builds++;
+
+      // The build may have seen part of an edit, patching reads the grid as it is now
+      for (int idx = 0; idx < field.changedTiles.count && field.stage == FLOW_IDLE; idx++)
+      {
+        flow_patch_tile(field, field.changedTiles[idx].x, field.changedTiles[idx].y);
+      }
+      field.changedTiles.clear();
+
+      if (field.goalPending && field.stage == FLOW_IDLE)
+      {
+        field.goalPending = false;
+        flow_start_build(field, field.pendingGoal);
+      }
+    }
+  }
+
+  field.updateMs = std::chrono::duration<float, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+}
+
+//? Unit vector to walk along at the tile, zero at the goal or when the goal can't be reached
+Vec2 flow_get_direction(FlowField &field, IVec2 tile)
+{
+  if (!field.valid || tile.x < 0 || tile.x >= WORLD_GRID.x || tile.y < 0 || tile.y >= WORLD_GRID.y)
+  {
+    return {};
+  }
+  return flowDirections[field.layers[field.front].directions[tile.x][tile.y]];
+}
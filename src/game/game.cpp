@@ -1,118 +1,31 @@
 #include "game.h"
 #include "../engine_utils/ecs.cpp"
+#include "../engine_utils/physics_system.h"
+#include "lighting.cpp"
+#include "environment.cpp"
+#include "liquid.cpp"
+#include "pathfinding.cpp"
+#include "flowfield.cpp"
+#include "integrity.cpp"
+#include "debris.cpp"
+#include "raycast.cpp"
+#include "sdf.cpp"
+#include "damage.cpp"
+#include "particles.cpp"
+#include "projectiles.cpp"
+#include "tiles.cpp"
+#include "carve.cpp"
+#include "persistence.cpp"
 
 // ################################     Game Constants   ################################
 ecs::World world;
+ecs::PhysicsSystem *physics;
+ecs::BroadphaseSystem *broadphase;
+ecs::Entity playerEntity; // Moves the GameState player
 // ################################     Game Structs   ################################
 
 // ################################     Game Functions   ################################
 
-// Grid system
-IVec2 get_grid_pos(IVec2 worldPos)
-{
-  return {worldPos.x / TILESIZE, worldPos.y / TILESIZE};
-}
-
-// tile system
-Tile *get_tile(int x, int y)
-{
-  Tile *tile = nullptr;
-
-  if (x >= 0 && x < WORLD_GRID.x && y >= 0 && y < WORLD_GRID.y)
-  {
-    tile = &gameState->worldGrid[x][y];
-  }
-
-  return tile;
-}
-
-Tile *get_tile(IVec2 worldPos)
-{
-  IVec2 gridPos = get_grid_pos(worldPos);
-  return get_tile(gridPos.x, gridPos.y);
-}
-
-IVec2 get_tile_pos(int x, int y)
-{
-  return {x * TILESIZE, y * TILESIZE};
-}
-
-IRect get_tile_rect(int x, int y)
-{
-  return {get_tile_pos(x, y), TILESIZE, TILESIZE};
-}
-
-void update_tiles()
-{
-  // Neighbouring Tiles        Top    Left      Right       Bottom
-  int neighbourOffsets[24] = {0, -1, -1, 0, 1, 0, 0, 1,
-                              //                          Topleft Topright Bottomleft Bottomright
-                              -1, -1, 1, -1, -1, 1, 1, 1,
-                              //                           Top2   Left2     Right2      Bottom2
-                              0, -2, -2, 0, 2, 0, 0, 2};
-
-  // Topleft     = BIT(4) = 16
-  // Toplright   = BIT(5) = 32
-  // Bottomleft  = BIT(6) = 64
-  // Bottomright = BIT(7) = 128
-
-  for (int y = 0; y < WORLD_GRID.y; y++)
-  {
-    for (int x = 0; x < WORLD_GRID.x; x++)
-    {
-      Tile *tile = get_tile(x, y);
-
-      if (!tile->isVisible)
-      {
-        continue;
-      }
-
-      tile->neighbourMask = 0;
-      int neighbourCount = 0;
-      int extendedNeighbourCount = 0;
-      int emptyNeighbourSlot = 0;
-
-      // Look at the sorrounding 12 Neighbours
-      for (int n = 0; n < 12; n++)
-      {
-        Tile *neighbour = get_tile(x + neighbourOffsets[n * 2],
-                                   y + neighbourOffsets[n * 2 + 1]);
-
-        // No neighbour means the edge of the world
-        if (!neighbour || neighbour->isVisible)
-        {
-          tile->neighbourMask |= BIT(n);
-          if (n < 8) // Counting direct neighbours
-          {
-            neighbourCount++;
-          }
-          else // Counting neighbours 1 Tile away
-          {
-            extendedNeighbourCount++;
-          }
-        }
-        else if (n < 8)
-        {
-          emptyNeighbourSlot = n;
-        }
-      }
-
-      if (neighbourCount == 7 && emptyNeighbourSlot >= 4) // We have a corner
-      {
-        tile->neighbourMask = 16 + (emptyNeighbourSlot - 4);
-      }
-      else if (neighbourCount == 8 && extendedNeighbourCount == 4)
-      {
-        tile->neighbourMask = 20;
-      }
-      else
-      {
-        tile->neighbourMask = tile->neighbourMask & 0b1111;
-      }
-    }
-  }
-}
-
 // input
 bool just_pressed(GameInputType type)
 {
@@ -155,112 +68,196 @@ IRect get_world_AABB(Transform transform)
 }
 
 // Physics
-void Move(Transform &transform)
+//? Tile holding the pixel, also for pixels left or above the world
+int pixel_to_tile(int pixel)
 {
-  IRect rect = get_world_AABB(transform);
-
-  // get how big in tiles the transform is
-  IVec2 boundingSize = {(rect.size.x / TILESIZE), (rect.size.y / TILESIZE)};
-
-  transform.remainder.x += transform.speed.x;
-  int moveX = round(transform.remainder.x);
+  return (pixel >= 0 ? pixel : pixel - TILESIZE + 1) / TILESIZE;
+}
 
-  if (moveX != 0)
+//? How many of the move pixels along axis (0 = x, 1 = y) rect gets through before
+//? it would overlap a colliding tile, sets blocked if one stops it. Tiles are
+//? looked at a line at a time from the rect outwards, so the cost is the tiles
+//? the move crosses and not the pixels
+int sweep_tiles(IRect rect, int axis, int move, bool &blocked)
+{
+  int rectPos[2] = {rect.pos.x, rect.pos.y};
+  int rectSize[2] = {rect.size.x, rect.size.y};
+  int worldSize[2] = {WORLD_GRID.x, WORLD_GRID.y};
+  int cross = 1 - axis;
+  int low = rectPos[axis];
+  int high = low + rectSize[axis];
+  int steps = abs(move);
+  int step = sign(move);
+  blocked = false;
+
+  // Tiles beside the rect never get in the way
+  int firstCross = max(pixel_to_tile(rectPos[cross]), 0);
+  int lastCross = min(pixel_to_tile(rectPos[cross] + rectSize[cross] - 1), worldSize[cross] - 1);
+
+  // Lines of tiles the rect overlaps over steps 1..steps, nearest first
+  int firstLine = step > 0 ? max(pixel_to_tile(low + 1), 0) : min(pixel_to_tile(high - 2), worldSize[axis] - 1);
+  int lastLine = step > 0 ? min(pixel_to_tile(high + steps - 1), worldSize[axis] - 1) : max(pixel_to_tile(low - steps), 0);
+  if (firstCross > lastCross || (lastLine - firstLine) * step < 0)
   {
-    transform.remainder.x -= moveX;
-    int moveSign = sign(moveX);
-    bool collided = false;
+    return steps;
+  }
 
-    auto moveTransformX = [&]
+  for (int line = firstLine; line != lastLine + step; line += step)
+  {
+    for (int crossLine = firstCross; crossLine <= lastCross; crossLine++)
     {
-      while (moveX)
+      Tile &tile = axis == 0 ? gameState->worldGrid[line][crossLine] : gameState->worldGrid[crossLine][line];
+      if (!materialTable.collides[tile.material])
       {
-        rect.pos.x += moveSign;
+        continue;
+      }
 
-        // loop through local tiles
-        IVec2 gridPos = get_grid_pos(transform.pos);
+      // First step on which the rect overlaps this line
+      int tilePos = line * TILESIZE;
+      int hitStep = step > 0 ? max(1, tilePos - high + 1) : max(1, low - tilePos - TILESIZE + 1);
+      blocked = true;
+      return hitStep - 1;
+    }
+  }
+  return steps;
+}
 
-        for (int x = gridPos.x - boundingSize.x; x <= gridPos.x + boundingSize.x; x++)
-        {
-          for (int y = gridPos.y - boundingSize.y; y <= gridPos.y + boundingSize.y; y++)
-          {
-            Tile *tile = get_tile(x, y);
+//? Moves the box centred on pos by speed one axis at a time, x first, and stops
+//? it on the axis where it runs into a colliding tile. Same result as stepping
+//? pixel by pixel and testing the tiles after every step
+void move_box(IVec2 &pos, IVec2 aabb, SimVec2 &speed, SimVec2 &remainder, bool &hasCollided, bool &isGrounded)
+{
+  IRect rect = {pos.x - aabb.x / 2, pos.y - aabb.y / 2, aabb.x, aabb.y};
+  int probeX = 0;
 
-            if (!tile || !tile->isVisible)
-            {
-              continue;
-            }
-            // Check collision
-            if (rect_collision(rect, get_tile_rect(x, y)))
-            {
-              transform.hasCollided = true;
-              transform.speed.x = 0;
-              return;
-            }
-          }
-        }
+  remainder.x += speed.x;
+  int moveX = round(remainder.x);
 
-        // Move
-        transform.pos.x += moveSign;
-        moveX -= moveSign;
+  if (moveX != 0)
+  {
+    remainder.x -= moveX;
 
-        rect = get_world_AABB(transform);
-      }
-    };
-    moveTransformX();
+    bool blocked;
+    int moved = sweep_tiles(rect, 0, moveX, blocked);
+    pos.x += moved * sign(moveX);
+    rect.pos.x = pos.x - aabb.x / 2;
+
+    if (blocked)
+    {
+      hasCollided = true;
+      speed.x = SimFloat(0.0f);
+      probeX = sign(moveX);
+    }
   }
 
-  transform.remainder.y += transform.speed.y;
-  int moveY = round(transform.remainder.y);
+  remainder.y += speed.y;
+  int moveY = round(remainder.y);
 
   if (moveY != 0)
   {
-    transform.remainder.y -= moveY;
-    int moveSign = sign(moveY);
-    bool collided = false;
+    remainder.y -= moveY;
+
+    int step = sign(moveY);
+    bool blocked = false;
+    int moved = 0;
 
-    auto moveTransformY = [&]
+    // Only the first y step is tested from the pixel that touched the wall,
+    // the rest from where the body is, so it doesn't stick to the wall
+    if (probeX)
     {
-      while (moveY)
+      IRect probe = {rect.pos.x + probeX, rect.pos.y, rect.size.x, rect.size.y};
+      moved = sweep_tiles(probe, 1, step, blocked);
+      rect.pos.y += moved * step;
+    }
+    if (!blocked && moved * step != moveY)
+    {
+      moved += sweep_tiles(rect, 1, moveY - moved * step, blocked);
+    }
+    pos.y += moved * step;
+
+    if (blocked)
+    {
+      hasCollided = true;
+      // Moving down/falling
+      if (speed.y > SimFloat(0.0f))
       {
-        rect.pos.y += moveSign;
+        isGrounded = true;
+      }
+      speed.y = SimFloat(0.0f);
+    }
+  }
+}
 
-        // loop through local tiles
-        IVec2 gridPos = get_grid_pos(transform.pos);
+void Move(Transform &transform)
+{
+  move_box(transform.pos, transform.aabb, transform.speed, transform.remainder,
+           transform.hasCollided, transform.isGrounded);
+}
 
-        for (int x = gridPos.x - boundingSize.x; x <= gridPos.x + boundingSize.x; x++)
-        {
-          for (int y = gridPos.y - boundingSize.y; y <= gridPos.y + boundingSize.y; y++)
-          {
-            Tile *tile = get_tile(x, y);
+//? The ECS world is a DLL global, so it is built again from the GameState after every reload
+void init_world()
+{
+  world.add_system<ecs::MovementSystem>(world.transforms, world.velocities);
+  world.add_system<ecs::ScriptSystem>(world.scripts);
+  physics = world.add_system<ecs::PhysicsSystem>(world.transforms, world.bodies);
+  broadphase = world.add_system<ecs::BroadphaseSystem>(world.transforms, world.colliders);
 
-            if (!tile || !tile->isVisible)
-            {
-              continue;
-            }
-            // Check collision
-            IRect tileRect = get_tile_rect(x, y);
-            if (rect_collision(rect, tileRect))
-            {
-              transform.hasCollided = true;
-              // Moving down/falling
-              if (transform.speed.y > 0.0f)
-              {
-                transform.isGrounded = true;
-              }
-              transform.speed.y = 0;
-              return;
-            }
-          }
-        }
+  Transform &player = gameState->player;
+  ecs::PhysicsBody body = {};
+  body.aabb = player.aabb;
 
-        // Move
-        transform.pos.y += moveSign;
-        moveY -= moveSign;
-      }
-    };
-    moveTransformY();
+  playerEntity = world.create_entity();
+  world.transforms.add(playerEntity, {(float)player.pos.x, (float)player.pos.y});
+  world.bodies.add(playerEntity, body);
+  world.colliders.add(playerEntity, {player.aabb.x / 2.0f, player.aabb.y / 2.0f});
+}
+
+// Determinism
+uint32_t hash_word(uint32_t hash, uint32_t word)
+{
+  // FNV-1a a word at a time
+  return (hash ^ word) * 16777619u;
+}
+
+uint32_t hash_sim_float(uint32_t hash, SimFloat value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return hash_word(hash, bits);
+}
+
+//? Hash of the tiles and of every physics body. Two runs fed the same input stay
+//? in step as long as their checksums agree, which in a FIXED_SIMULATION build
+//? holds across machines and compilers as well
+uint32_t simulation_checksum()
+{
+  static_assert(sizeof(gameState->worldGrid) % sizeof(uint32_t) == 0, "The grid is hashed a word at a time");
+
+  uint32_t hash = 2166136261u;
+  const uint32_t *tileWords = (const uint32_t *)gameState->worldGrid;
+  for (size_t idx = 0; idx < sizeof(gameState->worldGrid) / sizeof(uint32_t); idx++)
+  {
+    hash = hash_word(hash, tileWords[idx]);
   }
+
+  for (size_t idx = 0; idx < world.bodies.dense.size(); idx++)
+  {
+    ecs::Entity e = world.bodies.entities[idx];
+    ecs::PhysicsBody &body = world.bodies.dense[idx];
+    hash = hash_word(hash, e);
+    if (world.transforms.has(e))
+    {
+      ecs::TransformHot &pos = world.transforms.get(e);
+      hash = hash_word(hash, (uint32_t)(int)pos.x);
+      hash = hash_word(hash, (uint32_t)(int)pos.y);
+    }
+    hash = hash_sim_float(hash, body.speed.x);
+    hash = hash_sim_float(hash, body.speed.y);
+    hash = hash_sim_float(hash, body.remainder.x);
+    hash = hash_sim_float(hash, body.remainder.y);
+    hash = hash_word(hash, body.hasCollided | body.isGrounded << 1);
+  }
+  return hash;
 }
 
 // ################################     Game Functions (exposed)   ################################
@@ -273,9 +270,15 @@ EXPORT_FN void update_game(GameState *gameStateIn, RenderData *renderDataIn, Inp
     input = inputIn;
     gameState = gameStateIn;
     soundState = soundStateIn;
+
+    // DLL globals are reset on reload
+    init_material_table();
   }
   if (!gameState->initialized)
   {
+    // renderData comes from zeroed memory, so the default zoom never ran
+    renderData->gameCamera.zoom = 1.0f;
+    renderData->uiCamera.zoom = 1.0f;
     renderData->gameCamera.dimensions = {WORLD_WIDTH, WORLD_HEIGHT};
     renderData->gameCamera.position.x = 160;
     renderData->gameCamera.position.y = -90;
@@ -300,30 +303,28 @@ EXPORT_FN void update_game(GameState *gameStateIn, RenderData *renderDataIn, Inp
 
       gameState->keyMappings[SECONDARY].keys.add(KEY_MOUSE_RIGHT);
       gameState->keyMappings[SECONDARY].keys.add(KEY_X);
+
+      gameState->keyMappings[MOUSE_MIDDLE].keys.add(KEY_MOUSE_MIDDLE);
       // Other
       gameState->keyMappings[JUMP].keys.add(KEY_SPACE);
 
       gameState->keyMappings[MENU].keys.add(KEY_ESCAPE);
       gameState->keyMappings[DEBUG_MENU].keys.add(KEY_F3);
+      gameState->keyMappings[QUICK_SAVE].keys.add(KEY_F5);
+      gameState->keyMappings[QUICK_LOAD].keys.add(KEY_F9);
+      gameState->keyMappings[TOGGLE_MINIMAP].keys.add(KEY_M);
+      gameState->keyMappings[PLACE_WALL].keys.add(KEY_B);
+      gameState->keyMappings[FIRE].keys.add(KEY_F);
     }
 
-    // Tileset
-    {
-      IVec2 tilesPosition = {0, 64};
-      for (int y = 0; y < 5; y++)
-      {
-        for (int x = 0; x < 4; x++)
-        {
-          gameState->tileCoords.add({tilesPosition.x + x * 8, tilesPosition.y + y * 8});
-        }
-      }
-      // Black inside
-      gameState->tileCoords.add({tilesPosition.x, tilesPosition.y + 5 * 8});
-    }
-
+    rebuild_occupancy();
     init();
     gameState->initialized = true;
   }
+  if (world.systems.empty())
+  {
+    init_world();
+  }
 
   // updates in game
   // Fixed Update Loop
@@ -355,10 +356,6 @@ EXPORT_FN void update_game(GameState *gameStateIn, RenderData *renderDataIn, Inp
 
 void init()
 {
-  world.add_system<ecs::MovementSystem>(world.transforms, world.velocities);
-  world.add_system<ecs::ScriptSystem>(world.scripts);
-
-  /*
   gameState->player.aabb =
       {
           8,
@@ -366,150 +363,214 @@ void init()
   gameState->player.animationSprites[PLAYER_ANIM_IDLE] = SPRITE_PLAYER;
   gameState->player.animationSprites[PLAYER_ANIM_RUN] = SPRITE_PLAYER_RUN;
   gameState->player.animationSprites[PLAYER_ANIM_JUMP] = SPRITE_PLAYER_JUMP;
-  */
 }
 
 void fixed_update()
 {
   float dt = UPDATE_DELAY;
 
-  if (just_pressed(PRIMARY))
+  if (just_pressed(PRIMARY) && world.count_alive() - 1 != playerEntity)
   {
     ecs::Entity entity = world.count_alive() - 1;
     world.destroy_entity(entity);
 
     LOG_DEBUG("Destroyed entity, id %d", entity);
   }
-  if (just_pressed(SECONDARY))
+  if (just_pressed(DEBUG_MENU))
   {
-    ecs::Entity entity = world.create_entity();
-    world.transforms.add(entity, ecs::TransformHot{0, 0});
+    world.log_entities();
 
-    LOG_DEBUG("Created entity, id %d", entity);
+    RenderStats stats = renderData->stats;
+    LOG_INFO("Last frame uploaded %d bytes, %d/%d render regions uploaded/drawn",
+             stats.bytesUploaded, stats.regionsUploaded, stats.regionsDrawn);
+    LOG_INFO("Drew %d walls, %d hidden behind tiles", stats.wallsDrawn, stats.wallsHidden);
+    LOG_INFO("Drew %d of %d tiles looked at, %d chunks on screen culled", gameState->viewStats.tilesEmitted,
+             gameState->viewStats.tilesConsidered, gameState->viewStats.blocksCulled);
+    LOG_INFO("Lighting visited %d tiles in %.3f ms", gameState->light.nodesVisited, gameState->light.updateMs);
+    LOG_INFO("Liquid simulated %d cells in %.3f ms", gameState->liquid.activeCells, gameState->liquid.updateMs);
+    LOG_INFO("Heat and gas stepped %d regions in %.3f ms", gameState->environment.steppedRegions,
+             gameState->environment.updateMs);
+    LOG_INFO("Pathfinding rebuilt %d clusters in %.3f ms", gameState->nav.rebuiltClusters, gameState->nav.rebuildMs);
+    LOG_INFO("Player flow field built %d times, last tick %.3f ms", gameState->playerFlow.builds, gameState->playerFlow.updateMs);
+    LOG_INFO("Integrity searched %d tiles in %.3f ms", gameState->integrity.searchedTiles, gameState->integrity.updateMs);
+    LOG_INFO("Debris moved %d bodies with %d contacts in %.3f ms, %d islands went to sleep",
+             gameState->debris.bodies.count, gameState->debris.contacts, gameState->debris.updateMs,
+             gameState->debris.sleptIslands);
+    LOG_INFO("Damage tracks %d tiles, healed %d hits and cascaded %d timers in %.3f ms", gameState->damage.count,
+             gameState->damage.healedHits, gameState->damage.cascadedTimers, gameState->damage.updateMs);
+    LOG_INFO("Distance field rebuilt %d regions in %.3f ms, %d waiting", gameState->sdf.rebuiltRegions,
+             gameState->sdf.updateMs, gameState->sdf.dirtyRegions.count);
+    LOG_INFO("Physics moved %d bodies in %.3f ms, tick %u checksum %08x", physics->movedBodies, physics->updateMs,
+             gameState->tick, gameState->checksum);
+    LOG_INFO("Projectiles: %d live, %d tiles and %d entities hit, %d box tests in %.3f ms",
+             gameState->projectiles.live.count, gameState->projectiles.tileHits, gameState->projectiles.hits.count,
+             gameState->projectiles.boxTests, gameState->projectiles.updateMs);
+    LOG_INFO("Particles: %d live, %d bounced and %d died in %.3f ms, %d drawn", gameState->particles.count,
+             gameState->particles.bounces, gameState->particles.killed, gameState->particles.updateMs,
+             stats.particlesDrawn);
+    LOG_INFO("Broadphase sorted %d boxes with %d swaps, found %d pairs in %.3f ms", (int)broadphase->entries.size(),
+             broadphase->swaps, broadphase->pairCount, broadphase->updateMs);
   }
-  if (just_pressed(DEBUG_MENU))
+
+  if (just_pressed(QUICK_SAVE))
   {
-    world.log_entities();
+    save_world(WORLD_SAVE_PATH);
+  }
+  if (just_pressed(QUICK_LOAD))
+  {
+    load_world(WORLD_SAVE_PATH);
+  }
+  if (just_pressed(TOGGLE_MINIMAP))
+  {
+    gameState->showMinimap = !gameState->showMinimap;
   }
 
-  /*
+  // Player input steers the player's body, the PhysicsSystem adds drag and gravity and moves it
   Transform &player = gameState->player;
+  ecs::PhysicsBody &body = world.bodies.get(playerEntity);
   player.prevPos = player.pos;
 
   player.animState = PLAYER_ANIM_IDLE;
 
   constexpr float runSpeed = 2.0f;
   constexpr float runAcceleration = 10.0f;
-  constexpr float runReduce = 22.0f;
-  constexpr float flyReduce = 12.0f;
-  constexpr float gravity = 13.0f;
-  constexpr float fallSpeed = 3.6f;
   constexpr float jumpSpeed = -4.0f;
   // flip
-  if (player.speed.x > 0)
+  if (body.speed.x > SimFloat(0.0f))
   {
     player.renderOptions = 0;
   }
-  if (player.speed.x < 0)
+  if (body.speed.x < SimFloat(0.0f))
   {
     player.renderOptions = RENDER_OPTION_FLIP_X;
   }
 
   // Jump
-  if (just_pressed(JUMP) && player.isGrounded)
+  if (just_pressed(JUMP) && body.isGrounded)
   {
-    player.speed.y = jumpSpeed;
+    body.speed.y = SimFloat(jumpSpeed);
 
     sound_play("jump");
-    player.isGrounded = false;
+    body.isGrounded = false;
   }
-  if (!player.isGrounded)
+  if (!body.isGrounded)
   {
     player.animState = PLAYER_ANIM_JUMP;
   }
 
   if (is_down(MOVE_LEFT))
   {
-    if (player.isGrounded)
+    if (body.isGrounded)
     {
       player.animState = PLAYER_ANIM_RUN;
     }
     player.frameTime += dt;
 
     float mult = 1.0f;
-    if (player.speed.x > 0.0f)
+    if (body.speed.x > SimFloat(0.0f))
     {
       mult = 3.0f;
     }
-    player.speed.x = approach(player.speed.x, -runSpeed, runAcceleration * mult * dt);
+    body.speed.x = approach(body.speed.x, SimFloat(-runSpeed), SimFloat(runAcceleration * mult * dt));
+    body.driven = true;
   }
 
   if (is_down(MOVE_RIGHT))
   {
-    if (player.isGrounded)
+    if (body.isGrounded)
     {
       player.animState = PLAYER_ANIM_RUN;
     }
     player.frameTime += dt;
 
     float mult = 1.0f;
-    if (player.speed.x < 0.0f)
+    if (body.speed.x < SimFloat(0.0f))
     {
       mult = 3.0f;
     }
-    player.speed.x = approach(player.speed.x, runSpeed, runAcceleration * mult * dt);
-  }
-  // Drag
-  if (!is_down(MOVE_LEFT) && !is_down(MOVE_RIGHT))
-  {
-    if (player.isGrounded)
-    {
-      player.speed.x = approach(player.speed.x, 0, runReduce * dt);
-    }
-    else
-    {
-      player.speed.x = approach(player.speed.x, 0, flyReduce * dt);
-    }
+    body.speed.x = approach(body.speed.x, SimFloat(runSpeed), SimFloat(runAcceleration * mult * dt));
+    body.driven = true;
   }
-  // Gravity
-  player.speed.y = approach(player.speed.y, fallSpeed, gravity * dt);
 
   // Reset pos
   if (is_down(MOVE_UP))
   {
-    player.pos.y = {};
+    world.transforms.get(playerEntity).y = 0.0f;
   }
 
+  /*
   if (is_down(PRIMARY))
   {
     IVec2 mousePosWorld = input->mousePosWorld;
     Tile *tile = get_tile(mousePosWorld);
     if (tile)
     {
-      tile->isVisible = true;
-      update_tiles();
+      IVec2 gridPos = get_grid_pos(mousePosWorld);
+      set_tile_material(gridPos.x, gridPos.y, MATERIAL_DIRT);
     }
   }
+  */
+
+  // Dig out the tile under the mouse
   if (is_down(SECONDARY))
   {
-    IVec2 mousePosWorld = input->mousePosWorld;
-    Tile *tile = get_tile(mousePosWorld);
-    if (tile)
+    Vec2 mousePosTiles = vec_2(input->mousePosWorld) / (float)TILESIZE;
+    carve_circle(mousePosTiles, 0.75f);
+  }
+
+  // Pour water
+  if (is_down(MOUSE_MIDDLE))
+  {
+    IVec2 gridPos = get_grid_pos(input->mousePosWorld);
+    liquid_add(gridPos.x, gridPos.y, LIQUID_WATER, 0.5f);
+  }
+  if (is_down(PLACE_WALL))
+  {
+    IVec2 gridPos = get_grid_pos(input->mousePosWorld);
+    set_wall_material(gridPos.x, gridPos.y, MATERIAL_STONE);
+  }
+  if (just_pressed(FIRE))
+  {
+    Vec2 aim = vec_2(input->mousePosWorld) - vec_2(player.pos);
+    float length = sqrtf(aim.x * aim.x + aim.y * aim.y);
+    if (length > 0.0f)
     {
-      tile->isVisible = false;
-      update_tiles();
+      projectile_spawn(vec_2(player.pos), aim * (BULLET_SPEED / length), 0.0f, BULLET_LIFE, 1.0f, playerEntity);
     }
   }
 
-  Move(player);
-  */
+  // Entity systems run in the order they were added, the broadphase last
+  world.update_systems(dt);
+  ecs::TransformHot &playerPos = world.transforms.get(playerEntity);
+  player.pos = {(int)playerPos.x, (int)playerPos.y};
+  projectiles_update(*broadphase, dt);
+  particles_update(dt);
+
+  liquid_update();
+  env_update();
+
+  // Terrain cut loose by this tick's edits starts falling
+  integrity_update();
+  debris_update(dt);
+  damage_update();
+
+  // All tile edits this tick are autotiled together
+  flush_dirty_chunks();
+  light_update();
+  nav_update();
+  sdf_update();
+
+  flow_set_goal(gameState->playerFlow, get_grid_pos(gameState->player.pos));
+  flow_update(gameState->playerFlow);
+
+  gameState->tick++;
+  gameState->checksum = simulation_checksum();
 }
 
 void draw()
 {
   float interpolatedDT = (float)(gameState->updateTimer / UPDATE_DELAY);
 
-  /*
   // player
   Transform &player = gameState->player;
   IVec2 playerPos = lerp(player.prevPos, player.pos, interpolatedDT);
@@ -520,30 +581,108 @@ void draw()
               {.animationIdx = animIdx,
                .renderOptions = player.renderOptions});
 
-  // Draw tileset
+  // Tile overlays are cached per region and only rebuilt when their chunk changes
+  if (renderData->regionCount != CHUNK_COUNT)
+  {
+    build_all_render_regions();
+  }
+
+  // Liquids, filled from the bottom of the tile by their mass. Only the tiles
+  // on screen are looked at, and of those only the chunks holding liquid
+  ViewStats &viewStats = gameState->viewStats;
+  viewStats = {};
+  IRect visibleTiles = get_visible_tiles();
+  if (visibleTiles.size.x && visibleTiles.size.y)
   {
-    for (int y = 0; y < WORLD_GRID.y; y++)
+    int maxX = visibleTiles.pos.x + visibleTiles.size.x;
+    int maxY = visibleTiles.pos.y + visibleTiles.size.y;
+    for (int chunkX = visibleTiles.pos.x / CHUNK_SIZE; chunkX <= (maxX - 1) / CHUNK_SIZE; chunkX++)
     {
-      for (int x = 0; x < WORLD_GRID.x; x++)
+      for (int chunkY = visibleTiles.pos.y / CHUNK_SIZE; chunkY <= (maxY - 1) / CHUNK_SIZE; chunkY++)
       {
-        Tile *tile = get_tile(x, y);
-
-        if (!tile->isVisible)
+        if (!gameState->liquid.wetChunks[chunkX][chunkY])
         {
+          viewStats.blocksCulled++;
           continue;
         }
 
-        //Draw Tile
+        for (int x = max(chunkX * CHUNK_SIZE, visibleTiles.pos.x); x < min((chunkX + 1) * CHUNK_SIZE, maxX); x++)
+        {
+          for (int y = max(chunkY * CHUNK_SIZE, visibleTiles.pos.y); y < min((chunkY + 1) * CHUNK_SIZE, maxY); y++)
+          {
+            viewStats.tilesConsidered++;
+            float mass = gameState->liquid.mass[x][y];
+            if (mass < 0.01f || renderData->transforms.is_full())
+            {
+              continue;
+            }
+
+            float height = min(mass, LIQUID_MAX_MASS) * TILESIZE;
+            Sprite sprite = get_sprite(gameState->liquid.type[x][y] == LIQUID_LAVA ? SPRITE_LAVA : SPRITE_WATER);
 
-        RenderTransform transform = {};
-        // Draw the Tile around the center
-        transform.pos = {x * (float)TILESIZE, y * (float)TILESIZE};
-        transform.size = {8, 8};
-        transform.spriteSize = {8, 8};
-        transform.atlasOffset = gameState->tileCoords[tile->neighbourMask];
-        draw_quad(transform);
+            RenderTransform transform = {};
+            transform.pos = vec_2(get_tile_pos(x, y)) + Vec2{0.0f, TILESIZE - height};
+            transform.size = {(float)TILESIZE, height};
+            transform.atlasOffset = sprite.atlasOffset;
+            transform.spriteSize = sprite.spriteSize;
+            draw_quad(transform);
+            viewStats.tilesEmitted++;
+          }
+        }
       }
     }
   }
-    */
+
+  // Debris
+  DebrisState &debris = gameState->debris;
+  for (int bodyIdx = 0; bodyIdx < debris.bodies.count; bodyIdx++)
+  {
+    DebrisBody &body = debris.bodies[bodyIdx];
+    for (int idx = body.firstTile; idx < body.firstTile + body.tileCount && !renderData->transforms.is_full(); idx++)
+    {
+      FallingTile &fallingTile = debris.tiles[idx];
+
+      RenderTransform transform = {};
+      transform.pos = vec_2(get_tile_pos(fallingTile.pos.x, fallingTile.pos.y)) + Vec2{0.0f, body.fallen * TILESIZE};
+      transform.size = {(float)TILESIZE, (float)TILESIZE};
+      transform.atlasOffset = materialTable.atlasOffsets[fallingTile.tile.material][fallingTile.tile.neighbourMask];
+      transform.spriteSize = {TILESIZE, TILESIZE};
+      draw_quad(transform);
+    }
+  }
+
+  // Projectiles
+  Sprite projectileSprite = get_sprite(SPRITE_BULLET);
+  for (int idx = 0; idx < gameState->projectiles.live.count && !renderData->transforms.is_full(); idx++)
+  {
+    Projectile &projectile = gameState->projectiles.live[idx];
+
+    RenderTransform transform = {};
+    transform.pos = projectile.pos - vec_2(projectileSprite.spriteSize) * 0.5f;
+    transform.size = vec_2(projectileSprite.spriteSize);
+    transform.atlasOffset = projectileSprite.atlasOffset;
+    transform.spriteSize = projectileSprite.spriteSize;
+    draw_quad(transform);
+  }
+
+  // Particles, particles_update() already wrote their instances
+  renderData->particles = {gameState->particles.instances, gameState->particles.count};
+
+  // Tile layer, the renderer draws it from a tilemap texture
+  {
+    TilemapLayer &tilemap = renderData->tilemap;
+    tilemap.tiles = (uint8_t *)gameState->worldGrid;
+    tilemap.lightLevels = (uint8_t *)gameState->light.levels;
+    tilemap.size = WORLD_GRID;
+    tilemap.tileSize = TILESIZE;
+    for (int materialID = 0; materialID < MATERIAL_COUNT; materialID++)
+    {
+      tilemap.materialAtlasOrigins[materialID] = materialTable.atlasOffsets[materialID][0];
+    }
+  }
+
+  if (gameState->showMinimap)
+  {
+    draw_minimap();
+  }
 }
@@ -5,17 +5,176 @@
 #include "../render/render_interface.h"
 #include "../engine_utils/assets.h"
 #include "../engine_utils/sound.h"
+#include "materials.h"
 
 // ################################     Game Constants   ################################
 constexpr int UPDATES_PER_SECOND = 60;
 constexpr double UPDATE_DELAY = 1.0 / UPDATES_PER_SECOND;
 
+// Headless benchmarks can build a square world of BENCH_WORLD_TILES tiles a side
+#ifdef BENCH_WORLD_TILES
+constexpr int WORLD_WIDTH = BENCH_WORLD_TILES * 8;
+constexpr int WORLD_HEIGHT = (BENCH_WORLD_TILES - 1) * 8;
+#else
 constexpr int WORLD_WIDTH = 320;
 constexpr int WORLD_HEIGHT = 180;
+#endif
 
 constexpr int TILESIZE = 8;
 constexpr IVec2 WORLD_GRID = {WORLD_WIDTH / TILESIZE, (WORLD_HEIGHT / TILESIZE) + 1};
 
+// Tiles are grouped in chunks, edits mark whole chunks as dirty
+constexpr int CHUNK_SIZE = 16;
+constexpr IVec2 CHUNK_GRID = {(WORLD_GRID.x + CHUNK_SIZE - 1) / CHUNK_SIZE,
+                              (WORLD_GRID.y + CHUNK_SIZE - 1) / CHUNK_SIZE};
+constexpr int CHUNK_COUNT = CHUNK_GRID.x * CHUNK_GRID.y;
+
+// Every chunk owns one render region
+static_assert(CHUNK_SIZE == RENDER_REGION_SIZE, "Chunks and render regions must match");
+static_assert(CHUNK_COUNT <= MAX_RENDER_REGIONS, "Too many chunks for the renderer");
+
+constexpr int MAX_CARVE_POINTS = 8;
+
+// Lighting
+constexpr int LIGHT_REGION_SIZE = 32; // Light is sent to the GPU in blocks of 32x32 tiles
+constexpr IVec2 LIGHT_REGION_GRID = {(WORLD_GRID.x + LIGHT_REGION_SIZE - 1) / LIGHT_REGION_SIZE,
+                                     (WORLD_GRID.y + LIGHT_REGION_SIZE - 1) / LIGHT_REGION_SIZE};
+constexpr int LIGHT_QUEUE_SIZE = 1 << 16;
+constexpr int LIGHT_BUDGET = 16384; // Max tiles the flood fill visits per tick
+
+// One bit per tile, packed along x
+constexpr int OCCUPANCY_WORDS = (WORLD_GRID.x + 63) / 64;
+// Mip pyramid over the occupancy, a cell of level n covers 2^n x 2^n tiles and
+// level OCCUPANCY_MIP_TOP is a single cell over the whole world
+constexpr int occupancy_mip_levels(int size)
+{
+    return size <= 1 ? 0 : 1 + occupancy_mip_levels((size + 1) / 2);
+}
+constexpr int OCCUPANCY_MIP_TOP = occupancy_mip_levels(WORLD_GRID.x) > occupancy_mip_levels(WORLD_GRID.y)
+                                      ? occupancy_mip_levels(WORLD_GRID.x)
+                                      : occupancy_mip_levels(WORLD_GRID.y);
+constexpr IVec2 occupancy_mip_size(int level)
+{
+    return {((WORLD_GRID.x - 1) >> level) + 1, ((WORLD_GRID.y - 1) >> level) + 1};
+}
+//? Where the cells of level start, level 0 are the tile bits themselves
+constexpr int occupancy_mip_offset(int level)
+{
+    return level <= 1 ? 0 : occupancy_mip_offset(level - 1) + occupancy_mip_size(level - 1).x * occupancy_mip_size(level - 1).y;
+}
+constexpr int OCCUPANCY_MIP_CELLS = occupancy_mip_offset(OCCUPANCY_MIP_TOP + 1);
+constexpr int OCCUPANCY_BLOCK_LEVEL = 3; // Raycasts cross empty 8x8 blocks
+constexpr int OCCUPANCY_AREA_LEVEL = 6;  // and empty 64x64 areas in one step
+static_assert(OCCUPANCY_AREA_LEVEL <= OCCUPANCY_MIP_TOP, "The world is smaller than a raycast area");
+
+// Minimap
+constexpr float MINIMAP_WIDTH = 80.0f; // In pixels of the game camera
+constexpr float MINIMAP_MARGIN = 4.0f;
+
+// Liquids
+constexpr float LIQUID_MAX_MASS = 1.0f;      // Mass of a full cell with nothing on top
+constexpr float LIQUID_MAX_COMPRESS = 0.02f; // Extra mass a cell holds for every full cell above it
+constexpr float LIQUID_MIN_MASS = 0.0001f;   // Anything less is dry
+constexpr float LIQUID_MIN_FLOW = 0.01f;     // Bigger flows are halved to smooth the surface
+constexpr float LIQUID_MAX_FLOW = 1.0f;
+constexpr float LIQUID_SETTLE_EPSILON = 0.0005f;
+constexpr int LIQUID_SETTLE_TICKS = 30; // Ticks without change until a cell is skipped
+constexpr int MAX_LIQUID_REACTIONS = 1024; // Lava turning to stone per tick, the rest waits a tick
+
+// Environment, heat and gas are simulated on cells of ENV_CELL_SIZE x ENV_CELL_SIZE tiles
+constexpr int ENV_CELL_SIZE = 2;
+constexpr IVec2 ENV_GRID = {(WORLD_GRID.x + ENV_CELL_SIZE - 1) / ENV_CELL_SIZE,
+                            (WORLD_GRID.y + ENV_CELL_SIZE - 1) / ENV_CELL_SIZE};
+constexpr int ENV_PITCH = (ENV_GRID.y + 2 + 3) / 4 * 4; // A column with a border cell on both ends, padded for SIMD
+constexpr int ENV_REGION_SIZE = 16; // In cells, regions that stopped changing are skipped
+constexpr IVec2 ENV_REGION_GRID = {(ENV_GRID.x + ENV_REGION_SIZE - 1) / ENV_REGION_SIZE,
+                                   (ENV_GRID.y + ENV_REGION_SIZE - 1) / ENV_REGION_SIZE};
+constexpr float ENV_HEAT_DIFFUSION = 0.2f; // Share that moves to every neighbour per tick, at most 0.25
+constexpr float ENV_HEAT_LOSS = 0.002f;    // Share lost to the surroundings per tick
+constexpr float ENV_GAS_DIFFUSION = 0.2f;
+constexpr float ENV_LAVA_HEAT = 4.0f;     // Heat per tick of a full tile of lava
+constexpr float ENV_WATER_COOLING = 0.05f; // Share of the heat a full tile of water takes per tick
+constexpr float ENV_IGNITE_HEAT = 100.0f;
+constexpr float ENV_IGNITE_GAS = 0.1f;   // Thinner gas doesn't burn
+constexpr float ENV_BURN_RATE = 0.25f;   // Share of the gas burned per tick
+constexpr float ENV_BURN_HEAT = 400.0f;  // Heat of a unit of burned gas
+constexpr float ENV_COAL_GAS = 1.0f;     // Released by a mined coal tile
+constexpr float ENV_EPSILON = 0.0001f;   // A region that changes less than this per tick goes to sleep
+static_assert(ENV_CELL_SIZE == 2 || ENV_CELL_SIZE == 4, "Fields run at 1/2 or 1/4 of the tile resolution");
+
+// Pathfinding, the grid is split in clusters connected through entrances on their borders
+constexpr int NAV_CLUSTER_SIZE = 16;
+constexpr IVec2 NAV_CLUSTER_GRID = {(WORLD_GRID.x + NAV_CLUSTER_SIZE - 1) / NAV_CLUSTER_SIZE,
+                                    (WORLD_GRID.y + NAV_CLUSTER_SIZE - 1) / NAV_CLUSTER_SIZE};
+constexpr int NAV_CLUSTER_COUNT = NAV_CLUSTER_GRID.x * NAV_CLUSTER_GRID.y;
+constexpr int MAX_CLUSTER_NODES = 32;
+constexpr int NAV_NODE_COUNT = NAV_CLUSTER_COUNT * MAX_CLUSTER_NODES;
+constexpr int MAX_NAV_WAYPOINTS = 1024;
+constexpr uint16_t NAV_UNREACHABLE = 0xFFFF;
+constexpr float NAV_HEURISTIC_WEIGHT = 1.5f; // Paths get a bit longer, queries a lot faster
+
+// Structural integrity
+constexpr int MAX_ISLAND_TILES = 1024; // Anything bigger is treated as held up
+constexpr int MAX_INTEGRITY_CANDIDATES = 4096;
+
+// Debris
+constexpr int MAX_DEBRIS_BODIES = 512;
+constexpr int MAX_DEBRIS_TILES = 32768; // Shared by all bodies
+constexpr float FALL_GRAVITY = 60.0f; // Tiles per second squared
+constexpr float MAX_FALL_SPEED = 30.0f; // Tiles per second
+constexpr int DEBRIS_SLEEP_TICKS = 15; // Ticks an island has to rest before it turns back into tiles
+
+// Persistence
+constexpr const char *WORLD_SAVE_PATH = "world.vbr";
+constexpr uint32_t WORLD_FILE_MAGIC = 'V' | ('B' << 8) | ('R' << 16) | ('2' << 24); // 2: chunks hold the walls
+constexpr int CHUNK_TILE_COUNT = CHUNK_SIZE * CHUNK_SIZE;
+// Worst case of one encoded chunk: encoding, palette and a byte per tile, for the tiles and the walls
+constexpr int MAX_ENCODED_CHUNK_SIZE = 2 * (2 + MATERIAL_COUNT + CHUNK_TILE_COUNT);
+constexpr int REGION_SECTOR_SIZE = 64; // Every chunk starts on a sector
+constexpr int REGION_MAX_CHUNK_SECTORS = (MAX_ENCODED_CHUNK_SIZE + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE;
+constexpr int REGION_RELEASE_CHUNKS = 4096; // Loading drops the file pages it read after this many chunks
+
+// Distance field
+constexpr int SDF_REGION_SIZE = 32;
+constexpr IVec2 SDF_REGION_GRID = {(WORLD_GRID.x + SDF_REGION_SIZE - 1) / SDF_REGION_SIZE,
+                                   (WORLD_GRID.y + SDF_REGION_SIZE - 1) / SDF_REGION_SIZE};
+constexpr int SDF_MAX_DISTANCE = 15; // In tiles, anything further is clamped so edits only reach this far
+constexpr int SDF_SCALE = 8;         // Stored distances are in 1/8 tiles
+constexpr int SDF_WINDOW = SDF_REGION_SIZE + 2 * SDF_MAX_DISTANCE; // A region and every tile that can reach it
+constexpr int SDF_BUDGET = 8;        // Max regions recomputed per tick
+
+// Tile damage
+constexpr int MAX_DAMAGED_TILES = 65536;
+constexpr int DAMAGE_HASH_BITS = 17;
+constexpr int DAMAGE_HASH_SIZE = 1 << DAMAGE_HASH_BITS;
+constexpr int DAMAGE_REGEN_DELAY = 3 * UPDATES_PER_SECOND;    // Ticks from the last hit until the tile heals
+constexpr int DAMAGE_REGEN_INTERVAL = UPDATES_PER_SECOND / 2; // Ticks per hit healed after that
+constexpr int TIMER_WHEEL_BITS = 6;
+constexpr int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;
+constexpr int TIMER_WHEEL_LEVELS = 4; // Timers reach 2^24 ticks ahead
+static_assert(DAMAGE_HASH_SIZE >= 2 * MAX_DAMAGED_TILES, "The damage hash is never more than half full");
+
+// Projectiles
+constexpr int MAX_PROJECTILES = 16384;
+constexpr int MAX_PROJECTILE_HITS = 1024;
+constexpr int PROJECTILE_COLUMN_SIZE = 64; // Pixels, targets are looked up by column
+constexpr int PROJECTILE_COLUMN_COUNT = WORLD_WIDTH / PROJECTILE_COLUMN_SIZE + 1;
+constexpr float BULLET_SPEED = 1200.0f; // Pixels per second, 2.5 tiles per tick
+constexpr float BULLET_LIFE = 2.0f;     // Seconds
+
+// Particles
+constexpr int MAX_PARTICLES = 1 << 20;
+static_assert(MAX_PARTICLES % 4 == 0, "Particles are updated 4 at a time");
+constexpr float PARTICLE_GRAVITY = 240.0f; // Pixels per second squared
+constexpr float PARTICLE_BOUNCE = 0.4f;    // Speed kept along the axis that hit a tile
+constexpr uint32_t SPARK_COLOR = 0xFF40C8FF; // RGBA8, red in the lowest byte
+constexpr uint32_t BLOOD_COLOR = 0xFF1010A0;
+
+// Flow fields
+constexpr int FLOW_BUDGET = 32768; // Max tiles a rebuild visits per tick
+constexpr int FLOW_MAX_CHANGED_TILES = 256; // Edits during a build patched in after it, more restart it
+constexpr uint8_t FLOW_DIR_NONE = 8;
+
 // ################################     Game Structs   ################################
 
 // input
@@ -36,6 +195,11 @@ enum GameInputType
     // UI
     MENU,
     DEBUG_MENU,
+    QUICK_SAVE,
+    QUICK_LOAD,
+    TOGGLE_MINIMAP,
+    PLACE_WALL,
+    FIRE,
 
     GAME_INPUT_COUNT
 };
@@ -47,8 +211,506 @@ struct KeyMapping
 
 struct Tile
 {
-    int neighbourMask;
-    bool isVisible;
+    MaterialID material; // MATERIAL_AIR is an empty tile
+    uint8_t neighbourMask;
+};
+static_assert(sizeof(Tile) == 2, "The tilemap texture is uploaded straight from the worldGrid");
+
+// carving
+enum CarveShapeType
+{
+    CARVE_CIRCLE,
+    CARVE_CAPSULE,
+    CARVE_POLYGON
+};
+
+// All positions are in tiles, a tile is removed when its center is inside the shape
+struct CarveShape
+{
+    CarveShapeType type;
+
+    Vec2 start; // Center of a circle, first point of a capsule
+    Vec2 end;   // Second point of a capsule
+    float radius;
+
+    Array<Vec2, MAX_CARVE_POINTS> points; // Polygon in order (clockwise or not)
+};
+
+struct CarveResult
+{
+    int removed[MATERIAL_COUNT]; // Count per material, turned into loot using materialTable.dropID
+};
+
+// occupancy
+enum OccupancyState : uint8_t
+{
+    OCCUPANCY_EMPTY,
+    OCCUPANCY_MIXED,
+    OCCUPANCY_FULL,
+};
+
+// Set bits are solid tiles, a row of 64 tiles is tested with a single load.
+// The mips tell if a block of tiles is all air, all solid or both, queries
+// can skip whole blocks without looking at their tiles
+struct OccupancyMap
+{
+    uint64_t rows[WORLD_GRID.y][OCCUPANCY_WORDS];
+    OccupancyState mips[OCCUPANCY_MIP_CELLS]; // Level by level from level 1, row by row
+};
+
+// raycasts
+// In tiles, tile (x, y) covers [x, x + 1) x [y, y + 1)
+struct Ray
+{
+    Vec2 origin;
+    Vec2 dir; // Doesn't need to be normalized, distances are in lengths of dir
+    float maxDistance;
+};
+
+struct RayHit
+{
+    bool hit;
+    IVec2 tile;
+    IVec2 normal; // Of the side the ray entered through, 0 if it started in the tile
+    float distance;
+};
+
+// lighting
+struct LightNode
+{
+    uint16_t x, y;
+    uint8_t level; // Level before removal, only used by the removal queue
+};
+
+// Ring buffer of tiles waiting for the flood fill
+struct LightQueue
+{
+    int head;
+    int count;
+    LightNode nodes[LIGHT_QUEUE_SIZE];
+};
+
+struct LightGrid
+{
+    bool initialized;
+    bool needsRebuild;
+
+    uint8_t levels[WORLD_GRID.x][WORLD_GRID.y];  // [0; MAX_LIGHT_LEVEL]
+    uint8_t sources[WORLD_GRID.x][WORLD_GRID.y]; // Placed lights like torches
+
+    // Removal always finishes before light is added again
+    LightQueue removeQueue;
+    LightQueue addQueue;
+
+    bool dirtyRegions[LIGHT_REGION_GRID.x][LIGHT_REGION_GRID.y];
+
+    // Stats of the last tick
+    int nodesVisited;
+    float updateMs;
+};
+
+// environment
+// Two fields layered over the tiles. Cells are [x][y] like the worldGrid with a
+// border cell around the world, columns are diffused 4 cells at a time
+struct EnvironmentGrid
+{
+    bool initialized;
+    int front; // Buffer holding the current values, the other one gets the next tick
+
+    float heat[2][ENV_GRID.x + 2][ENV_PITCH];
+    float gas[2][ENV_GRID.x + 2][ENV_PITCH];
+    float open[ENV_GRID.x + 2][ENV_PITCH]; // Share of air tiles, gas only moves between open cells
+
+    bool activeRegions[ENV_REGION_GRID.x][ENV_REGION_GRID.y];
+    bool stepping[ENV_REGION_GRID.x][ENV_REGION_GRID.y]; // Active regions and their neighbours
+
+    // Stats of the last tick
+    int steppedRegions;
+    float updateMs;
+};
+
+// liquids
+enum LiquidType : uint8_t
+{
+    LIQUID_NONE,
+    LIQUID_WATER,
+    LIQUID_LAVA,
+
+    LIQUID_COUNT
+};
+
+// Compressible liquid, a cell holds a bit more than LIQUID_MAX_MASS
+// when there is liquid above it, the difference pushes liquid up
+struct LiquidGrid
+{
+    float mass[WORLD_GRID.x][WORLD_GRID.y];
+    float newMass[WORLD_GRID.x][WORLD_GRID.y]; // Flows of this tick, equal to mass between ticks
+    LiquidType type[WORLD_GRID.x][WORLD_GRID.y];
+    LiquidType newType[WORLD_GRID.x][WORLD_GRID.y]; // Kinds flowing in this tick, equal to type between ticks
+    uint8_t settleTicks[WORLD_GRID.x][WORLD_GRID.y];
+
+    // Chunks with at least one unsettled cell
+    bool activeChunks[CHUNK_GRID.x][CHUNK_GRID.y];
+    // Chunks that might hold liquid, drawing skips the others
+    bool wetChunks[CHUNK_GRID.x][CHUNK_GRID.y];
+
+    // Lava cells that touched water this tick, they turn to stone after the flows are applied
+    Array<IVec2, MAX_LIQUID_REACTIONS> reactions;
+
+    // Stats of the last tick
+    int activeCells;
+    float updateMs;
+};
+
+// pathfinding
+// Tile on the border of a cluster with a walkable tile right across
+struct NavNode
+{
+    uint16_t x, y;
+    uint8_t linkDirs; // Bit per side (Top, Left, Right, Bottom) that leads into the next cluster
+};
+
+struct NavCluster
+{
+    bool dirty;
+    int nodeCount;
+    NavNode nodes[MAX_CLUSTER_NODES];
+
+    // Walking distance between the nodes inside the cluster, NAV_UNREACHABLE if there is no path
+    uint16_t distances[MAX_CLUSTER_NODES][MAX_CLUSTER_NODES];
+};
+
+// Per node state of a query, only valid if stamp matches the query
+struct NavSearchNode
+{
+    uint32_t stamp;
+    int g, f;
+    int parent;
+    int heapIndex; // -1 once closed
+};
+
+struct NavPath
+{
+    bool found;
+    int cost; // In tiles walked
+    // Start, goal and every cluster crossing in between, consecutive
+    // waypoints are in one cluster or right next to each other
+    Array<IVec2, MAX_NAV_WAYPOINTS> waypoints;
+};
+
+struct NavGraph
+{
+    bool initialized;
+    NavCluster clusters[NAV_CLUSTER_GRID.x][NAV_CLUSTER_GRID.y];
+    Array<IVec2, NAV_CLUSTER_COUNT> dirtyClusters;
+
+    // Scratch of the abstract search, the last two nodes are the start and the goal
+    uint32_t searchStamp;
+    NavSearchNode search[NAV_NODE_COUNT + 2];
+    int heap[NAV_NODE_COUNT + 2];
+    int heapCount;
+
+    // Connected part of the graph every node is in, nodes whose ids have different roots in
+    // componentParents can't reach each other. Walls don't split ids until the next relabel
+    uint32_t components[NAV_NODE_COUNT];
+    uint32_t componentParents[NAV_NODE_COUNT + 1];
+    uint32_t componentCount;
+
+    // Stats
+    int rebuiltClusters;
+    float rebuildMs;
+};
+
+// structural integrity
+struct IntegrityState
+{
+    // Solid tiles next to a removed tile, checked at the end of the tick
+    Array<IVec2, MAX_INTEGRITY_CANDIDATES> candidates;
+
+    // Every search has its own stamp, tiles stamped since firstStamp were seen this tick
+    uint32_t stamp;
+    uint32_t firstStamp;
+    uint32_t visited[WORLD_GRID.x][WORLD_GRID.y];
+    Array<IVec2, MAX_ISLAND_TILES> island;
+
+    // Stats of the last tick
+    int searchedTiles;
+    float updateMs;
+};
+
+// debris
+struct FallingTile
+{
+    IVec2 pos; // Where the tile was before falling
+    Tile tile;
+};
+
+// Island cut off from the anchors, falls as one piece until it rests on the
+// grid or on other debris
+struct DebrisBody
+{
+    float fallen; // In tiles, where it is drawn
+    float speed;
+    int row; // Whole rows fallen, where its tiles collide
+    int bottom; // Lowest start row of its tiles
+    int firstTile; // In DebrisState::tiles, bottom faces first
+    int faceCount; // Tiles without a tile of the body below them
+    int tileCount;
+    int restTicks; // Ticks in a row it didn't move
+    int island; // Union-find parent, only valid during debris_update()
+};
+
+struct DebrisState
+{
+    Array<DebrisBody, MAX_DEBRIS_BODIES> bodies;
+    FallingTile tiles[MAX_DEBRIS_TILES];
+    int tileCount;
+    uint16_t occupant[WORLD_GRID.x][WORLD_GRID.y]; // Body index + 1 covering the tile, 0 for none
+    int order[MAX_DEBRIS_BODIES]; // Body indices, lowest first
+
+    // Stats of the last tick
+    int contacts;
+    int sleptIslands;
+    float updateMs;
+};
+
+// persistence
+enum ChunkEncoding : uint8_t
+{
+    CHUNK_ENCODING_UNIFORM, // One material, no tile data
+    CHUNK_ENCODING_PACKED,  // Palette index per tile, as few bits as the palette needs
+    CHUNK_ENCODING_RLE,     // Runs of (length, palette index), wins on big areas of rock or air
+};
+
+struct ByteWriter
+{
+    uint8_t *data;
+    int capacity;
+    int size;
+    bool overflow;
+};
+
+struct ByteReader
+{
+    uint8_t *data;
+    int size;
+    int pos;
+    bool error; // Read past the end or found invalid data
+};
+
+enum RegionSyncPolicy : uint8_t
+{
+    REGION_SYNC_NONE,    // The OS writes the pages back whenever it likes
+    REGION_SYNC_ON_SAVE, // One flush at the end of every save
+    REGION_SYNC_ORDERED, // Chunks are on disk before the table points at them
+};
+constexpr RegionSyncPolicy REGION_SYNC_POLICY = REGION_SYNC_ORDERED;
+
+struct RegionHeader
+{
+    uint32_t magic;
+    uint32_t width, height; // In tiles
+    uint32_t chunkSize;
+    uint32_t sectorSize;
+    uint32_t reserved;
+};
+
+struct RegionEntry
+{
+    uint32_t sector; // 0 if the chunk was never saved
+    uint32_t size;   // In bytes
+};
+
+// Header and table, the chunks start on the sector after
+constexpr int REGION_TABLE_SECTORS =
+    (sizeof(RegionHeader) + CHUNK_COUNT * sizeof(RegionEntry) + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE;
+// Every chunk can be rewritten once without reusing the sectors of the last save
+constexpr int REGION_MAX_SECTORS = REGION_TABLE_SECTORS + 2 * CHUNK_COUNT * REGION_MAX_CHUNK_SECTORS;
+
+struct RegionFile
+{
+    MappedFile file;
+    RegionHeader *header;
+    RegionEntry *table;
+    int sectorCount; // In the file
+    uint64_t usedSectors[(REGION_MAX_SECTORS + 63) / 64];
+};
+
+struct RegionWrite
+{
+    IVec2 chunk;
+    int offset; // In the encode buffer
+    int size;
+    int sector;
+};
+
+// Materials of a whole world, [x][y] like the grids. A load decodes into it and only
+// copies it over once every chunk decoded
+struct WorldLayers
+{
+    MaterialID tiles[WORLD_GRID.x][WORLD_GRID.y];
+    MaterialID walls[WORLD_GRID.x][WORLD_GRID.y];
+};
+
+// distance field
+// Distance from the centre of a tile to the centre of the nearest tile of the other
+// kind, minus half a tile. Positive in air, negative in solid tiles and 0 on the
+// surface in between. Outside of the world counts as solid
+struct SdfRegion
+{
+    int8_t distances[SDF_REGION_SIZE][SDF_REGION_SIZE]; // In 1/SDF_SCALE tiles
+};
+
+struct DistanceField
+{
+    bool initialized;
+    SdfRegion regions[SDF_REGION_GRID.x][SDF_REGION_GRID.y];
+
+    bool dirty[SDF_REGION_GRID.x][SDF_REGION_GRID.y];
+    Array<IVec2, SDF_REGION_GRID.x * SDF_REGION_GRID.y> dirtyRegions;
+
+    // Squared distances of the region being recomputed
+    float toSolid[SDF_WINDOW][SDF_WINDOW];
+    float toAir[SDF_WINDOW][SDF_WINDOW];
+
+    // Stats of the last tick
+    int rebuiltRegions;
+    float updateMs;
+};
+
+// tile damage
+// Only tiles that were hit and haven't healed yet are tracked. A tile is found
+// through an open addressing hash of its index and sits in one slot of a
+// hierarchical timer wheel until its next heal
+struct DamagedTile
+{
+    uint32_t key;        // x * WORLD_GRID.y + y
+    float damage;        // Hits taken, the tile breaks at the hardness of its material
+    uint32_t expireTick; // Next heal
+    int wheelSlot;       // level * TIMER_WHEEL_SLOTS + slot
+    int next, prev;      // In the wheel slot, unused nodes are linked through next
+};
+
+struct TileDamage
+{
+    bool initialized;
+    DamagedTile nodes[MAX_DAMAGED_TILES];
+    int freeNode;
+    int count;
+
+    int hash[DAMAGE_HASH_SIZE]; // Node of the tile, -1 for an empty slot
+    int wheel[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS]; // First node of every slot, -1 if empty
+    uint32_t tick;
+
+    // Stats of the last tick
+    int healedHits;
+    int cascadedTimers;
+    float updateMs;
+};
+
+// projectiles
+// Positions and speeds are in pixels like entities, every tick a projectile
+// travels a segment that is tested against the tiles and the colliders
+struct Projectile
+{
+    Vec2 pos;
+    Vec2 vel;      // Pixels per second
+    float gravity; // Pixels per second squared, 0 for bullets
+    float life;    // Seconds left
+    float damage;  // Hits dealt to the tile it runs into
+    uint32_t owner; // Entity that fired it, never hit by it
+};
+
+struct ProjectileHit
+{
+    uint32_t entity;
+    Vec2 pos;
+    float damage;
+};
+
+struct ProjectilePool
+{
+    // Live projectiles are packed at the front, a dead one swaps in the last
+    Array<Projectile, MAX_PROJECTILES> live;
+    Array<ProjectileHit, MAX_PROJECTILE_HITS> hits; // Entities hit in the last tick
+
+    // Collider boxes of the tick sorted by minX, one array per bound so four are
+    // tested at a time. 4 entries of padding that nothing hits. Allocated from the
+    // transientStorage every tick, as many as the broadphase has colliders
+    float *targetMinX;
+    float *targetMaxX;
+    float *targetMinY;
+    float *targetMaxY;
+    uint32_t *targets;
+    int targetCount;
+    int columnFirst[PROJECTILE_COLUMN_COUNT]; // First target that can reach into the column
+
+    // Stats of the last tick
+    int tileHits;
+    int boxTests;
+    float updateMs;
+};
+
+// particles
+// Structure of arrays, four particles are integrated at a time. Live particles
+// are packed at the front, the update closes the gaps left by dead ones and
+// writes the instances the renderer draws in the same pass
+struct ParticleSystem
+{
+    float posX[MAX_PARTICLES]; // Pixels
+    float posY[MAX_PARTICLES];
+    float velX[MAX_PARTICLES]; // Pixels per second
+    float velY[MAX_PARTICLES];
+    float life[MAX_PARTICLES]; // Seconds left
+    uint32_t colors[MAX_PARTICLES];
+    int count;
+    uint32_t seed; // Spread of bursts
+
+    ParticleInstance instances[MAX_PARTICLES];
+
+    // Stats of the last tick
+    int bounces;
+    int killed;
+    float updateMs;
+};
+
+// flow fields
+enum FlowBuildStage : uint8_t
+{
+    FLOW_IDLE,
+    FLOW_INTEGRATE,  // Breadth first search out from the goal
+    FLOW_DIRECTIONS, // Every tile points at its cheapest neighbour
+};
+
+struct FlowLayer
+{
+    uint16_t costs[WORLD_GRID.x][WORLD_GRID.y]; // Steps to the goal, NAV_UNREACHABLE if there is no way
+    uint8_t directions[WORLD_GRID.x][WORLD_GRID.y]; // Index into flowDirections, FLOW_DIR_NONE at the goal
+};
+
+// Shared by every agent heading to the same goal. Agents read the front layer
+// while a new goal is built in the back layer over a few ticks
+struct FlowField
+{
+    bool valid;
+    IVec2 goal; // Of the front layer
+    int front;
+    FlowLayer layers[2];
+
+    FlowBuildStage stage;
+    bool restart; // Too many tiles changed under the build
+    IVec2 buildGoal;
+    bool goalPending; // The goal moved during the build, the next one starts once it is done
+    IVec2 pendingGoal;
+    Array<IVec2, FLOW_MAX_CHANGED_TILES> changedTiles; // Since the build started
+    int queueHead;
+    int queueTail;
+    uint32_t queue[WORLD_GRID.x * WORLD_GRID.y];
+    int directionColumn;
+
+    // Stats
+    int builds;
+    float updateMs;
 };
 
 enum PlayerAnimState
@@ -59,14 +721,27 @@ enum PlayerAnimState
     PLAYER_ANIM_COUNT
 };
 
+// What the last frame looked at to draw the per tile layers
+struct ViewStats
+{
+    int blocksCulled; // Chunks on screen with nothing to draw
+    int tilesConsidered;
+    int tilesEmitted;
+};
+
+// Tile variants joined to all four direct neighbours have no transparent
+// border, the wall behind them can't be seen
+constexpr int FIRST_COVERING_VARIANT = 15;
+constexpr int WALL_VARIANT = 15; // Walls are drawn without edges
+
 struct Transform
 {
     IVec2 pos, prevPos;
 
     IVec2 aabb;
 
-    Vec2 speed;
-    Vec2 remainder;
+    SimVec2 speed;
+    SimVec2 remainder;
 
     bool hasCollided;
     bool isGrounded;
@@ -80,12 +755,36 @@ struct Transform
 struct GameState
 {
     float updateTimer;
+    BumpAllocator *transientStorage; // Set by the platform, reset every frame
 
     bool initialized = false;
+    uint32_t tick;
+    uint32_t checksum; // Of the tiles and physics bodies after the last tick, see simulation_checksum()
     Transform player;
 
-    Array<IVec2, 21> tileCoords;
     Tile worldGrid[WORLD_GRID.x][WORLD_GRID.y];
+    MaterialID wallGrid[WORLD_GRID.x][WORLD_GRID.y]; // Background behind the tiles, MATERIAL_AIR for none
+    OccupancyMap occupancy;
+    bool showMinimap;
+    ViewStats viewStats;
+
+    bool dirtyChunks[CHUNK_GRID.x][CHUNK_GRID.y];
+    Array<IVec2, CHUNK_COUNT> dirtyChunkList;
+    bool savedChunks[CHUNK_GRID.x][CHUNK_GRID.y]; // Same as in the world file
+
+    LightGrid light;
+    EnvironmentGrid environment;
+    LiquidGrid liquid;
+    NavGraph nav;
+    FlowField playerFlow; // Swarms chasing the player
+    DistanceField sdf;
+    TileDamage damage;
+
+    IntegrityState integrity;
+    DebrisState debris;
+    ProjectilePool projectiles;
+    ParticleSystem particles;
+
     KeyMapping keyMappings[GAME_INPUT_COUNT];
 };
 
@@ -97,6 +796,17 @@ void init();
 void fixed_update();
 void draw();
 
+// Tile systems are split over several files and call into each other
+bool is_solid(int x, int y);
+OccupancyState &occupancy_mip(int level, int x, int y);
+IRect get_chunk_rect(IVec2 chunk);
+IRect get_visible_tiles();
+void set_tile_material(int x, int y, MaterialID material);
+void set_wall_material(int x, int y, MaterialID material);
+void move_box(IVec2 &pos, IVec2 aabb, SimVec2 &speed, SimVec2 &remainder, bool &hasCollided, bool &isGrounded);
+void refresh_world();
+bool debris_spawn(IVec2 *tiles, int count);
+
 // ################################     Game Functions (Exposed)   ################################
 extern "C"
 {
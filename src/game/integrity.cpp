@@ -0,0 +1,128 @@
+#include "game.h"
+
+#include <chrono>
+
+// ################################     Integrity Functions   ################################
+// Terrain is held up by anchor materials (bedrock) and the bottom row of the world.
+// Only removing a tile can cut something loose, so the solid neighbours of removed
+// tiles are collected and searched from at the end of the tick. A search stops as
+// soon as it finds an anchor, a tile an earlier search already found held up, or
+// more than MAX_ISLAND_TILES tiles, so the cost follows the edit and not the world.
+// Searches that run out of tiles found an island, it is taken out of the grid and
+// becomes debris
+
+static const int integrityOffsets[8] = {0, -1, -1, 0, 1, 0, 0, 1};
+
+void integrity_on_tile_changed(int x, int y, MaterialID oldMaterial, MaterialID newMaterial)
+{
+  if (oldMaterial == MATERIAL_AIR || newMaterial != MATERIAL_AIR)
+  {
+    return;
+  }
+
+  IntegrityState &integrity = gameState->integrity;
+  for (int dir = 0; dir < 4; dir++)
+  {
+    int nx = x + integrityOffsets[dir * 2];
+    int ny = y + integrityOffsets[dir * 2 + 1];
+    if (nx < 0 || nx >= WORLD_GRID.x || ny < 0 || ny >= WORLD_GRID.y || !is_solid(nx, ny) ||
+        integrity.candidates.is_full())
+    {
+      continue;
+    }
+    integrity.candidates.add({nx, ny});
+  }
+}
+
+bool integrity_is_anchor(int x, int y)
+{
+  return y == WORLD_GRID.y - 1 || materialTable.anchor[gameState->worldGrid[x][y].material];
+}
+
+//? Collects the solid tiles connected to start into integrity.island,
+//? returns false if they are held up
+bool integrity_find_island(IVec2 start)
+{
+  IntegrityState &integrity = gameState->integrity;
+  integrity.island.clear();
+  integrity.stamp++;
+
+  integrity.visited[start.x][start.y] = integrity.stamp;
+  integrity.island.add(start);
+
+  // island doubles as the queue
+  for (int head = 0; head < integrity.island.count; head++)
+  {
+    IVec2 tile = integrity.island[head];
+    integrity.searchedTiles++;
+
+    if (integrity_is_anchor(tile.x, tile.y))
+    {
+      return false;
+    }
+
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = tile.x + integrityOffsets[dir * 2];
+      int ny = tile.y + integrityOffsets[dir * 2 + 1];
+      if (nx < 0 || nx >= WORLD_GRID.x || ny < 0 || ny >= WORLD_GRID.y || !is_solid(nx, ny) ||
+          integrity.visited[nx][ny] == integrity.stamp)
+      {
+        continue;
+      }
+
+      // Seen by an earlier search this tick, islands it found are air by now
+      if (integrity.visited[nx][ny] >= integrity.firstStamp)
+      {
+        return false;
+      }
+
+      if (integrity.island.is_full())
+      {
+        return false;
+      }
+      integrity.visited[nx][ny] = integrity.stamp;
+      integrity.island.add({nx, ny});
+    }
+  }
+  return true;
+}
+
+//? Searches from every tile next to a removed tile and drops what is no longer held up
+void integrity_update()
+{
+  IntegrityState &integrity = gameState->integrity;
+  if (!integrity.candidates.count)
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  integrity.firstStamp = integrity.stamp + 1;
+  integrity.searchedTiles = 0;
+
+  // Dropping an island adds candidates, they are all air and skipped
+  for (int idx = 0; idx < integrity.candidates.count; idx++)
+  {
+    IVec2 candidate = integrity.candidates[idx];
+    if (!is_solid(candidate.x, candidate.y) || integrity.visited[candidate.x][candidate.y] >= integrity.firstStamp)
+    {
+      continue;
+    }
+
+    if (!integrity_find_island(candidate))
+    {
+      continue;
+    }
+
+    if (!debris_spawn(integrity.island.elements, integrity.island.count))
+    {
+      LOG_WARN("Too much debris, an island of %d tiles stays in the air", integrity.island.count);
+    }
+  }
+  integrity.candidates.clear();
+
+  integrity.updateMs = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+}
@@ -0,0 +1,289 @@
+#include "game.h"
+
+#include <chrono>
+
+// ################################     Lighting Functions   ################################
+// Light is a flood fill over the tile grid, every step away from a source costs
+// one level. Air at the top of the world is lit by the sky, and sky light falls
+// straight down without fading until it hits a solid tile.
+// Edits only refill the tiles they affect: the removal queue darkens everything
+// the old light reached, then the add queue refills it from the remaining sources.
+// Both queues are drained on the fixed tick with a budget, so a huge edit spreads
+// over a few ticks instead of stalling one
+
+// Top, Left, Right, Bottom, same order as the neighbourMask
+static const int lightOffsets[8] = {0, -1, -1, 0, 1, 0, 0, 1};
+constexpr int LIGHT_DIR_DOWN = 3;
+
+bool light_queue_push(LightQueue &queue, LightNode node)
+{
+  if (queue.count >= LIGHT_QUEUE_SIZE)
+  {
+    // Losing a node would leave wrong light behind, so start over instead
+    gameState->light.needsRebuild = true;
+    return false;
+  }
+
+  queue.nodes[(queue.head + queue.count) % LIGHT_QUEUE_SIZE] = node;
+  queue.count++;
+  return true;
+}
+
+LightNode light_queue_pop(LightQueue &queue)
+{
+  LightNode node = queue.nodes[queue.head];
+  queue.head = (queue.head + 1) % LIGHT_QUEUE_SIZE;
+  queue.count--;
+  return node;
+}
+
+bool light_blocks(int x, int y)
+{
+  return gameState->worldGrid[x][y].material != MATERIAL_AIR;
+}
+
+//? Light the tile gives off on its own
+int light_emission(int x, int y)
+{
+  int emission = gameState->light.sources[x][y];
+  if (y == 0 && !light_blocks(x, y))
+  {
+    emission = MAX_LIGHT_LEVEL;
+  }
+  return emission;
+}
+
+void light_set_level(int x, int y, int level)
+{
+  LightGrid &light = gameState->light;
+  light.levels[x][y] = (uint8_t)level;
+  light.dirtyRegions[x / LIGHT_REGION_SIZE][y / LIGHT_REGION_SIZE] = true;
+}
+
+//? Darken the tile and queue it so everything it lit gets darkened too
+void light_remove(int x, int y)
+{
+  LightGrid &light = gameState->light;
+  int level = light.levels[x][y];
+  if (level == 0)
+  {
+    return;
+  }
+
+  light_set_level(x, y, 0);
+  light_queue_push(light.removeQueue, {(uint16_t)x, (uint16_t)y, (uint8_t)level});
+}
+
+//? Raise the tile to its own emission if that is brighter
+void light_seed(int x, int y)
+{
+  LightGrid &light = gameState->light;
+  int emission = light_emission(x, y);
+  if (emission > light.levels[x][y])
+  {
+    light_set_level(x, y, emission);
+    light_queue_push(light.addQueue, {(uint16_t)x, (uint16_t)y, 0});
+  }
+}
+
+//? Throws away all light and floods the whole world again
+void light_rebuild()
+{
+  LightGrid &light = gameState->light;
+
+  memset(light.levels, 0, sizeof(light.levels));
+  light.removeQueue.head = light.removeQueue.count = 0;
+  light.addQueue.head = light.addQueue.count = 0;
+  light.needsRebuild = false;
+  light.initialized = true;
+
+  for (int x = 0; x < WORLD_GRID.x; x++)
+  {
+    for (int y = 0; y < WORLD_GRID.y; y++)
+    {
+      light_seed(x, y);
+    }
+  }
+
+  for (int regionX = 0; regionX < LIGHT_REGION_GRID.x; regionX++)
+  {
+    for (int regionY = 0; regionY < LIGHT_REGION_GRID.y; regionY++)
+    {
+      light.dirtyRegions[regionX][regionY] = true;
+    }
+  }
+}
+
+void light_on_tile_changed(int x, int y, MaterialID oldMaterial, MaterialID newMaterial)
+{
+  LightGrid &light = gameState->light;
+  if (!light.initialized)
+  {
+    return;
+  }
+
+  // A new solid tile still receives light but stops passing it on
+  if (oldMaterial == MATERIAL_AIR && newMaterial != MATERIAL_AIR)
+  {
+    light_remove(x, y);
+  }
+
+  // The tile and its neighbours flow into each other again, after the removal has finished
+  light_seed(x, y);
+  if (light.levels[x][y])
+  {
+    light_queue_push(light.addQueue, {(uint16_t)x, (uint16_t)y, 0});
+  }
+  for (int dir = 0; dir < 4; dir++)
+  {
+    int nx = x + lightOffsets[dir * 2];
+    int ny = y + lightOffsets[dir * 2 + 1];
+    if (nx >= 0 && nx < WORLD_GRID.x && ny >= 0 && ny < WORLD_GRID.y && light.levels[nx][ny])
+    {
+      light_queue_push(light.addQueue, {(uint16_t)nx, (uint16_t)ny, 0});
+    }
+  }
+}
+
+//? Place, change or remove (level 0) a light source, moving lights
+//? remove themselves at the old tile and place themselves at the new one
+void light_set_source(int x, int y, int level)
+{
+  LightGrid &light = gameState->light;
+  if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+  {
+    return;
+  }
+
+  // Only the sky reaches the max level, that is what keeps sky shafts from fading
+  level = min(max(level, 0), MAX_LIGHT_LEVEL - 1);
+  int oldLevel = light.sources[x][y];
+  light.sources[x][y] = (uint8_t)level;
+
+  if (!light.initialized)
+  {
+    return;
+  }
+
+  if (level < oldLevel)
+  {
+    light_remove(x, y);
+  }
+  light_seed(x, y);
+
+  // A tile lit brighter from outside still has to spread its own light
+  if (level)
+  {
+    light_queue_push(light.addQueue, {(uint16_t)x, (uint16_t)y, 0});
+  }
+}
+
+//? Runs the queued removals and additions, at most LIGHT_BUDGET tiles per call
+void light_update()
+{
+  auto start = std::chrono::steady_clock::now();
+  LightGrid &light = gameState->light;
+
+  if (!light.initialized || light.needsRebuild)
+  {
+    light_rebuild();
+  }
+
+  int visited = 0;
+
+  while (light.removeQueue.count && visited < LIGHT_BUDGET)
+  {
+    LightNode node = light_queue_pop(light.removeQueue);
+    visited++;
+
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = node.x + lightOffsets[dir * 2];
+      int ny = node.y + lightOffsets[dir * 2 + 1];
+      if (nx < 0 || nx >= WORLD_GRID.x || ny < 0 || ny >= WORLD_GRID.y)
+      {
+        continue;
+      }
+
+      int neighbourLevel = light.levels[nx][ny];
+      if (neighbourLevel == 0)
+      {
+        continue;
+      }
+
+      bool skyShaft = dir == LIGHT_DIR_DOWN && node.level == MAX_LIGHT_LEVEL &&
+                      neighbourLevel == MAX_LIGHT_LEVEL;
+      if (neighbourLevel < node.level || skyShaft)
+      {
+        // Lit by the removed light
+        light_remove(nx, ny);
+      }
+      else
+      {
+        // Lit by something else, it refills the darkened area
+        light_queue_push(light.addQueue, {(uint16_t)nx, (uint16_t)ny, 0});
+      }
+    }
+
+    light_seed(node.x, node.y);
+  }
+
+  // Adding before the removal is done would spread light that is about to go away
+  while (!light.removeQueue.count && light.addQueue.count && visited < LIGHT_BUDGET)
+  {
+    LightNode node = light_queue_pop(light.addQueue);
+    visited++;
+
+    // Solid tiles are lit but only pass on their own emission
+    int level = light.levels[node.x][node.y];
+    if (light_blocks(node.x, node.y))
+    {
+      level = min(level, light_emission(node.x, node.y));
+    }
+    if (level <= 1)
+    {
+      continue;
+    }
+
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = node.x + lightOffsets[dir * 2];
+      int ny = node.y + lightOffsets[dir * 2 + 1];
+      if (nx < 0 || nx >= WORLD_GRID.x || ny < 0 || ny >= WORLD_GRID.y)
+      {
+        continue;
+      }
+
+      int newLevel = level - 1;
+      if (dir == LIGHT_DIR_DOWN && level == MAX_LIGHT_LEVEL)
+      {
+        newLevel = MAX_LIGHT_LEVEL;
+      }
+
+      if (light.levels[nx][ny] < newLevel)
+      {
+        light_set_level(nx, ny, newLevel);
+        light_queue_push(light.addQueue, {(uint16_t)nx, (uint16_t)ny, 0});
+      }
+    }
+  }
+
+  // Only the regions that changed are uploaded
+  for (int regionX = 0; regionX < LIGHT_REGION_GRID.x; regionX++)
+  {
+    for (int regionY = 0; regionY < LIGHT_REGION_GRID.y; regionY++)
+    {
+      if (light.dirtyRegions[regionX][regionY])
+      {
+        lightmap_mark_dirty({regionX * LIGHT_REGION_SIZE, regionY * LIGHT_REGION_SIZE,
+                             LIGHT_REGION_SIZE, LIGHT_REGION_SIZE});
+        light.dirtyRegions[regionX][regionY] = false;
+      }
+    }
+  }
+
+  light.nodesVisited = visited;
+  light.updateMs = std::chrono::duration<float, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+}
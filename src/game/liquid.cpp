@@ -0,0 +1,337 @@
+#include "game.h"
+
+#include <chrono>
+
+// ################################     Liquid Functions   ################################
+// Every cell holds a mass of liquid. Each tick a cell pushes liquid down, then to
+// the sides, then up when it is compressed by the liquid above it. Flows of a tick
+// are collected in newMass and newType so the order cells are visited in doesn't matter.
+// Cells that didn't change for LIQUID_SETTLE_TICKS are skipped until something
+// next to them changes, and whole chunks are skipped when all their cells settled.
+// Walls come from the occupancy bitmap, carving a tile opens the path right away
+
+//? How much of total mass the lower of two stacked cells holds
+float liquid_stable_mass(float total)
+{
+  if (total <= LIQUID_MAX_MASS)
+  {
+    return LIQUID_MAX_MASS;
+  }
+  if (total < 2.0f * LIQUID_MAX_MASS + LIQUID_MAX_COMPRESS)
+  {
+    return (LIQUID_MAX_MASS * LIQUID_MAX_MASS + total * LIQUID_MAX_COMPRESS) /
+           (LIQUID_MAX_MASS + LIQUID_MAX_COMPRESS);
+  }
+  return (total + LIQUID_MAX_COMPRESS) / 2.0f;
+}
+
+void liquid_wake(int x, int y)
+{
+  if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+  {
+    return;
+  }
+
+  LiquidGrid &liquid = gameState->liquid;
+  liquid.settleTicks[x][y] = 0;
+  liquid.activeChunks[x / CHUNK_SIZE][y / CHUNK_SIZE] = true;
+
+  // Moving lava and water change the heat around them
+  env_wake(x, y);
+}
+
+void liquid_wake_around(int x, int y)
+{
+  liquid_wake(x, y);
+  liquid_wake(x, y - 1);
+  liquid_wake(x - 1, y);
+  liquid_wake(x + 1, y);
+  liquid_wake(x, y + 1);
+}
+
+void liquid_add(int x, int y, LiquidType type, float mass)
+{
+  LiquidGrid &liquid = gameState->liquid;
+  if (is_solid(x, y))
+  {
+    return;
+  }
+
+  // A cell only holds one kind of liquid
+  if (liquid.type[x][y] != LIQUID_NONE && liquid.type[x][y] != type)
+  {
+    return;
+  }
+
+  liquid.type[x][y] = type;
+  liquid.newType[x][y] = type;
+  liquid.mass[x][y] += mass;
+  liquid.newMass[x][y] = liquid.mass[x][y];
+  liquid.wetChunks[x / CHUNK_SIZE][y / CHUNK_SIZE] = true;
+  liquid_wake_around(x, y);
+}
+
+void liquid_on_tile_changed(int x, int y, MaterialID newMaterial)
+{
+  LiquidGrid &liquid = gameState->liquid;
+
+  // A new tile pushes the liquid out of the world
+  if (newMaterial != MATERIAL_AIR)
+  {
+    liquid.mass[x][y] = 0.0f;
+    liquid.newMass[x][y] = 0.0f;
+    liquid.type[x][y] = LIQUID_NONE;
+    liquid.newType[x][y] = LIQUID_NONE;
+  }
+
+  // Settled liquid next to the tile might be able to flow now
+  liquid_wake_around(x, y);
+}
+
+bool liquid_can_flow(int x, int y, int nx, int ny)
+{
+  LiquidGrid &liquid = gameState->liquid;
+  return !is_solid(nx, ny) &&
+         (liquid.type[nx][ny] == LIQUID_NONE || liquid.type[nx][ny] == liquid.type[x][y]);
+}
+
+//? Only empty cells can be reached by both kinds in one tick, when they are the
+//? cell turns to stone after the flows are applied, like lava touching water
+void liquid_flow(int x, int y, int nx, int ny, float flow)
+{
+  if (flow <= 0.0f)
+  {
+    return;
+  }
+
+  LiquidGrid &liquid = gameState->liquid;
+  liquid.newMass[x][y] -= flow;
+  liquid.newMass[nx][ny] += flow;
+
+  LiquidType flowType = liquid.type[x][y];
+  if (liquid.newType[nx][ny] == LIQUID_NONE)
+  {
+    liquid.newType[nx][ny] = flowType;
+  }
+  else if (liquid.newType[nx][ny] != flowType)
+  {
+    liquid.newType[nx][ny] = LIQUID_LAVA;
+    if (!liquid.reactions.is_full())
+    {
+      liquid.reactions.add({nx, ny});
+    }
+  }
+}
+
+//? Water touching lava turns the lava into stone, returns true if the cell itself turns.
+//? The tiles only change after the flows of the tick are applied, changing them now
+//? would clear newMass in the middle of the pass
+bool liquid_react(int x, int y)
+{
+  LiquidGrid &liquid = gameState->liquid;
+  int offsets[8] = {0, -1, -1, 0, 1, 0, 0, 1};
+
+  for (int n = 0; n < 4; n++)
+  {
+    int nx = x + offsets[n * 2];
+    int ny = y + offsets[n * 2 + 1];
+    if (is_solid(nx, ny) || liquid.mass[nx][ny] <= LIQUID_MIN_MASS ||
+        liquid.type[nx][ny] == LIQUID_NONE || liquid.type[nx][ny] == liquid.type[x][y])
+    {
+      continue;
+    }
+    if (liquid.reactions.is_full())
+    {
+      return false;
+    }
+
+    if (liquid.type[x][y] == LIQUID_LAVA)
+    {
+      liquid.reactions.add({x, y});
+      return true;
+    }
+    if (liquid.type[nx][ny] == LIQUID_LAVA)
+    {
+      liquid.reactions.add({nx, ny});
+    }
+  }
+  return false;
+}
+
+void liquid_simulate_cell(int x, int y)
+{
+  LiquidGrid &liquid = gameState->liquid;
+  float remaining = liquid.mass[x][y];
+
+  // Down
+  if (liquid_can_flow(x, y, x, y + 1))
+  {
+    float below = liquid.mass[x][y + 1];
+    float flow = liquid_stable_mass(remaining + below) - below;
+    if (flow > LIQUID_MIN_FLOW)
+    {
+      flow *= 0.5f;
+    }
+    flow = max(min(flow, min(LIQUID_MAX_FLOW, remaining)), 0.0f);
+
+    liquid_flow(x, y, x, y + 1, flow);
+    remaining -= flow;
+  }
+
+  // Left and right, evening out with the neighbour
+  for (int side = -1; side <= 1 && remaining > 0.0f; side += 2)
+  {
+    if (!liquid_can_flow(x, y, x + side, y))
+    {
+      continue;
+    }
+
+    float flow = (remaining - liquid.mass[x + side][y]) / 4.0f;
+    if (flow > LIQUID_MIN_FLOW)
+    {
+      flow *= 0.5f;
+    }
+    flow = max(min(flow, remaining), 0.0f);
+
+    liquid_flow(x, y, x + side, y, flow);
+    remaining -= flow;
+  }
+
+  // Up, only compressed liquid goes up
+  if (remaining > 0.0f && liquid_can_flow(x, y, x, y - 1))
+  {
+    float above = liquid.mass[x][y - 1];
+    float flow = remaining - liquid_stable_mass(remaining + above);
+    if (flow > LIQUID_MIN_FLOW)
+    {
+      flow *= 0.5f;
+    }
+    flow = max(min(flow, min(LIQUID_MAX_FLOW, remaining)), 0.0f);
+
+    liquid_flow(x, y, x, y - 1, flow);
+  }
+}
+
+//? Steps all unsettled cells once
+void liquid_update()
+{
+  auto start = std::chrono::steady_clock::now();
+  LiquidGrid &liquid = gameState->liquid;
+
+  // Flows reach one cell into the neighbouring chunks
+  bool touchedChunks[CHUNK_GRID.x][CHUNK_GRID.y] = {};
+  int activeCells = 0;
+
+  for (int chunkX = 0; chunkX < CHUNK_GRID.x; chunkX++)
+  {
+    for (int chunkY = 0; chunkY < CHUNK_GRID.y; chunkY++)
+    {
+      if (!liquid.activeChunks[chunkX][chunkY])
+      {
+        continue;
+      }
+
+      for (int touchedX = max(chunkX - 1, 0); touchedX <= min(chunkX + 1, CHUNK_GRID.x - 1); touchedX++)
+      {
+        for (int touchedY = max(chunkY - 1, 0); touchedY <= min(chunkY + 1, CHUNK_GRID.y - 1); touchedY++)
+        {
+          touchedChunks[touchedX][touchedY] = true;
+        }
+      }
+
+      IRect chunkRect = get_chunk_rect({chunkX, chunkY});
+      int maxX = min(chunkRect.pos.x + chunkRect.size.x, WORLD_GRID.x);
+      int maxY = min(chunkRect.pos.y + chunkRect.size.y, WORLD_GRID.y);
+      for (int x = chunkRect.pos.x; x < maxX; x++)
+      {
+        for (int y = chunkRect.pos.y; y < maxY; y++)
+        {
+          if (liquid.mass[x][y] <= LIQUID_MIN_MASS ||
+              liquid.settleTicks[x][y] >= LIQUID_SETTLE_TICKS)
+          {
+            continue;
+          }
+          activeCells++;
+
+          if (liquid_react(x, y))
+          {
+            continue;
+          }
+          liquid_simulate_cell(x, y);
+        }
+      }
+    }
+  }
+
+  // Apply the flows, chunks stay active while they have an unsettled cell
+  for (int chunkX = 0; chunkX < CHUNK_GRID.x; chunkX++)
+  {
+    for (int chunkY = 0; chunkY < CHUNK_GRID.y; chunkY++)
+    {
+      if (touchedChunks[chunkX][chunkY])
+      {
+        liquid.activeChunks[chunkX][chunkY] = false;
+      }
+    }
+  }
+
+  for (int chunkX = 0; chunkX < CHUNK_GRID.x; chunkX++)
+  {
+    for (int chunkY = 0; chunkY < CHUNK_GRID.y; chunkY++)
+    {
+      if (!touchedChunks[chunkX][chunkY])
+      {
+        continue;
+      }
+
+      IRect chunkRect = get_chunk_rect({chunkX, chunkY});
+      int maxX = min(chunkRect.pos.x + chunkRect.size.x, WORLD_GRID.x);
+      int maxY = min(chunkRect.pos.y + chunkRect.size.y, WORLD_GRID.y);
+      bool wet = false;
+      for (int x = chunkRect.pos.x; x < maxX; x++)
+      {
+        for (int y = chunkRect.pos.y; y < maxY; y++)
+        {
+          float change = liquid.newMass[x][y] - liquid.mass[x][y];
+          liquid.mass[x][y] = liquid.newMass[x][y];
+          liquid.type[x][y] = liquid.newType[x][y];
+
+          if (liquid.mass[x][y] <= LIQUID_MIN_MASS)
+          {
+            liquid.mass[x][y] = 0.0f;
+            liquid.newMass[x][y] = 0.0f;
+            liquid.type[x][y] = LIQUID_NONE;
+            liquid.newType[x][y] = LIQUID_NONE;
+          }
+
+          if (fabsf(change) > LIQUID_SETTLE_EPSILON)
+          {
+            liquid_wake_around(x, y);
+          }
+          else if (liquid.settleTicks[x][y] < LIQUID_SETTLE_TICKS)
+          {
+            liquid.settleTicks[x][y]++;
+          }
+
+          if (liquid.mass[x][y] > 0.0f && liquid.settleTicks[x][y] < LIQUID_SETTLE_TICKS)
+          {
+            liquid.activeChunks[chunkX][chunkY] = true;
+          }
+          wet = wet || liquid.mass[x][y] > 0.0f;
+        }
+      }
+      liquid.wetChunks[chunkX][chunkY] = wet;
+    }
+  }
+
+  for (int idx = 0; idx < liquid.reactions.count; idx++)
+  {
+    set_tile_material(liquid.reactions[idx].x, liquid.reactions[idx].y, MATERIAL_STONE);
+  }
+  liquid.reactions.clear();
+
+  liquid.activeCells = activeCells;
+  liquid.updateMs = std::chrono::duration<float, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../vaultEngine_lib.h"
+#include "../engine_utils/shader_header.h"
+#include "../engine_utils/assets.h"
+
+// ################################     Material Constants   ################################
+// Every solid material has a tileset of 21 variants picked by the neighbourMask
+constexpr int TILE_VARIANT_COUNT = 21;
+
+// ################################     Material Structs   ################################
+enum MaterialID : uint8_t
+{
+    MATERIAL_AIR,
+    MATERIAL_DIRT,
+    MATERIAL_STONE,
+    MATERIAL_COAL,
+    MATERIAL_GOLD,
+    MATERIAL_BEDROCK,
+
+    MATERIAL_COUNT
+};
+static_assert(MATERIAL_COUNT <= MAX_TILE_MATERIALS, "The tilemap shader can't index this many materials");
+
+enum ItemID : uint8_t
+{
+    ITEM_NONE,
+    ITEM_DIRT,
+    ITEM_STONE,
+    ITEM_COAL,
+    ITEM_GOLD,
+
+    ITEM_COUNT
+};
+
+struct MaterialInfo
+{
+    float hardness;     // Hits to break, INFINITY can't be mined
+    float density;      // Relative to water
+    float flammability; // Chance to ignite [0; 1]
+    IVec2 atlasOrigin;  // Top left of the tileset in the atlas, every material has its own
+    SpriteID overlaySprite; // Drawn on top of the tile, SPRITE_BLANK for none
+    ItemID dropID;
+    bool collides;
+    bool anchor; // Holds up every tile connected to it
+};
+
+// Same data as MaterialInfo but one array per property, so a loop only
+// pulls the property it needs into cache. Indexed by MaterialID
+struct MaterialTable
+{
+    float hardness[MATERIAL_COUNT];
+    float density[MATERIAL_COUNT];
+    float flammability[MATERIAL_COUNT];
+    IVec2 atlasOffsets[MATERIAL_COUNT][TILE_VARIANT_COUNT];
+    SpriteID overlaySprite[MATERIAL_COUNT];
+    ItemID dropID[MATERIAL_COUNT];
+    bool collides[MATERIAL_COUNT];
+    bool anchor[MATERIAL_COUNT];
+};
+
+// ################################     Material Globals   ################################
+// Lives in the game DLL and is rebuilt on every reload, so values can be tweaked live
+static MaterialTable materialTable;
+
+// ################################     Material Functions   ################################
+MaterialInfo get_material_info(MaterialID materialID)
+{
+    MaterialInfo info = {};
+
+    switch (materialID)
+    {
+    case MATERIAL_AIR:
+    {
+        break;
+    }
+    case MATERIAL_DIRT:
+    {
+        info.hardness = 1.0f;
+        info.density = 1.5f;
+        info.atlasOrigin = {0, 64};
+        info.dropID = ITEM_DIRT;
+        info.collides = true;
+        break;
+    }
+    case MATERIAL_STONE:
+    {
+        info.hardness = 3.0f;
+        info.density = 2.6f;
+        info.atlasOrigin = {48, 64};
+        info.dropID = ITEM_STONE;
+        info.collides = true;
+        break;
+    }
+    case MATERIAL_COAL:
+    {
+        info.hardness = 2.5f;
+        info.density = 1.4f;
+        info.flammability = 0.8f;
+        info.atlasOrigin = {96, 64};
+        info.overlaySprite = SPRITE_ORE_COAL;
+        info.dropID = ITEM_COAL;
+        info.collides = true;
+        break;
+    }
+    case MATERIAL_GOLD:
+    {
+        info.hardness = 4.0f;
+        info.density = 5.0f;
+        info.atlasOrigin = {144, 64};
+        info.overlaySprite = SPRITE_ORE_GOLD;
+        info.dropID = ITEM_GOLD;
+        info.collides = true;
+        break;
+    }
+    case MATERIAL_BEDROCK:
+    {
+        info.hardness = INFINITY;
+        info.density = 3.0f;
+        info.atlasOrigin = {184, 64};
+        info.dropID = ITEM_NONE;
+        info.collides = true;
+        info.anchor = true;
+        break;
+    }
+    }
+    return info;
+}
+
+//? Fills the SoA table from get_material_info()
+void init_material_table()
+{
+    for (int materialID = 0; materialID < MATERIAL_COUNT; materialID++)
+    {
+        MaterialInfo info = get_material_info((MaterialID)materialID);
+
+        materialTable.hardness[materialID] = info.hardness;
+        materialTable.density[materialID] = info.density;
+        materialTable.flammability[materialID] = info.flammability;
+        materialTable.overlaySprite[materialID] = info.overlaySprite;
+        materialTable.dropID[materialID] = info.dropID;
+        materialTable.collides[materialID] = info.collides;
+        materialTable.anchor[materialID] = info.anchor;
+
+        // Variants are laid out 4 per row, the last one (black inside) starts a new row
+        for (int variant = 0; variant < TILE_VARIANT_COUNT; variant++)
+        {
+            materialTable.atlasOffsets[materialID][variant] =
+                {info.atlasOrigin.x + (variant % TILESET_COLUMNS) * 8,
+                 info.atlasOrigin.y + (variant / TILESET_COLUMNS) * 8};
+        }
+    }
+}
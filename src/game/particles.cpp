@@ -0,0 +1,206 @@
+#include "game.h"
+
+#include <chrono>
+#include <emmintrin.h>
+
+// ################################     Particle Functions   ################################
+// Sparks, dust and blood. Particles never change the world, they only bounce off
+// it: collisions read the occupancy rows, a bit per tile that set_tile_material()
+// keeps in sync, so a test is a single load. Motion is integrated four particles
+// at a time with SSE and written back to where the live particles end, which
+// packs them at the front without a second pass. The same writes fill the
+// instance buffer the renderer uploads as it is. Groups where a particle died
+// or hit a tile go lane by lane
+
+//? Next number of the burst spread (xorshift)
+uint32_t particle_random()
+{
+  uint32_t &seed = gameState->particles.seed;
+  if (!seed)
+  {
+    seed = 0x9E3779B9u;
+  }
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+//? Adds a particle, returns false if the pool is full
+bool particle_spawn(Vec2 pos, Vec2 vel, float life, uint32_t color)
+{
+  ParticleSystem &particles = gameState->particles;
+  if (particles.count >= MAX_PARTICLES)
+  {
+    return false;
+  }
+
+  int idx = particles.count++;
+  particles.posX[idx] = pos.x;
+  particles.posY[idx] = pos.y;
+  particles.velX[idx] = vel.x;
+  particles.velY[idx] = vel.y;
+  particles.life[idx] = life;
+  particles.colors[idx] = color;
+  return true;
+}
+
+//? count particles flying out of pos in random directions at up to speed
+void particle_burst(Vec2 pos, int count, float speed, float life, uint32_t color)
+{
+  for (int idx = 0; idx < count; idx++)
+  {
+    float angle = (particle_random() & 0xFFFF) * (6.2831853f / 65536.0f);
+    float length = (particle_random() & 0xFFFF) * (speed / 65536.0f);
+    if (!particle_spawn(pos, Vec2{cosf(angle), sinf(angle)} * length, life, color))
+    {
+      return;
+    }
+  }
+}
+
+static_assert(sizeof(ParticleInstance) == 4 * sizeof(float), "Instances are written a vector at a time");
+
+bool particle_hits_tile(int x, int y)
+{
+  return (gameState->occupancy.rows[y][x / 64] >> (x % 64)) & 1;
+}
+
+//? Moves every particle, bounces them off tiles and drops the dead ones
+void particles_update(float dt)
+{
+  ParticleSystem &particles = gameState->particles;
+  particles.bounces = 0;
+  particles.killed = 0;
+  if (!particles.count)
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  __m128 dtStep = _mm_set1_ps(dt);
+  __m128 gravityStep = _mm_set1_ps(PARTICLE_GRAVITY * dt);
+  __m128 invTileSize = _mm_set1_ps(1.0f / TILESIZE);
+  __m128 zero = _mm_setzero_ps();
+  __m128 worldWidth = _mm_set1_ps((float)(WORLD_GRID.x * TILESIZE));
+  __m128 worldHeight = _mm_set1_ps((float)(WORLD_GRID.y * TILESIZE));
+
+  int count = particles.count;
+  int live = 0;
+  for (int idx = 0; idx < count; idx += 4)
+  {
+    __m128 oldX = _mm_loadu_ps(&particles.posX[idx]);
+    __m128 oldY = _mm_loadu_ps(&particles.posY[idx]);
+    __m128 velX = _mm_loadu_ps(&particles.velX[idx]);
+    __m128 velY = _mm_add_ps(_mm_loadu_ps(&particles.velY[idx]), gravityStep);
+    __m128 life = _mm_sub_ps(_mm_loadu_ps(&particles.life[idx]), dtStep);
+    __m128 posX = _mm_add_ps(oldX, _mm_mul_ps(velX, dtStep));
+    __m128 posY = _mm_add_ps(oldY, _mm_mul_ps(velY, dtStep));
+
+    // Particles leaving the world die with the ones out of life
+    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(posX, zero), _mm_cmplt_ps(posX, worldWidth)),
+                               _mm_and_ps(_mm_cmpge_ps(posY, zero), _mm_cmplt_ps(posY, worldHeight)));
+    int alive = _mm_movemask_ps(_mm_and_ps(inside, _mm_cmpgt_ps(life, zero)));
+    if (count - idx < 4)
+    {
+      alive &= (1 << (count - idx)) - 1;
+    }
+
+    // Tiles under the new positions, only looked at for lanes that are still alive
+    int tileX[4], tileY[4];
+    _mm_storeu_si128((__m128i *)tileX, _mm_cvttps_epi32(_mm_mul_ps(posX, invTileSize)));
+    _mm_storeu_si128((__m128i *)tileY, _mm_cvttps_epi32(_mm_mul_ps(posY, invTileSize)));
+    int hits = 0;
+    for (int lane = 0; lane < 4; lane++)
+    {
+      if (((alive >> lane) & 1) && particle_hits_tile(tileX[lane], tileY[lane]))
+      {
+        hits |= 1 << lane;
+      }
+    }
+
+    // Mostly all four fly on, then they are written as they are. live never
+    // passes idx, so nothing that wasn't read yet is overwritten
+    if (alive == 0xF && !hits)
+    {
+      __m128 colors = _mm_loadu_ps((float *)&particles.colors[idx]);
+      _mm_storeu_ps(&particles.posX[live], posX);
+      _mm_storeu_ps(&particles.posY[live], posY);
+      _mm_storeu_ps(&particles.velX[live], velX);
+      _mm_storeu_ps(&particles.velY[live], velY);
+      _mm_storeu_ps(&particles.life[live], life);
+      _mm_storeu_ps((float *)&particles.colors[live], colors);
+
+      // Interleaved into four instances of x, y, colour and padding
+      __m128 posLow = _mm_unpacklo_ps(posX, posY);
+      __m128 posHigh = _mm_unpackhi_ps(posX, posY);
+      __m128 colorLow = _mm_unpacklo_ps(colors, zero);
+      __m128 colorHigh = _mm_unpackhi_ps(colors, zero);
+      float *instances = (float *)&particles.instances[live];
+      _mm_storeu_ps(instances, _mm_movelh_ps(posLow, colorLow));
+      _mm_storeu_ps(instances + 4, _mm_movehl_ps(colorLow, posLow));
+      _mm_storeu_ps(instances + 8, _mm_movelh_ps(posHigh, colorHigh));
+      _mm_storeu_ps(instances + 12, _mm_movehl_ps(colorHigh, posHigh));
+      live += 4;
+      continue;
+    }
+
+    float x[4], y[4], vx[4], vy[4], lifeLeft[4], fromX[4], fromY[4];
+    _mm_storeu_ps(x, posX);
+    _mm_storeu_ps(y, posY);
+    _mm_storeu_ps(vx, velX);
+    _mm_storeu_ps(vy, velY);
+    _mm_storeu_ps(lifeLeft, life);
+    _mm_storeu_ps(fromX, oldX);
+    _mm_storeu_ps(fromY, oldY);
+
+    for (int lane = 0; lane < 4; lane++)
+    {
+      bool isAlive = (alive >> lane) & 1;
+      if ((hits >> lane) & 1)
+      {
+        // Back out along the axes that ran into a tile, both at a corner.
+        // A tile built on top of the particle kills it
+        int oldTileX = min(max((int)(fromX[lane] * (1.0f / TILESIZE)), 0), WORLD_GRID.x - 1);
+        int oldTileY = min(max((int)(fromY[lane] * (1.0f / TILESIZE)), 0), WORLD_GRID.y - 1);
+        bool hitX = particle_hits_tile(tileX[lane], oldTileY);
+        bool hitY = particle_hits_tile(oldTileX, tileY[lane]);
+        if (!hitX && !hitY)
+        {
+          hitX = hitY = true;
+        }
+        if (hitX)
+        {
+          x[lane] = fromX[lane];
+          vx[lane] = -vx[lane] * PARTICLE_BOUNCE;
+        }
+        if (hitY)
+        {
+          y[lane] = fromY[lane];
+          vy[lane] = -vy[lane] * PARTICLE_BOUNCE;
+        }
+        isAlive = !particle_hits_tile(oldTileX, oldTileY);
+        particles.bounces++;
+      }
+
+      // Every lane is written, only live ones move the end forward
+      uint32_t color = particles.colors[idx + lane];
+      particles.posX[live] = x[lane];
+      particles.posY[live] = y[lane];
+      particles.velX[live] = vx[lane];
+      particles.velY[live] = vy[lane];
+      particles.life[live] = lifeLeft[lane];
+      particles.colors[live] = color;
+      particles.instances[live] = {Vec2{x[lane], y[lane]}, (int)color, 0};
+      live += isAlive;
+    }
+  }
+
+  particles.killed = count - live;
+  particles.count = live;
+
+  particles.updateMs = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+}
@@ -0,0 +1,743 @@
+#include "game.h"
+
+#include <chrono>
+
+// ################################     Pathfinding Functions   ################################
+// Hierarchical A*. The grid is split into clusters of NAV_CLUSTER_SIZE tiles.
+// Every walkable opening between two clusters gets a node on both sides, and the
+// walking distances between the nodes of a cluster are cached. A query only
+// searches this small graph, then callers refine one leg at a time with
+// nav_refine_segment(). An edit only rebuilds the clusters next to it.
+// Movement is 4-connected and every step costs 1. The heuristic is weighted,
+// caves make the straight line distance a bad guess and the search would
+// visit most of the map for a few percent shorter paths
+
+// Top, Left, Right, Bottom, same order as the neighbourMask
+static const int navOffsets[8] = {0, -1, -1, 0, 1, 0, 0, 1};
+constexpr int NAV_START_NODE = NAV_NODE_COUNT;
+constexpr int NAV_GOAL_NODE = NAV_NODE_COUNT + 1;
+
+IVec2 nav_get_cluster(int x, int y)
+{
+  return {x / NAV_CLUSTER_SIZE, y / NAV_CLUSTER_SIZE};
+}
+
+//? Tiles of the cluster, smaller at the edge of the world
+IRect nav_get_cluster_rect(IVec2 cluster)
+{
+  IVec2 pos = cluster * NAV_CLUSTER_SIZE;
+  return {pos.x, pos.y,
+          min(NAV_CLUSTER_SIZE, WORLD_GRID.x - pos.x),
+          min(NAV_CLUSTER_SIZE, WORLD_GRID.y - pos.y)};
+}
+
+NavCluster &nav_cluster(IVec2 cluster)
+{
+  return gameState->nav.clusters[cluster.x][cluster.y];
+}
+
+//? Breadth first search from start that never leaves the cluster.
+//? distances and parents are indexed by the tile inside the cluster, parents can be null
+void nav_cluster_bfs(IRect rect, IVec2 start, uint16_t *distances, uint16_t *parents)
+{
+  int tileCount = rect.size.x * rect.size.y;
+  for (int idx = 0; idx < tileCount; idx++)
+  {
+    distances[idx] = NAV_UNREACHABLE;
+  }
+
+  uint16_t queue[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+  int head = 0, tail = 0;
+
+  int startIdx = (start.x - rect.pos.x) + (start.y - rect.pos.y) * rect.size.x;
+  distances[startIdx] = 0;
+  queue[tail++] = (uint16_t)startIdx;
+
+  while (head < tail)
+  {
+    int idx = queue[head++];
+    int localX = idx % rect.size.x;
+    int localY = idx / rect.size.x;
+
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int nx = localX + navOffsets[dir * 2];
+      int ny = localY + navOffsets[dir * 2 + 1];
+      if (nx < 0 || nx >= rect.size.x || ny < 0 || ny >= rect.size.y)
+      {
+        continue;
+      }
+
+      int neighbourIdx = nx + ny * rect.size.x;
+      if (distances[neighbourIdx] != NAV_UNREACHABLE ||
+          is_solid(rect.pos.x + nx, rect.pos.y + ny))
+      {
+        continue;
+      }
+
+      distances[neighbourIdx] = distances[idx] + 1;
+      if (parents)
+      {
+        parents[neighbourIdx] = (uint16_t)idx;
+      }
+      queue[tail++] = (uint16_t)neighbourIdx;
+    }
+  }
+}
+
+int nav_find_node(NavCluster &cluster, int x, int y)
+{
+  for (int idx = 0; idx < cluster.nodeCount; idx++)
+  {
+    if (cluster.nodes[idx].x == x && cluster.nodes[idx].y == y)
+    {
+      return idx;
+    }
+  }
+  return -1;
+}
+
+void nav_add_node(NavCluster &cluster, int x, int y, int side)
+{
+  // A corner tile can open to two clusters
+  int idx = nav_find_node(cluster, x, y);
+  if (idx < 0)
+  {
+    if (cluster.nodeCount >= MAX_CLUSTER_NODES)
+    {
+      LOG_WARN("Cluster has more than %d entrances, tile %d, %d is not connected", MAX_CLUSTER_NODES, x, y);
+      return;
+    }
+    idx = cluster.nodeCount++;
+    cluster.nodes[idx] = {(uint16_t)x, (uint16_t)y, 0};
+  }
+  cluster.nodes[idx].linkDirs |= BIT(side);
+}
+
+//? Finds the entrances on one side of the cluster. Both clusters of a border
+//? walk the same tiles in the same order, so their nodes always pair up
+void nav_add_border_nodes(NavCluster &cluster, IRect rect, int side)
+{
+  int dx = navOffsets[side * 2];
+  int dy = navOffsets[side * 2 + 1];
+
+  // First tile of the side and the step along it
+  IVec2 tile = {dx > 0 ? rect.pos.x + rect.size.x - 1 : rect.pos.x,
+                dy > 0 ? rect.pos.y + rect.size.y - 1 : rect.pos.y};
+  IVec2 step = dx ? IVec2{0, 1} : IVec2{1, 0};
+  int length = dx ? rect.size.y : rect.size.x;
+
+  int runStart = -1;
+  for (int idx = 0; idx <= length; idx++)
+  {
+    IVec2 pos = tile + step * idx;
+    bool open = idx < length && !is_solid(pos.x, pos.y) && !is_solid(pos.x + dx, pos.y + dy);
+
+    if (open && runStart < 0)
+    {
+      runStart = idx;
+    }
+    else if (!open && runStart >= 0)
+    {
+      // Short openings get one entrance in the middle, long ones one at each end
+      int runEnd = idx - 1;
+      if (runEnd - runStart + 1 < 6)
+      {
+        IVec2 middle = tile + step * ((runStart + runEnd) / 2);
+        nav_add_node(cluster, middle.x, middle.y, side);
+      }
+      else
+      {
+        IVec2 first = tile + step * runStart;
+        IVec2 last = tile + step * runEnd;
+        nav_add_node(cluster, first.x, first.y, side);
+        nav_add_node(cluster, last.x, last.y, side);
+      }
+      runStart = -1;
+    }
+  }
+}
+
+//? Recreates the nodes of the cluster and the distances between them
+void nav_build_cluster(IVec2 clusterPos)
+{
+  NavCluster &cluster = nav_cluster(clusterPos);
+  IRect rect = nav_get_cluster_rect(clusterPos);
+
+  cluster.nodeCount = 0;
+  for (int side = 0; side < 4; side++)
+  {
+    nav_add_border_nodes(cluster, rect, side);
+  }
+
+  uint16_t distances[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+  for (int from = 0; from < cluster.nodeCount; from++)
+  {
+    NavNode &node = cluster.nodes[from];
+    nav_cluster_bfs(rect, {node.x, node.y}, distances, nullptr);
+
+    for (int to = 0; to < cluster.nodeCount; to++)
+    {
+      NavNode &other = cluster.nodes[to];
+      cluster.distances[from][to] =
+          distances[(other.x - rect.pos.x) + (other.y - rect.pos.y) * rect.size.x];
+    }
+  }
+}
+
+void nav_mark_dirty(int x, int y)
+{
+  if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+  {
+    return;
+  }
+
+  NavGraph &nav = gameState->nav;
+  IVec2 clusterPos = nav_get_cluster(x, y);
+  NavCluster &cluster = nav_cluster(clusterPos);
+  if (!cluster.dirty)
+  {
+    cluster.dirty = true;
+    nav.dirtyClusters.add(clusterPos);
+  }
+}
+
+void nav_on_tile_changed(int x, int y)
+{
+  nav_mark_dirty(x, y);
+
+  // Tiles on the border also change the entrances of the cluster next to it
+  for (int dir = 0; dir < 4; dir++)
+  {
+    int nx = x + navOffsets[dir * 2];
+    int ny = y + navOffsets[dir * 2 + 1];
+    if (nx / NAV_CLUSTER_SIZE != x / NAV_CLUSTER_SIZE || ny / NAV_CLUSTER_SIZE != y / NAV_CLUSTER_SIZE)
+    {
+      nav_mark_dirty(nx, ny);
+    }
+  }
+}
+
+int nav_node_id(IVec2 clusterPos, int idx)
+{
+  return (clusterPos.y * NAV_CLUSTER_GRID.x + clusterPos.x) * MAX_CLUSTER_NODES + idx;
+}
+
+//? The node right across the side of the cluster, -1 if it has none there
+int nav_linked_node(NavNode &navNode, int dir)
+{
+  if (!(navNode.linkDirs & BIT(dir)))
+  {
+    return -1;
+  }
+
+  int nx = navNode.x + navOffsets[dir * 2];
+  int ny = navNode.y + navOffsets[dir * 2 + 1];
+  IVec2 neighbourPos = nav_get_cluster(nx, ny);
+  int neighbourIdx = nav_find_node(nav_cluster(neighbourPos), nx, ny);
+  return neighbourIdx >= 0 ? nav_node_id(neighbourPos, neighbourIdx) : -1;
+}
+
+//? Root of the component id, ids are merged when a rebuilt cluster joins them
+uint32_t nav_find_component(uint32_t component)
+{
+  uint32_t *parents = gameState->nav.componentParents;
+  while (parents[component] != component)
+  {
+    parents[component] = parents[parents[component]];
+    component = parents[component];
+  }
+  return component;
+}
+
+//? Floods the graph from every node that has no component yet, afterwards two nodes
+//? have the same id exactly if they can reach each other
+void nav_label_components()
+{
+  NavGraph &nav = gameState->nav;
+  memset(nav.components, 0, sizeof(nav.components));
+
+  // The heap is only used during a query
+  int *stack = nav.heap;
+  uint32_t component = 0;
+  for (int clusterIdx = 0; clusterIdx < NAV_CLUSTER_COUNT; clusterIdx++)
+  {
+    IVec2 firstCluster = {clusterIdx % NAV_CLUSTER_GRID.x, clusterIdx / NAV_CLUSTER_GRID.x};
+    for (int firstIdx = 0; firstIdx < nav_cluster(firstCluster).nodeCount; firstIdx++)
+    {
+      int first = nav_node_id(firstCluster, firstIdx);
+      if (nav.components[first])
+      {
+        continue;
+      }
+
+      component++;
+      nav.components[first] = component;
+      int stackCount = 0;
+      stack[stackCount++] = first;
+      while (stackCount)
+      {
+        int node = stack[--stackCount];
+        int nodeIdx = node % MAX_CLUSTER_NODES;
+        IVec2 clusterPos = {(node / MAX_CLUSTER_NODES) % NAV_CLUSTER_GRID.x,
+                            (node / MAX_CLUSTER_NODES) / NAV_CLUSTER_GRID.x};
+        NavCluster &cluster = nav_cluster(clusterPos);
+
+        for (int idx = 0; idx < cluster.nodeCount; idx++)
+        {
+          int next = nav_node_id(clusterPos, idx);
+          if (!nav.components[next] && cluster.distances[nodeIdx][idx] != NAV_UNREACHABLE)
+          {
+            nav.components[next] = component;
+            stack[stackCount++] = next;
+          }
+        }
+        for (int dir = 0; dir < 4; dir++)
+        {
+          int next = nav_linked_node(cluster.nodes[nodeIdx], dir);
+          if (next >= 0 && !nav.components[next])
+          {
+            nav.components[next] = component;
+            stack[stackCount++] = next;
+          }
+        }
+      }
+    }
+  }
+
+  for (uint32_t idx = 0; idx <= component; idx++)
+  {
+    nav.componentParents[idx] = idx;
+  }
+  nav.componentCount = component;
+}
+
+//? Gives the nodes of a rebuilt cluster new ids, one per group that can reach each other inside of it
+void nav_label_cluster_components(IVec2 clusterPos)
+{
+  NavGraph &nav = gameState->nav;
+  NavCluster &cluster = nav_cluster(clusterPos);
+  for (int idx = 0; idx < cluster.nodeCount; idx++)
+  {
+    nav.components[nav_node_id(clusterPos, idx)] = 0;
+  }
+
+  for (int from = 0; from < cluster.nodeCount; from++)
+  {
+    int node = nav_node_id(clusterPos, from);
+    if (nav.components[node])
+    {
+      continue;
+    }
+
+    uint32_t component = ++nav.componentCount;
+    nav.componentParents[component] = component;
+    nav.components[node] = component;
+    for (int to = from + 1; to < cluster.nodeCount; to++)
+    {
+      if (cluster.distances[from][to] != NAV_UNREACHABLE)
+      {
+        nav.components[nav_node_id(clusterPos, to)] = component;
+      }
+    }
+  }
+}
+
+//? Merges the ids of the rebuilt cluster with the ones of the clusters it links into.
+//? A wall can split a component as well, that is only noticed once a search fails
+void nav_join_cluster_components(IVec2 clusterPos)
+{
+  NavGraph &nav = gameState->nav;
+  NavCluster &cluster = nav_cluster(clusterPos);
+  for (int idx = 0; idx < cluster.nodeCount; idx++)
+  {
+    int node = nav_node_id(clusterPos, idx);
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int next = nav_linked_node(cluster.nodes[idx], dir);
+      if (next < 0)
+      {
+        continue;
+      }
+
+      uint32_t component = nav_find_component(nav.components[node]);
+      uint32_t nextComponent = nav_find_component(nav.components[next]);
+      if (component != nextComponent)
+      {
+        nav.componentParents[nextComponent] = component;
+      }
+    }
+  }
+}
+
+//? Component of a tile, from its distances to the nodes of its cluster. 0 if it can't
+//? leave the cluster
+uint32_t nav_tile_component(IVec2 clusterPos, IRect rect, uint16_t *distances)
+{
+  NavCluster &cluster = nav_cluster(clusterPos);
+  for (int idx = 0; idx < cluster.nodeCount; idx++)
+  {
+    NavNode &node = cluster.nodes[idx];
+    if (distances[(node.x - rect.pos.x) + (node.y - rect.pos.y) * rect.size.x] != NAV_UNREACHABLE)
+    {
+      return nav_find_component(gameState->nav.components[nav_node_id(clusterPos, idx)]);
+    }
+  }
+  return 0;
+}
+
+//? Rebuilds the clusters changed since the last call
+void nav_update()
+{
+  NavGraph &nav = gameState->nav;
+  if (nav.initialized && !nav.dirtyClusters.count)
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int rebuilt = 0;
+
+  if (!nav.initialized)
+  {
+    for (int clusterX = 0; clusterX < NAV_CLUSTER_GRID.x; clusterX++)
+    {
+      for (int clusterY = 0; clusterY < NAV_CLUSTER_GRID.y; clusterY++)
+      {
+        nav_build_cluster({clusterX, clusterY});
+        nav.clusters[clusterX][clusterY].dirty = false;
+        rebuilt++;
+      }
+    }
+    nav.initialized = true;
+    nav_label_components();
+  }
+  else
+  {
+    for (int idx = 0; idx < nav.dirtyClusters.count; idx++)
+    {
+      nav_build_cluster(nav.dirtyClusters[idx]);
+      nav_cluster(nav.dirtyClusters[idx]).dirty = false;
+      rebuilt++;
+    }
+  }
+
+  // Every rebuild hands out new ids, start over before they run out
+  if (nav.componentCount + rebuilt * MAX_CLUSTER_NODES >= NAV_NODE_COUNT)
+  {
+    nav_label_components();
+  }
+  else
+  {
+    // All of them get ids first, the joins read the ones of the neighbours
+    for (int idx = 0; idx < nav.dirtyClusters.count; idx++)
+    {
+      nav_label_cluster_components(nav.dirtyClusters[idx]);
+    }
+    for (int idx = 0; idx < nav.dirtyClusters.count; idx++)
+    {
+      nav_join_cluster_components(nav.dirtyClusters[idx]);
+    }
+  }
+  nav.dirtyClusters.clear();
+
+  nav.rebuiltClusters = rebuilt;
+  nav.rebuildMs = std::chrono::duration<float, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
+
+// Abstract search
+IVec2 nav_node_pos(int node, IVec2 start, IVec2 goal)
+{
+  if (node == NAV_START_NODE)
+  {
+    return start;
+  }
+  if (node == NAV_GOAL_NODE)
+  {
+    return goal;
+  }
+
+  int clusterIdx = node / MAX_CLUSTER_NODES;
+  NavCluster &cluster = nav_cluster({clusterIdx % NAV_CLUSTER_GRID.x, clusterIdx / NAV_CLUSTER_GRID.x});
+  NavNode &navNode = cluster.nodes[node % MAX_CLUSTER_NODES];
+  return {navNode.x, navNode.y};
+}
+
+void nav_heap_swap(int a, int b)
+{
+  NavGraph &nav = gameState->nav;
+  int nodeA = nav.heap[a];
+  nav.heap[a] = nav.heap[b];
+  nav.heap[b] = nodeA;
+  nav.search[nav.heap[a]].heapIndex = a;
+  nav.search[nav.heap[b]].heapIndex = b;
+}
+
+//? Lower f first, on a tie the node further along the path
+bool nav_heap_less(int a, int b)
+{
+  NavGraph &nav = gameState->nav;
+  NavSearchNode &nodeA = nav.search[nav.heap[a]];
+  NavSearchNode &nodeB = nav.search[nav.heap[b]];
+  return nodeA.f < nodeB.f || (nodeA.f == nodeB.f && nodeA.g > nodeB.g);
+}
+
+void nav_heap_up(int idx)
+{
+  while (idx > 0)
+  {
+    int parent = (idx - 1) / 2;
+    if (!nav_heap_less(idx, parent))
+    {
+      break;
+    }
+    nav_heap_swap(idx, parent);
+    idx = parent;
+  }
+}
+
+int nav_heap_pop()
+{
+  NavGraph &nav = gameState->nav;
+  int top = nav.heap[0];
+  nav.heapCount--;
+  if (nav.heapCount)
+  {
+    nav.heap[0] = nav.heap[nav.heapCount];
+    nav.search[nav.heap[0]].heapIndex = 0;
+
+    int idx = 0;
+    while (true)
+    {
+      int smallest = idx;
+      int left = idx * 2 + 1;
+      int right = idx * 2 + 2;
+      if (left < nav.heapCount && nav_heap_less(left, smallest))
+      {
+        smallest = left;
+      }
+      if (right < nav.heapCount && nav_heap_less(right, smallest))
+      {
+        smallest = right;
+      }
+      if (smallest == idx)
+      {
+        break;
+      }
+      nav_heap_swap(idx, smallest);
+      idx = smallest;
+    }
+  }
+  nav.search[top].heapIndex = -1;
+  return top;
+}
+
+//? Opens the node or lowers its cost if the new way there is shorter
+void nav_relax(int node, int parent, int g, IVec2 start, IVec2 goal)
+{
+  NavGraph &nav = gameState->nav;
+  NavSearchNode &searchNode = nav.search[node];
+
+  if (searchNode.stamp != nav.searchStamp)
+  {
+    IVec2 pos = nav_node_pos(node, start, goal);
+    searchNode.stamp = nav.searchStamp;
+    searchNode.g = g;
+    searchNode.f = g + (int)(NAV_HEURISTIC_WEIGHT * (abs(pos.x - goal.x) + abs(pos.y - goal.y)));
+    searchNode.parent = parent;
+    searchNode.heapIndex = nav.heapCount;
+    nav.heap[nav.heapCount++] = node;
+    nav_heap_up(searchNode.heapIndex);
+  }
+  else if (searchNode.heapIndex >= 0 && g < searchNode.g)
+  {
+    searchNode.f -= searchNode.g - g;
+    searchNode.g = g;
+    searchNode.parent = parent;
+    nav_heap_up(searchNode.heapIndex);
+  }
+}
+
+//? Path from start to goal (in tiles) as a list of waypoints
+NavPath nav_find_path(IVec2 start, IVec2 goal)
+{
+  NavGraph &nav = gameState->nav;
+  NavPath path = {};
+
+  if (is_solid(start.x, start.y) || is_solid(goal.x, goal.y))
+  {
+    return path;
+  }
+
+  nav_update();
+
+  // Distances from the start and the goal to the nodes of their clusters
+  IVec2 startCluster = nav_get_cluster(start.x, start.y);
+  IVec2 goalCluster = nav_get_cluster(goal.x, goal.y);
+  IRect startRect = nav_get_cluster_rect(startCluster);
+  IRect goalRect = nav_get_cluster_rect(goalCluster);
+
+  uint16_t startDistances[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+  uint16_t goalDistances[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+  nav_cluster_bfs(startRect, start, startDistances, nullptr);
+  nav_cluster_bfs(goalRect, goal, goalDistances, nullptr);
+
+  // Both in one cluster and connected inside of it
+  if (startCluster.x == goalCluster.x && startCluster.y == goalCluster.y)
+  {
+    uint16_t distance = startDistances[(goal.x - startRect.pos.x) + (goal.y - startRect.pos.y) * startRect.size.x];
+    if (distance != NAV_UNREACHABLE)
+    {
+      path.found = true;
+      path.cost = distance;
+      path.waypoints.add(start);
+      path.waypoints.add(goal);
+      return path;
+    }
+  }
+
+  // The search would visit every node it can reach before giving up
+  uint32_t startComponent = nav_tile_component(startCluster, startRect, startDistances);
+  if (!startComponent || startComponent != nav_tile_component(goalCluster, goalRect, goalDistances))
+  {
+    return path;
+  }
+
+  nav.searchStamp++;
+  nav.heapCount = 0;
+
+  nav_relax(NAV_START_NODE, -1, 0, start, goal);
+
+  while (nav.heapCount)
+  {
+    int node = nav_heap_pop();
+    int g = nav.search[node].g;
+
+    if (node == NAV_GOAL_NODE)
+    {
+      break;
+    }
+
+    if (node == NAV_START_NODE)
+    {
+      NavCluster &cluster = nav_cluster(startCluster);
+      for (int idx = 0; idx < cluster.nodeCount; idx++)
+      {
+        NavNode &next = cluster.nodes[idx];
+        uint16_t distance = startDistances[(next.x - startRect.pos.x) + (next.y - startRect.pos.y) * startRect.size.x];
+        if (distance != NAV_UNREACHABLE)
+        {
+          nav_relax(nav_node_id(startCluster, idx), node, g + distance, start, goal);
+        }
+      }
+      continue;
+    }
+
+    int clusterIdx = node / MAX_CLUSTER_NODES;
+    int nodeIdx = node % MAX_CLUSTER_NODES;
+    IVec2 clusterPos = {clusterIdx % NAV_CLUSTER_GRID.x, clusterIdx / NAV_CLUSTER_GRID.x};
+    NavCluster &cluster = nav_cluster(clusterPos);
+    NavNode &navNode = cluster.nodes[nodeIdx];
+
+    // Inside the cluster
+    for (int idx = 0; idx < cluster.nodeCount; idx++)
+    {
+      uint16_t distance = cluster.distances[nodeIdx][idx];
+      if (idx != nodeIdx && distance != NAV_UNREACHABLE)
+      {
+        nav_relax(nav_node_id(clusterPos, idx), node, g + distance, start, goal);
+      }
+    }
+
+    if (clusterPos.x == goalCluster.x && clusterPos.y == goalCluster.y)
+    {
+      uint16_t distance = goalDistances[(navNode.x - goalRect.pos.x) + (navNode.y - goalRect.pos.y) * goalRect.size.x];
+      if (distance != NAV_UNREACHABLE)
+      {
+        nav_relax(NAV_GOAL_NODE, node, g + distance, start, goal);
+      }
+    }
+
+    // Into the next cluster
+    for (int dir = 0; dir < 4; dir++)
+    {
+      int next = nav_linked_node(navNode, dir);
+      if (next >= 0)
+      {
+        nav_relax(next, node, g + 1, start, goal);
+      }
+    }
+  }
+
+  NavSearchNode &goalNode = nav.search[NAV_GOAL_NODE];
+  if (goalNode.stamp != nav.searchStamp || goalNode.heapIndex >= 0)
+  {
+    // A wall split the component, the next query can skip this again
+    nav_label_components();
+    return path;
+  }
+
+  // Walk back from the goal, then flip the order
+  path.found = true;
+  path.cost = goalNode.g;
+  for (int node = NAV_GOAL_NODE; node >= 0; node = nav.search[node].parent)
+  {
+    if (path.waypoints.is_full())
+    {
+      LOG_WARN("Path from %d, %d to %d, %d has more than %d waypoints", start.x, start.y, goal.x, goal.y, MAX_NAV_WAYPOINTS);
+      path.found = false;
+      return path;
+    }
+    path.waypoints.add(nav_node_pos(node, start, goal));
+  }
+  for (int idx = 0; idx < path.waypoints.count / 2; idx++)
+  {
+    IVec2 temp = path.waypoints[idx];
+    path.waypoints[idx] = path.waypoints[path.waypoints.count - 1 - idx];
+    path.waypoints[path.waypoints.count - 1 - idx] = temp;
+  }
+
+  return path;
+}
+
+//? Tiles to walk from one waypoint to the next (without from), returns how many were written
+int nav_refine_segment(IVec2 from, IVec2 to, IVec2 *steps, int maxSteps)
+{
+  // Crossing into the next cluster is a single step
+  if (abs(from.x - to.x) + abs(from.y - to.y) == 1)
+  {
+    if (maxSteps < 1)
+    {
+      return 0;
+    }
+    steps[0] = to;
+    return 1;
+  }
+
+  IRect rect = nav_get_cluster_rect(nav_get_cluster(from.x, from.y));
+  if (to.x < rect.pos.x || to.x >= rect.pos.x + rect.size.x ||
+      to.y < rect.pos.y || to.y >= rect.pos.y + rect.size.y)
+  {
+    return 0;
+  }
+
+  uint16_t distances[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+  uint16_t parents[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+  nav_cluster_bfs(rect, from, distances, parents);
+
+  int idx = (to.x - rect.pos.x) + (to.y - rect.pos.y) * rect.size.x;
+  int stepCount = distances[idx];
+  if (stepCount == NAV_UNREACHABLE || stepCount > maxSteps)
+  {
+    return 0;
+  }
+
+  for (int step = stepCount - 1; step >= 0; step--)
+  {
+    steps[step] = {rect.pos.x + idx % rect.size.x, rect.pos.y + idx / rect.size.x};
+    idx = parents[idx];
+  }
+  return stepCount;
+}
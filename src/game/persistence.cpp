@@ -0,0 +1,696 @@
+#include "game.h"
+
+// ################################     Persistence Functions   ################################
+// The world is stored chunk by chunk, first the tiles and then the walls. Each of
+// the two layers gets a palette of the materials it uses and then picks the smallest
+// of three encodings: a single material, palette indices packed into as few bits as
+// the palette needs, or runs of (length, index). Only materials are stored,
+// neighbourMasks are rebuilt on load. Tiles are visited row by row inside the chunk,
+// that is where the long runs are.
+//
+// Region file: a RegionHeader, a RegionEntry per chunk (row by row), then the
+// encoded chunks, each starting on a sector. The file is mapped, so loading a chunk
+// only touches its own pages. A save writes the modified chunks into free sectors
+// and only then points the table at them, a crash mid save leaves the old chunk
+// readable. Free sectors come from the table, so the sectors an old chunk used are
+// free from the next save on. When they run out, or the file holds something else,
+// the whole world goes into a new file that only replaces the old one once it is
+// complete
+
+// Byte streams
+ByteWriter make_byte_writer(BumpAllocator *allocator, int capacity)
+{
+  ByteWriter writer = {};
+  writer.data = (uint8_t *)bump_alloc(allocator, capacity);
+  writer.capacity = writer.data ? capacity : 0;
+  writer.overflow = !writer.data;
+  return writer;
+}
+
+ByteWriter make_byte_writer(uint8_t *buffer, int capacity)
+{
+  ByteWriter writer = {};
+  writer.data = buffer;
+  writer.capacity = capacity;
+  return writer;
+}
+
+void write_u8(ByteWriter &writer, uint8_t value)
+{
+  if (writer.size >= writer.capacity)
+  {
+    writer.overflow = true;
+    return;
+  }
+  writer.data[writer.size++] = value;
+}
+
+void write_bytes(ByteWriter &writer, uint8_t *bytes, int count)
+{
+  if (writer.size + count > writer.capacity)
+  {
+    writer.overflow = true;
+    return;
+  }
+  memcpy(writer.data + writer.size, bytes, count);
+  writer.size += count;
+}
+
+//? 7 bits per byte, the high bit says another byte follows
+void write_varint(ByteWriter &writer, uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    write_u8(writer, (uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  write_u8(writer, (uint8_t)value);
+}
+
+int varint_size(uint32_t value)
+{
+  int size = 1;
+  while (value >= 0x80)
+  {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+ByteReader make_byte_reader(uint8_t *data, int size)
+{
+  ByteReader reader = {};
+  reader.data = data;
+  reader.size = size;
+  return reader;
+}
+
+uint8_t read_u8(ByteReader &reader)
+{
+  if (reader.pos >= reader.size)
+  {
+    reader.error = true;
+    return 0;
+  }
+  return reader.data[reader.pos++];
+}
+
+uint32_t read_varint(ByteReader &reader)
+{
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t byte = read_u8(reader);
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+    {
+      return value;
+    }
+  }
+  reader.error = true;
+  return 0;
+}
+
+// Chunks
+//? Tiles of the chunk that are inside the world
+IRect get_chunk_tiles(IVec2 chunk)
+{
+  IRect rect = get_chunk_rect(chunk);
+  rect.size.x = min(rect.size.x, WORLD_GRID.x - rect.pos.x);
+  rect.size.y = min(rect.size.y, WORLD_GRID.y - rect.pos.y);
+  return rect;
+}
+
+//? Appends one layer of materials, tileCount of them row by row, to writer
+void encode_layer(ByteWriter &writer, uint8_t *materials, int tileCount)
+{
+  // Palette in order of first use
+  uint8_t paletteIndices[MATERIAL_COUNT];
+  memset(paletteIndices, 0xFF, sizeof(paletteIndices));
+  uint8_t palette[MATERIAL_COUNT];
+  int paletteCount = 0;
+
+  uint8_t indices[CHUNK_TILE_COUNT];
+  int runCount = 0;
+  int rleSize = 0;
+  for (int idx = 0; idx < tileCount; idx++)
+  {
+    uint8_t material = materials[idx];
+    if (paletteIndices[material] == 0xFF)
+    {
+      paletteIndices[material] = (uint8_t)paletteCount;
+      palette[paletteCount++] = material;
+    }
+    indices[idx] = paletteIndices[material];
+  }
+
+  if (paletteCount == 1)
+  {
+    write_u8(writer, CHUNK_ENCODING_UNIFORM);
+    write_u8(writer, palette[0]);
+    return;
+  }
+
+  // Size of both encodings, the smaller one is written
+  for (int idx = 0; idx < tileCount;)
+  {
+    int runEnd = idx + 1;
+    while (runEnd < tileCount && indices[runEnd] == indices[idx])
+    {
+      runEnd++;
+    }
+    rleSize += varint_size(runEnd - idx - 1) + 1;
+    runCount++;
+    idx = runEnd;
+  }
+
+  int bitsPerTile = 1;
+  while ((1 << bitsPerTile) < paletteCount)
+  {
+    bitsPerTile++;
+  }
+  int packedSize = (tileCount * bitsPerTile + 7) / 8;
+
+  ChunkEncoding encoding = rleSize < packedSize ? CHUNK_ENCODING_RLE : CHUNK_ENCODING_PACKED;
+  write_u8(writer, encoding);
+  write_u8(writer, (uint8_t)paletteCount);
+  write_bytes(writer, palette, paletteCount);
+
+  if (encoding == CHUNK_ENCODING_RLE)
+  {
+    for (int idx = 0; idx < tileCount;)
+    {
+      int runEnd = idx + 1;
+      while (runEnd < tileCount && indices[runEnd] == indices[idx])
+      {
+        runEnd++;
+      }
+      write_varint(writer, runEnd - idx - 1);
+      write_u8(writer, indices[idx]);
+      idx = runEnd;
+    }
+  }
+  else
+  {
+    // Low bits first
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (int idx = 0; idx < tileCount; idx++)
+    {
+      bits |= (uint32_t)indices[idx] << bitCount;
+      bitCount += bitsPerTile;
+      while (bitCount >= 8)
+      {
+        write_u8(writer, (uint8_t)bits);
+        bits >>= 8;
+        bitCount -= 8;
+      }
+    }
+    if (bitCount)
+    {
+      write_u8(writer, (uint8_t)bits);
+    }
+  }
+}
+
+//? Reads one layer written by encode_layer() into materials
+bool decode_layer(ByteReader &reader, uint8_t *materials, int tileCount)
+{
+  uint8_t indices[CHUNK_TILE_COUNT];
+
+  uint8_t encoding = read_u8(reader);
+  uint8_t palette[MATERIAL_COUNT];
+  int paletteCount = 1;
+
+  if (encoding == CHUNK_ENCODING_UNIFORM)
+  {
+    palette[0] = read_u8(reader);
+    memset(indices, 0, tileCount);
+  }
+  else if (encoding == CHUNK_ENCODING_PACKED || encoding == CHUNK_ENCODING_RLE)
+  {
+    paletteCount = read_u8(reader);
+    if (paletteCount < 2 || paletteCount > MATERIAL_COUNT)
+    {
+      reader.error = true;
+      return false;
+    }
+    for (int idx = 0; idx < paletteCount; idx++)
+    {
+      palette[idx] = read_u8(reader);
+    }
+
+    if (encoding == CHUNK_ENCODING_RLE)
+    {
+      for (int idx = 0; idx < tileCount && !reader.error;)
+      {
+        int runLength = read_varint(reader) + 1;
+        uint8_t index = read_u8(reader);
+        if (runLength > tileCount - idx)
+        {
+          reader.error = true;
+          break;
+        }
+        memset(indices + idx, index, runLength);
+        idx += runLength;
+      }
+    }
+    else
+    {
+      int bitsPerTile = 1;
+      while ((1 << bitsPerTile) < paletteCount)
+      {
+        bitsPerTile++;
+      }
+
+      uint32_t bits = 0;
+      int bitCount = 0;
+      uint32_t mask = (1 << bitsPerTile) - 1;
+      for (int idx = 0; idx < tileCount; idx++)
+      {
+        if (bitCount < bitsPerTile)
+        {
+          bits |= (uint32_t)read_u8(reader) << bitCount;
+          bitCount += 8;
+        }
+        indices[idx] = (uint8_t)(bits & mask);
+        bits >>= bitsPerTile;
+        bitCount -= bitsPerTile;
+      }
+    }
+  }
+  else
+  {
+    reader.error = true;
+  }
+
+  for (int idx = 0; idx < paletteCount; idx++)
+  {
+    if (palette[idx] >= MATERIAL_COUNT)
+    {
+      reader.error = true;
+    }
+  }
+  if (reader.error)
+  {
+    return false;
+  }
+
+  for (int idx = 0; idx < tileCount; idx++)
+  {
+    if (indices[idx] >= paletteCount)
+    {
+      reader.error = true;
+      return false;
+    }
+    materials[idx] = palette[indices[idx]];
+  }
+  return true;
+}
+
+//? Appends the tiles of the chunk and then its walls to writer
+void encode_chunk(ByteWriter &writer, IVec2 chunk)
+{
+  IRect rect = get_chunk_tiles(chunk);
+  uint8_t tiles[CHUNK_TILE_COUNT];
+  uint8_t walls[CHUNK_TILE_COUNT];
+  // The grids are stored column by column, so the columns are walked and the layers filled row by row
+  for (int x = 0; x < rect.size.x; x++)
+  {
+    for (int y = 0; y < rect.size.y; y++)
+    {
+      tiles[y * rect.size.x + x] = gameState->worldGrid[rect.pos.x + x][rect.pos.y + y].material;
+      walls[y * rect.size.x + x] = gameState->wallGrid[rect.pos.x + x][rect.pos.y + y];
+    }
+  }
+
+  encode_layer(writer, tiles, rect.size.x * rect.size.y);
+  encode_layer(writer, walls, rect.size.x * rect.size.y);
+}
+
+//? Reads one chunk written by encode_chunk() into layers. Nothing is set if the chunk is corrupted
+bool decode_chunk(ByteReader &reader, IVec2 chunk, WorldLayers &layers)
+{
+  IRect rect = get_chunk_tiles(chunk);
+  uint8_t tiles[CHUNK_TILE_COUNT];
+  uint8_t walls[CHUNK_TILE_COUNT];
+  if (!decode_layer(reader, tiles, rect.size.x * rect.size.y) ||
+      !decode_layer(reader, walls, rect.size.x * rect.size.y))
+  {
+    return false;
+  }
+
+  for (int x = 0; x < rect.size.x; x++)
+  {
+    for (int y = 0; y < rect.size.y; y++)
+    {
+      layers.tiles[rect.pos.x + x][rect.pos.y + y] = (MaterialID)tiles[y * rect.size.x + x];
+      layers.walls[rect.pos.x + x][rect.pos.y + y] = (MaterialID)walls[y * rect.size.x + x];
+    }
+  }
+  return true;
+}
+
+//? Replaces the world with the decoded layers, every chunk matches the file again
+void apply_world_layers(WorldLayers &layers)
+{
+  for (int x = 0; x < WORLD_GRID.x; x++)
+  {
+    for (int y = 0; y < WORLD_GRID.y; y++)
+    {
+      gameState->worldGrid[x][y].material = layers.tiles[x][y];
+    }
+  }
+  memcpy(gameState->wallGrid, layers.walls, sizeof(gameState->wallGrid));
+  memset(gameState->savedChunks, true, sizeof(gameState->savedChunks));
+}
+
+// Region files
+int region_sectors(int size)
+{
+  return (size + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE;
+}
+
+bool region_sector_used(RegionFile &region, int sector)
+{
+  return region.usedSectors[sector / 64] & (1ull << (sector % 64));
+}
+
+void region_mark_sectors(RegionFile &region, int firstSector, int count)
+{
+  for (int sector = firstSector; sector < firstSector + count; sector++)
+  {
+    region.usedSectors[sector / 64] |= 1ull << (sector % 64);
+  }
+}
+
+//? First fit, returns 0 if there is no run of count free sectors
+int region_alloc_sectors(RegionFile &region, int count)
+{
+  int runStart = REGION_TABLE_SECTORS;
+  for (int sector = REGION_TABLE_SECTORS; sector < REGION_MAX_SECTORS; sector++)
+  {
+    if (region_sector_used(region, sector))
+    {
+      runStart = sector + 1;
+      continue;
+    }
+    if (sector - runStart + 1 == count)
+    {
+      region_mark_sectors(region, runStart, count);
+      return runStart;
+    }
+  }
+  return 0;
+}
+
+//? Points header and table into the mapping, it moves when the file is resized
+void region_map_table(RegionFile &region)
+{
+  region.header = (RegionHeader *)region.file.data;
+  region.table = (RegionEntry *)(region.file.data + sizeof(RegionHeader));
+  region.sectorCount = (int)(region.file.size / REGION_SECTOR_SIZE);
+}
+
+//? Gives an empty file a header and a table without chunks
+bool region_reset(RegionFile &region)
+{
+  LOG_ASSERT(!region.file.size, "Only empty files are reset, a save is never truncated");
+  if (!resize_mapped_file(&region.file, REGION_TABLE_SECTORS * REGION_SECTOR_SIZE))
+  {
+    return false;
+  }
+  region_map_table(region);
+  *region.header = {WORLD_FILE_MAGIC, WORLD_GRID.x, WORLD_GRID.y, CHUNK_SIZE, REGION_SECTOR_SIZE, 0};
+
+  memset(region.usedSectors, 0, sizeof(region.usedSectors));
+  memset(gameState->savedChunks, 0, sizeof(gameState->savedChunks));
+  return true;
+}
+
+//? Maps the region file and checks it belongs to this world. Writable files are
+//? created, a file that holds something else is left as it is
+bool region_open(RegionFile &region, const char *filePath, bool writable)
+{
+  memset(region.usedSectors, 0, sizeof(region.usedSectors));
+  if (!map_file(filePath, writable, &region.file))
+  {
+    return false;
+  }
+  region_map_table(region);
+
+  RegionHeader &header = *region.header;
+  bool valid = region.sectorCount >= REGION_TABLE_SECTORS && region.sectorCount <= REGION_MAX_SECTORS &&
+               header.magic == WORLD_FILE_MAGIC && header.width == WORLD_GRID.x && header.height == WORLD_GRID.y &&
+               header.chunkSize == CHUNK_SIZE && header.sectorSize == REGION_SECTOR_SIZE;
+  for (int idx = 0; idx < CHUNK_COUNT && valid; idx++)
+  {
+    RegionEntry entry = region.table[idx];
+    if (!entry.sector)
+    {
+      continue;
+    }
+    valid = entry.sector >= REGION_TABLE_SECTORS && entry.sector < (uint32_t)region.sectorCount &&
+            entry.size > 0 && entry.size <= MAX_ENCODED_CHUNK_SIZE &&
+            (int)entry.sector + region_sectors((int)entry.size) <= region.sectorCount;
+    if (valid)
+    {
+      region_mark_sectors(region, entry.sector, region_sectors(entry.size));
+    }
+  }
+
+  if (valid || (writable && !region.file.size && region_reset(region)))
+  {
+    return true;
+  }
+  if (writable)
+  {
+    LOG_WARN("%s is not a world file for a %dx%d world", filePath, WORLD_GRID.x, WORLD_GRID.y);
+  }
+  else
+  {
+    LOG_ERROR("%s is not a world file for a %dx%d world", filePath, WORLD_GRID.x, WORLD_GRID.y);
+  }
+  unmap_file(&region.file);
+  return false;
+}
+
+//? Decodes one chunk into the worldGrid, only the pages of the chunk are read
+bool region_read_chunk(RegionFile &region, IVec2 chunk, WorldLayers &layers)
+{
+  RegionEntry entry = region.table[chunk.y * CHUNK_GRID.x + chunk.x];
+  if (!entry.sector)
+  {
+    return false;
+  }
+
+  ByteReader reader = make_byte_reader((uint8_t *)region.file.data + (long long)entry.sector * REGION_SECTOR_SIZE,
+                                       entry.size);
+  return decode_chunk(reader, chunk, layers) && reader.pos == reader.size;
+}
+
+//? Encodes the chunks that changed since the last save and finds free sectors for
+//? them, returns -1 if the sectors ran out. The file is not touched yet
+int region_place_chunks(RegionFile &region, RegionWrite *writes, ByteWriter &writer)
+{
+  int writeCount = 0;
+  writer.size = 0;
+  for (int chunkY = 0; chunkY < CHUNK_GRID.y; chunkY++)
+  {
+    for (int chunkX = 0; chunkX < CHUNK_GRID.x; chunkX++)
+    {
+      if (gameState->savedChunks[chunkX][chunkY])
+      {
+        continue;
+      }
+
+      RegionWrite &write = writes[writeCount++];
+      write.chunk = {chunkX, chunkY};
+      write.offset = writer.size;
+      encode_chunk(writer, write.chunk);
+      write.size = writer.size - write.offset;
+
+      // The sectors of the saved chunk stay untouched until the table moved on
+      write.sector = region_alloc_sectors(region, region_sectors(write.size));
+      if (!write.sector)
+      {
+        return -1;
+      }
+    }
+  }
+  return writeCount;
+}
+
+//? Copies the placed chunks into the file, then points the table at them
+bool region_commit_chunks(RegionFile &region, RegionWrite *writes, int writeCount, ByteWriter &writer)
+{
+  int sectorCount = region.sectorCount;
+  for (int idx = 0; idx < writeCount; idx++)
+  {
+    sectorCount = max(sectorCount, writes[idx].sector + region_sectors(writes[idx].size));
+  }
+  if (sectorCount > region.sectorCount)
+  {
+    if (!resize_mapped_file(&region.file, (long long)sectorCount * REGION_SECTOR_SIZE))
+    {
+      return false;
+    }
+    region_map_table(region);
+  }
+
+  for (int idx = 0; idx < writeCount; idx++)
+  {
+    RegionWrite &write = writes[idx];
+    memcpy(region.file.data + (long long)write.sector * REGION_SECTOR_SIZE, writer.data + write.offset, write.size);
+  }
+
+  long long tableSize = REGION_TABLE_SECTORS * REGION_SECTOR_SIZE;
+  if (REGION_SYNC_POLICY == REGION_SYNC_ORDERED)
+  {
+    flush_mapped_file(&region.file, tableSize, region.file.size - tableSize);
+  }
+
+  for (int idx = 0; idx < writeCount; idx++)
+  {
+    RegionWrite &write = writes[idx];
+    region.table[write.chunk.y * CHUNK_GRID.x + write.chunk.x] = {(uint32_t)write.sector, (uint32_t)write.size};
+    gameState->savedChunks[write.chunk.x][write.chunk.y] = true;
+  }
+
+  if (REGION_SYNC_POLICY == REGION_SYNC_ORDERED)
+  {
+    flush_mapped_file(&region.file, 0, tableSize);
+  }
+  else if (REGION_SYNC_POLICY == REGION_SYNC_ON_SAVE)
+  {
+    flush_mapped_file(&region.file, 0, region.file.size);
+  }
+  return true;
+}
+
+//? Writes every chunk into a new file next to filePath, packed tightly, and then
+//? moves it over filePath. A crash before that leaves the old save as it was
+bool region_rewrite(const char *filePath, RegionWrite *writes, ByteWriter &writer)
+{
+  char newFilePath[512];
+  snprintf(newFilePath, sizeof(newFilePath), "%s.new", filePath);
+  remove(newFilePath);
+
+  RegionFile region;
+  if (!region_open(region, newFilePath, true))
+  {
+    return false;
+  }
+
+  memset(gameState->savedChunks, 0, sizeof(gameState->savedChunks));
+  int writeCount = region_place_chunks(region, writes, writer);
+  bool written = writeCount >= 0 && region_commit_chunks(region, writes, writeCount, writer);
+  if (written)
+  {
+    // Every byte is on disk before the file takes the place of the old one
+    flush_mapped_file(&region.file, 0, region.file.size);
+    LOG_INFO("Saved world to %s from scratch, %lld bytes", filePath, region.file.size);
+  }
+  unmap_file(&region.file);
+
+  if (!written || !replace_file(newFilePath, filePath))
+  {
+    // The chunks marked as saved only went into the new file
+    memset(gameState->savedChunks, 0, sizeof(gameState->savedChunks));
+    remove(newFilePath);
+    return false;
+  }
+  return true;
+}
+
+// World files
+bool save_world(const char *filePath)
+{
+  RegionWrite *writes = (RegionWrite *)bump_alloc(gameState->transientStorage, CHUNK_COUNT * sizeof(RegionWrite));
+  ByteWriter writer = make_byte_writer(gameState->transientStorage, CHUNK_COUNT * MAX_ENCODED_CHUNK_SIZE);
+  if (!writes || writer.overflow)
+  {
+    LOG_ERROR("Failed saving world to %s, out of transient memory", filePath);
+    return false;
+  }
+
+  RegionFile region;
+  bool saved = false;
+  if (region_open(region, filePath, true))
+  {
+    int writeCount = region_place_chunks(region, writes, writer);
+    saved = writeCount >= 0 && region_commit_chunks(region, writes, writeCount, writer);
+    if (saved)
+    {
+      LOG_INFO("Saved world to %s, wrote %d of %d chunks, %lld bytes", filePath, writeCount, CHUNK_COUNT, region.file.size);
+    }
+    else if (writeCount < 0)
+    {
+      LOG_WARN("%s has no room left between its chunks", filePath);
+    }
+    unmap_file(&region.file);
+  }
+
+  // The sectors ran out or the file holds something else, nothing in it was touched
+  if (!saved && file_exists(filePath))
+  {
+    saved = region_rewrite(filePath, writes, writer);
+  }
+  if (!saved)
+  {
+    LOG_ERROR("Failed saving world to %s", filePath);
+  }
+  return saved;
+}
+
+bool load_world(const char *filePath)
+{
+  if (!file_exists(filePath))
+  {
+    LOG_ERROR("No world file at %s", filePath);
+    return false;
+  }
+
+  WorldLayers *layers = (WorldLayers *)bump_alloc(gameState->transientStorage, sizeof(WorldLayers));
+  if (!layers)
+  {
+    LOG_ERROR("Failed loading world from %s, out of transient memory", filePath);
+    return false;
+  }
+
+  RegionFile region;
+  if (!region_open(region, filePath, false))
+  {
+    return false;
+  }
+
+  bool loaded = true;
+  for (int idx = 0; idx < CHUNK_COUNT && loaded; idx++)
+  {
+    IVec2 chunk = {idx % CHUNK_GRID.x, idx / CHUNK_GRID.x};
+    loaded = region_read_chunk(region, chunk, *layers);
+    if (!loaded)
+    {
+      LOG_ERROR("Chunk %d, %d in %s is corrupted, the world is left as it was", chunk.x, chunk.y, filePath);
+    }
+
+    // The layers hold the chunk now, the file pages are not needed anymore
+    if ((idx + 1) % REGION_RELEASE_CHUNKS == 0)
+    {
+      release_mapped_pages(&region.file, 0, region.file.size);
+    }
+  }
+  unmap_file(&region.file);
+
+  // A half loaded world would be saved over the file as if it was the whole one
+  if (!loaded)
+  {
+    return false;
+  }
+
+  apply_world_layers(*layers);
+  refresh_world();
+  LOG_INFO("Loaded world from %s", filePath);
+  return true;
+}
@@ -0,0 +1,196 @@
+#include "game.h"
+
+#include <chrono>
+#include <xmmintrin.h>
+
+// ################################     Projectile Functions   ################################
+// Bullets and thrown picks move several tiles per tick, so they are never only
+// tested where they end up. The segment a projectile travels in a tick is cast
+// through the occupancy bitmap with raycast() and tested against the boxes of
+// the ECS colliders, and the projectile stops at whichever it reaches first. The
+// broadphase keeps the colliders sorted by minX, so the first box a segment can
+// reach is looked up by the column of pixels it starts in. From there the slab
+// test runs on four boxes at a time, on copies of their bounds in one array per
+// bound
+
+static const float PROJECTILE_NEVER = 1e30f; // Inverse of a speed of 0
+
+//? Adds a projectile, returns false if the pool is full
+bool projectile_spawn(Vec2 pos, Vec2 vel, float gravity, float life, float damage, uint32_t owner)
+{
+  ProjectilePool &pool = gameState->projectiles;
+  if (pool.live.is_full())
+  {
+    return false;
+  }
+  pool.live.add({pos, vel, gravity, life, damage, owner});
+  return true;
+}
+
+//? Copies the collider boxes of this tick, the broadphase already sorted them
+void projectile_collect_targets(ecs::BroadphaseSystem &broadphase)
+{
+  ProjectilePool &pool = gameState->projectiles;
+  int count = (int)broadphase.entries.size();
+
+  // One block for all five arrays, the bounds get the padding
+  int boundSize = (count + 4) * sizeof(float);
+  char *memory = bump_alloc(gameState->transientStorage, 4 * boundSize + count * sizeof(uint32_t));
+  if (!memory)
+  {
+    LOG_ERROR("No memory for %d projectile targets, projectiles only hit tiles this tick", count);
+    pool.targetCount = 0;
+    return;
+  }
+  pool.targetMinX = (float *)memory;
+  pool.targetMaxX = (float *)(memory + boundSize);
+  pool.targetMinY = (float *)(memory + 2 * boundSize);
+  pool.targetMaxY = (float *)(memory + 3 * boundSize);
+  pool.targets = (uint32_t *)(memory + 4 * boundSize);
+
+  float maxWidth = 0.0f;
+  for (int idx = 0; idx < count; idx++)
+  {
+    ecs::BroadphaseSystem::SweepEntry &entry = broadphase.entries[idx];
+    pool.targetMinX[idx] = entry.minX;
+    pool.targetMaxX[idx] = entry.maxX;
+    pool.targetMinY[idx] = entry.minY;
+    pool.targetMaxY[idx] = entry.maxY;
+    pool.targets[idx] = entry.e;
+    maxWidth = max(maxWidth, entry.maxX - entry.minX);
+  }
+
+  // No box is wider than maxWidth, so none starting further left than that reaches the column
+  int first = 0;
+  for (int column = 0; column < PROJECTILE_COLUMN_COUNT; column++)
+  {
+    float reach = column * PROJECTILE_COLUMN_SIZE - maxWidth;
+    while (first < count && pool.targetMinX[first] < reach)
+    {
+      first++;
+    }
+    pool.columnFirst[column] = first;
+  }
+
+  // Read by the last group of four, the lanes past count are thrown away
+  for (int idx = count; idx < count + 4; idx++)
+  {
+    pool.targetMinX[idx] = INFINITY;
+    pool.targetMaxX[idx] = INFINITY;
+    pool.targetMinY[idx] = INFINITY;
+    pool.targetMaxY[idx] = INFINITY;
+  }
+  pool.targetCount = count;
+}
+
+//? First target box the segment start + delta * t enters for a t below tHit, skipping
+//? the owner. Returns its index and lowers tHit to where it was entered, -1 for none
+int projectile_find_target(Vec2 start, Vec2 delta, uint32_t owner, float &tHit)
+{
+  ProjectilePool &pool = gameState->projectiles;
+  float segmentMinX = min(start.x, start.x + delta.x);
+  float segmentMaxX = max(start.x, start.x + delta.x);
+
+  int column = min(max((int)segmentMinX / PROJECTILE_COLUMN_SIZE, 0), PROJECTILE_COLUMN_COUNT - 1);
+  int first = pool.columnFirst[column];
+
+  __m128 originX = _mm_set1_ps(start.x);
+  __m128 originY = _mm_set1_ps(start.y);
+  __m128 invX = _mm_set1_ps(delta.x != 0.0f ? 1.0f / delta.x : PROJECTILE_NEVER);
+  __m128 invY = _mm_set1_ps(delta.y != 0.0f ? 1.0f / delta.y : PROJECTILE_NEVER);
+  __m128 zero = _mm_setzero_ps();
+
+  int result = -1;
+  for (int idx = first; idx < pool.targetCount && pool.targetMinX[idx] <= segmentMaxX; idx += 4)
+  {
+    // Where the segment crosses the sides of each box, entering and leaving
+    __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pool.targetMinX[idx]), originX), invX);
+    __m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pool.targetMaxX[idx]), originX), invX);
+    __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pool.targetMinY[idx]), originY), invY);
+    __m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pool.targetMaxY[idx]), originY), invY);
+    __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), zero);
+    __m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_set1_ps(tHit));
+    int mask = _mm_movemask_ps(_mm_cmple_ps(enter, leave));
+    pool.boxTests += 4;
+    if (!mask)
+    {
+      continue;
+    }
+
+    float enters[4];
+    _mm_storeu_ps(enters, enter);
+    while (mask)
+    {
+      int lane = __builtin_ctz(mask);
+      mask &= mask - 1;
+      int target = idx + lane;
+      if (target >= pool.targetCount || pool.targetMinX[target] > segmentMaxX)
+      {
+        break;
+      }
+      if (pool.targets[target] != owner && enters[lane] < tHit)
+      {
+        tHit = enters[lane];
+        result = target;
+      }
+    }
+  }
+  return result;
+}
+
+//? Moves every projectile along this tick's segment, it stops at the first tile or collider on the way
+void projectiles_update(ecs::BroadphaseSystem &broadphase, float dt)
+{
+  ProjectilePool &pool = gameState->projectiles;
+  pool.hits.clear();
+  pool.tileHits = 0;
+  pool.boxTests = 0;
+  if (!pool.live.count)
+  {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  projectile_collect_targets(broadphase);
+
+  for (int idx = 0; idx < pool.live.count; idx++)
+  {
+    Projectile &projectile = pool.live[idx];
+    projectile.vel.y += projectile.gravity * dt;
+    projectile.life -= dt;
+    Vec2 delta = projectile.vel * dt;
+
+    // Both tests measure along the segment, 0 at its start and 1 at its end
+    Ray ray = {projectile.pos / (float)TILESIZE, delta / (float)TILESIZE, 1.0f};
+    RayHit tileHit = raycast(ray);
+    float tHit = tileHit.hit ? tileHit.distance : 1.0f;
+    int target = pool.targetCount ? projectile_find_target(projectile.pos, delta, projectile.owner, tHit) : -1;
+    projectile.pos = projectile.pos + delta * tHit;
+
+    if (target != -1)
+    {
+      if (!pool.hits.is_full())
+      {
+        pool.hits.add({pool.targets[target], projectile.pos, projectile.damage});
+      }
+      particle_burst(projectile.pos, 12, 90.0f, 0.6f, BLOOD_COLOR);
+    }
+    else if (tileHit.hit)
+    {
+      damage_tile(tileHit.tile.x, tileHit.tile.y, projectile.damage);
+      particle_burst(projectile.pos, 8, 150.0f, 0.4f, SPARK_COLOR);
+      pool.tileHits++;
+    }
+
+    // The projectile swapped in has to be moved too
+    if (target != -1 || tileHit.hit || projectile.life <= 0.0f)
+    {
+      pool.live.remove_idx_and_swap(idx);
+      idx--;
+    }
+  }
+
+  pool.updateMs = std::chrono::duration<float, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+}
@@ -0,0 +1,161 @@
+#include "game.h"
+
+// ################################     Raycast Functions   ################################
+// Rays walk the occupancy bitmap tile by tile (Amanatides & Woo), the same walk for
+// line of sight, bullets, lasers and light. Empty 8x8 blocks and 64x64 areas
+// (levels of the occupancy mips) are crossed in a single step by working out which
+// side the ray leaves them through. Rays that leave the world or run past
+// maxDistance miss
+
+static const float RAY_NEVER = 1e30f; // Border distance of an axis the ray doesn't move along
+
+//? The ray clipped to the world, returns false if it misses the world
+bool raycast_clip(Ray ray, float &tStart, float &tEnd, IVec2 &normal)
+{
+  float origin[2] = {ray.origin.x, ray.origin.y};
+  float dir[2] = {ray.dir.x, ray.dir.y};
+  int size[2] = {WORLD_GRID.x, WORLD_GRID.y};
+
+  tStart = 0.0f;
+  tEnd = ray.maxDistance;
+  normal = {};
+  for (int axis = 0; axis < 2; axis++)
+  {
+    if (dir[axis] == 0.0f)
+    {
+      if (origin[axis] < 0.0f || origin[axis] >= size[axis])
+      {
+        return false;
+      }
+      continue;
+    }
+
+    float tNear = (0.0f - origin[axis]) / dir[axis];
+    float tFar = (size[axis] - origin[axis]) / dir[axis];
+    if (tNear > tFar)
+    {
+      float temp = tNear;
+      tNear = tFar;
+      tFar = temp;
+    }
+    if (tNear > tStart)
+    {
+      tStart = tNear;
+      normal = axis == 0 ? IVec2{dir[axis] > 0.0f ? -1 : 1, 0} : IVec2{0, dir[axis] > 0.0f ? -1 : 1};
+    }
+    tEnd = min(tEnd, tFar);
+  }
+  return tStart <= tEnd;
+}
+
+RayHit raycast(Ray ray)
+{
+  RayHit result = {};
+  float t, tEnd;
+  IVec2 normal;
+  if (!raycast_clip(ray, t, tEnd, normal))
+  {
+    return result;
+  }
+
+  // Inside the world after clipping, so truncating is flooring
+  int x = min(max((int)(ray.origin.x + ray.dir.x * t), 0), WORLD_GRID.x - 1);
+  int y = min(max((int)(ray.origin.y + ray.dir.y * t), 0), WORLD_GRID.y - 1);
+  int stepX = ray.dir.x > 0.0f ? 1 : -1;
+  int stepY = ray.dir.y > 0.0f ? 1 : -1;
+
+  // Distance along the ray to the border a tile is left through is
+  // (border - origin) * invDir. It is worked out from the tile every time instead
+  // of adding up steps, so skipping a block lands on the same numbers
+  float invX = ray.dir.x != 0.0f ? 1.0f / ray.dir.x : 0.0f;
+  float invY = ray.dir.y != 0.0f ? 1.0f / ray.dir.y : 0.0f;
+  float offsetX = (stepX > 0 ? 1.0f : 0.0f) - ray.origin.x;
+  float offsetY = (stepY > 0 ? 1.0f : 0.0f) - ray.origin.y;
+  float tMaxX = ray.dir.x != 0.0f ? (x + offsetX) * invX : RAY_NEVER;
+  float tMaxY = ray.dir.y != 0.0f ? (y + offsetY) * invY : RAY_NEVER;
+
+  OccupancyMap &occupancy = gameState->occupancy;
+  while (t <= tEnd)
+  {
+    // Biggest empty square around the tile, if there is one
+    int skipSize = 0;
+    if (occupancy_mip(OCCUPANCY_AREA_LEVEL, x >> OCCUPANCY_AREA_LEVEL, y >> OCCUPANCY_AREA_LEVEL) == OCCUPANCY_EMPTY)
+    {
+      skipSize = 1 << OCCUPANCY_AREA_LEVEL;
+    }
+    else if (occupancy_mip(OCCUPANCY_BLOCK_LEVEL, x >> OCCUPANCY_BLOCK_LEVEL, y >> OCCUPANCY_BLOCK_LEVEL) == OCCUPANCY_EMPTY)
+    {
+      skipSize = 1 << OCCUPANCY_BLOCK_LEVEL;
+    }
+
+    if (skipSize)
+    {
+      // Last tile of the square on each axis, the ray leaves through the nearer one
+      int minX = x & ~(skipSize - 1);
+      int minY = y & ~(skipSize - 1);
+      int lastX = stepX > 0 ? minX + skipSize - 1 : minX;
+      int lastY = stepY > 0 ? minY + skipSize - 1 : minY;
+      float exitX = ray.dir.x != 0.0f ? (lastX + offsetX) * invX : RAY_NEVER;
+      float exitY = ray.dir.y != 0.0f ? (lastY + offsetY) * invY : RAY_NEVER;
+
+      if (exitX <= exitY)
+      {
+        t = exitX;
+        x = lastX + stepX;
+        y = min(max((int)(ray.origin.y + ray.dir.y * t), minY), minY + skipSize - 1);
+        normal = {-stepX, 0};
+      }
+      else
+      {
+        t = exitY;
+        y = lastY + stepY;
+        x = min(max((int)(ray.origin.x + ray.dir.x * t), minX), minX + skipSize - 1);
+        normal = {0, -stepY};
+      }
+      tMaxX = ray.dir.x != 0.0f ? (x + offsetX) * invX : RAY_NEVER;
+      tMaxY = ray.dir.y != 0.0f ? (y + offsetY) * invY : RAY_NEVER;
+    }
+    else
+    {
+      // Same test as is_solid(), x and y are known to be inside the world
+      if ((occupancy.rows[y][x / 64] >> (x % 64)) & 1)
+      {
+        result.hit = true;
+        result.tile = {x, y};
+        result.normal = normal;
+        result.distance = t;
+        return result;
+      }
+
+      if (tMaxX < tMaxY)
+      {
+        t = tMaxX;
+        x += stepX;
+        tMaxX = (x + offsetX) * invX;
+        normal = {-stepX, 0};
+      }
+      else
+      {
+        t = tMaxY;
+        y += stepY;
+        tMaxY = (y + offsetY) * invY;
+        normal = {0, -stepY};
+      }
+    }
+
+    if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+    {
+      break;
+    }
+  }
+  return result;
+}
+
+//? Casts count rays, hits[idx] belongs to rays[idx]
+void raycast_batch(Ray *rays, RayHit *hits, int count)
+{
+  for (int idx = 0; idx < count; idx++)
+  {
+    hits[idx] = raycast(rays[idx]);
+  }
+}
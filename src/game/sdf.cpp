@@ -0,0 +1,247 @@
+#include "game.h"
+
+#include <chrono>
+
+// ################################     Distance Field Functions   ################################
+// Clearance around every tile for steering, particle collision and soft shadows.
+// A region is recomputed from a window reaching SDF_MAX_DISTANCE past it with an
+// exact euclidean distance transform in two passes, one down the columns and one
+// along the rows (Felzenszwalb & Huttenlocher). Distances are clamped to
+// SDF_MAX_DISTANCE, so an edit only dirties the regions within that radius and
+// those are recomputed a few per tick. Queries read whatever is stored, a dirty
+// region answers with its old distances until its turn comes
+
+static const float SDF_FAR = 1e20f; // Squared distance of "no tile in the window"
+
+//? Squared distance to the nearest 0 of a line of squared distances, in place
+void sdf_transform_line(float *line, int count)
+{
+  int parabolas[SDF_WINDOW];
+  float bounds[SDF_WINDOW + 1];
+  float result[SDF_WINDOW];
+
+  // Lower envelope of the parabolas rooted at every cell, bounds[k] is where
+  // parabola k starts to be the lowest. Far cells lose against every near one
+  int k = 0;
+  parabolas[0] = 0;
+  bounds[0] = -SDF_FAR;
+  bounds[1] = SDF_FAR;
+  for (int q = 1; q < count; q++)
+  {
+    int v = parabolas[k];
+    float s = ((line[q] + q * q) - (line[v] + v * v)) / (2.0f * (q - v));
+    while (s <= bounds[k])
+    {
+      k--;
+      v = parabolas[k];
+      s = ((line[q] + q * q) - (line[v] + v * v)) / (2.0f * (q - v));
+    }
+    k++;
+    parabolas[k] = q;
+    bounds[k] = s;
+    bounds[k + 1] = SDF_FAR;
+  }
+
+  k = 0;
+  for (int q = 0; q < count; q++)
+  {
+    while (bounds[k + 1] < q)
+    {
+      k++;
+    }
+    int v = parabolas[k];
+    result[q] = (q - v) * (q - v) + line[v];
+  }
+  memcpy(line, result, count * sizeof(float));
+}
+
+//? Both passes over a window of squared distances
+void sdf_transform_window(float (&window)[SDF_WINDOW][SDF_WINDOW])
+{
+  for (int x = 0; x < SDF_WINDOW; x++)
+  {
+    sdf_transform_line(window[x], SDF_WINDOW);
+  }
+
+  float row[SDF_WINDOW];
+  for (int y = 0; y < SDF_WINDOW; y++)
+  {
+    for (int x = 0; x < SDF_WINDOW; x++)
+    {
+      row[x] = window[x][y];
+    }
+    sdf_transform_line(row, SDF_WINDOW);
+    for (int x = 0; x < SDF_WINDOW; x++)
+    {
+      window[x][y] = row[x];
+    }
+  }
+}
+
+void sdf_build_region(IVec2 regionPos)
+{
+  DistanceField &sdf = gameState->sdf;
+  int originX = regionPos.x * SDF_REGION_SIZE - SDF_MAX_DISTANCE;
+  int originY = regionPos.y * SDF_REGION_SIZE - SDF_MAX_DISTANCE;
+
+  int solidCount = 0;
+  for (int x = 0; x < SDF_WINDOW; x++)
+  {
+    for (int y = 0; y < SDF_WINDOW; y++)
+    {
+      bool solid = is_solid(originX + x, originY + y);
+      sdf.toSolid[x][y] = solid ? 0.0f : SDF_FAR;
+      sdf.toAir[x][y] = solid ? SDF_FAR : 0.0f;
+      solidCount += solid;
+    }
+  }
+
+  // Open sky and deep rock are as far from the surface as it gets
+  SdfRegion &region = sdf.regions[regionPos.x][regionPos.y];
+  if (!solidCount || solidCount == SDF_WINDOW * SDF_WINDOW)
+  {
+    memset(region.distances, (int8_t)((solidCount ? -SDF_MAX_DISTANCE : SDF_MAX_DISTANCE) * SDF_SCALE),
+           sizeof(region.distances));
+    return;
+  }
+
+  sdf_transform_window(sdf.toSolid);
+  sdf_transform_window(sdf.toAir);
+
+  for (int x = 0; x < SDF_REGION_SIZE; x++)
+  {
+    for (int y = 0; y < SDF_REGION_SIZE; y++)
+    {
+      int windowX = x + SDF_MAX_DISTANCE;
+      int windowY = y + SDF_MAX_DISTANCE;
+      float distance = sdf.toAir[windowX][windowY] > 0.0f
+                           ? -(sqrtf(sdf.toAir[windowX][windowY]) - 0.5f)
+                           : sqrtf(sdf.toSolid[windowX][windowY]) - 0.5f;
+      distance = min(max(distance, (float)-SDF_MAX_DISTANCE), (float)SDF_MAX_DISTANCE);
+      region.distances[x][y] = (int8_t)roundf(distance * SDF_SCALE);
+    }
+  }
+}
+
+void sdf_mark_dirty(int regionX, int regionY)
+{
+  DistanceField &sdf = gameState->sdf;
+  if (!sdf.dirty[regionX][regionY])
+  {
+    sdf.dirty[regionX][regionY] = true;
+    sdf.dirtyRegions.add({regionX, regionY});
+  }
+}
+
+void sdf_on_tile_changed(int x, int y, MaterialID oldMaterial, MaterialID newMaterial)
+{
+  if ((oldMaterial == MATERIAL_AIR) == (newMaterial == MATERIAL_AIR))
+  {
+    return;
+  }
+
+  int minX = max(x - SDF_MAX_DISTANCE, 0) / SDF_REGION_SIZE;
+  int minY = max(y - SDF_MAX_DISTANCE, 0) / SDF_REGION_SIZE;
+  int maxX = min(x + SDF_MAX_DISTANCE, WORLD_GRID.x - 1) / SDF_REGION_SIZE;
+  int maxY = min(y + SDF_MAX_DISTANCE, WORLD_GRID.y - 1) / SDF_REGION_SIZE;
+  for (int regionX = minX; regionX <= maxX; regionX++)
+  {
+    for (int regionY = minY; regionY <= maxY; regionY++)
+    {
+      sdf_mark_dirty(regionX, regionY);
+    }
+  }
+}
+
+//? Builds everything the first time, afterwards at most SDF_BUDGET dirty regions
+void sdf_update()
+{
+  DistanceField &sdf = gameState->sdf;
+  if (sdf.initialized && !sdf.dirtyRegions.count)
+  {
+    sdf.rebuiltRegions = 0;
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int rebuilt = 0;
+
+  if (!sdf.initialized)
+  {
+    for (int regionX = 0; regionX < SDF_REGION_GRID.x; regionX++)
+    {
+      for (int regionY = 0; regionY < SDF_REGION_GRID.y; regionY++)
+      {
+        sdf_build_region({regionX, regionY});
+        sdf.dirty[regionX][regionY] = false;
+        rebuilt++;
+      }
+    }
+    sdf.dirtyRegions.clear();
+    sdf.initialized = true;
+  }
+  else
+  {
+    while (sdf.dirtyRegions.count && rebuilt < SDF_BUDGET)
+    {
+      int last = sdf.dirtyRegions.count - 1;
+      IVec2 regionPos = sdf.dirtyRegions[last];
+      sdf.dirtyRegions.remove_idx_and_swap(last);
+
+      sdf_build_region(regionPos);
+      sdf.dirty[regionPos.x][regionPos.y] = false;
+      rebuilt++;
+    }
+  }
+
+  sdf.rebuiltRegions = rebuilt;
+  sdf.updateMs = std::chrono::duration<float, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+}
+
+// Queries
+//? Distance at the centre of the tile, in tiles
+float sdf_get(int x, int y)
+{
+  if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+  {
+    return (float)-SDF_MAX_DISTANCE;
+  }
+
+  SdfRegion &region = gameState->sdf.regions[x / SDF_REGION_SIZE][y / SDF_REGION_SIZE];
+  return region.distances[x % SDF_REGION_SIZE][y % SDF_REGION_SIZE] * (1.0f / SDF_SCALE);
+}
+
+//? Distance at pos (in tiles), blended between the four nearest tile centres
+float sdf_sample(Vec2 pos)
+{
+  float fx = pos.x - 0.5f;
+  float fy = pos.y - 0.5f;
+  int x = (int)floorf(fx);
+  int y = (int)floorf(fy);
+  fx -= x;
+  fy -= y;
+
+  float top = lerp(sdf_get(x, y), sdf_get(x + 1, y), fx);
+  float bottom = lerp(sdf_get(x, y + 1), sdf_get(x + 1, y + 1), fx);
+  return lerp(top, bottom, fy);
+}
+
+//? Slope of sdf_sample() at pos, points away from the nearest solid tile
+Vec2 sdf_gradient(Vec2 pos)
+{
+  float fx = pos.x - 0.5f;
+  float fy = pos.y - 0.5f;
+  int x = (int)floorf(fx);
+  int y = (int)floorf(fy);
+  fx -= x;
+  fy -= y;
+
+  float topLeft = sdf_get(x, y);
+  float topRight = sdf_get(x + 1, y);
+  float bottomLeft = sdf_get(x, y + 1);
+  float bottomRight = sdf_get(x + 1, y + 1);
+  return {lerp(topRight - topLeft, bottomRight - bottomLeft, fy),
+          lerp(bottomLeft - topLeft, bottomRight - topRight, fx)};
+}
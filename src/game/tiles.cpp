@@ -0,0 +1,529 @@
+#include "game.h"
+
+// ################################     Tile Functions   ################################
+
+// Grid system
+IVec2 get_grid_pos(IVec2 worldPos)
+{
+  return {worldPos.x / TILESIZE, worldPos.y / TILESIZE};
+}
+
+// tile system
+Tile *get_tile(int x, int y)
+{
+  Tile *tile = nullptr;
+
+  if (x >= 0 && x < WORLD_GRID.x && y >= 0 && y < WORLD_GRID.y)
+  {
+    tile = &gameState->worldGrid[x][y];
+  }
+
+  return tile;
+}
+
+Tile *get_tile(IVec2 worldPos)
+{
+  IVec2 gridPos = get_grid_pos(worldPos);
+  return get_tile(gridPos.x, gridPos.y);
+}
+
+IVec2 get_tile_pos(int x, int y)
+{
+  return {x * TILESIZE, y * TILESIZE};
+}
+
+IRect get_tile_rect(int x, int y)
+{
+  return {get_tile_pos(x, y), TILESIZE, TILESIZE};
+}
+
+//? Tiles the game camera sees at least part of, clamped to the world
+IRect get_visible_tiles()
+{
+  Rect cameraRect = get_camera_rect(renderData->gameCamera);
+  int minX = max((int)floorf(cameraRect.pos.x / TILESIZE), 0);
+  int minY = max((int)floorf(cameraRect.pos.y / TILESIZE), 0);
+  int maxX = min((int)ceilf((cameraRect.pos.x + cameraRect.size.x) / TILESIZE), WORLD_GRID.x);
+  int maxY = min((int)ceilf((cameraRect.pos.y + cameraRect.size.y) / TILESIZE), WORLD_GRID.y);
+  return {minX, minY, max(maxX - minX, 0), max(maxY - minY, 0)};
+}
+
+//? Recalculate the neighbourMask of every tile inside region (in tiles)
+void update_tiles(IRect region)
+{
+  // Neighbouring Tiles        Top    Left      Right       Bottom
+  int neighbourOffsets[24] = {0, -1, -1, 0, 1, 0, 0, 1,
+                              //                          Topleft Topright Bottomleft Bottomright
+                              -1, -1, 1, -1, -1, 1, 1, 1,
+                              //                           Top2   Left2     Right2      Bottom2
+                              0, -2, -2, 0, 2, 0, 0, 2};
+
+  // Topleft     = BIT(4) = 16
+  // Toplright   = BIT(5) = 32
+  // Bottomleft  = BIT(6) = 64
+  // Bottomright = BIT(7) = 128
+
+  int minX = max(region.pos.x, 0);
+  int minY = max(region.pos.y, 0);
+  int maxX = min(region.pos.x + region.size.x, WORLD_GRID.x);
+  int maxY = min(region.pos.y + region.size.y, WORLD_GRID.y);
+
+  for (int y = minY; y < maxY; y++)
+  {
+    for (int x = minX; x < maxX; x++)
+    {
+      Tile *tile = get_tile(x, y);
+
+      if (tile->material == MATERIAL_AIR)
+      {
+        continue;
+      }
+
+      int neighbourMask = 0;
+      int neighbourCount = 0;
+      int extendedNeighbourCount = 0;
+      int emptyNeighbourSlot = 0;
+
+      // Look at the sorrounding 12 Neighbours
+      for (int n = 0; n < 12; n++)
+      {
+        Tile *neighbour = get_tile(x + neighbourOffsets[n * 2],
+                                   y + neighbourOffsets[n * 2 + 1]);
+
+        // No neighbour means the edge of the world
+        if (!neighbour || neighbour->material != MATERIAL_AIR)
+        {
+          neighbourMask |= BIT(n);
+          if (n < 8) // Counting direct neighbours
+          {
+            neighbourCount++;
+          }
+          else // Counting neighbours 1 Tile away
+          {
+            extendedNeighbourCount++;
+          }
+        }
+        else if (n < 8)
+        {
+          emptyNeighbourSlot = n;
+        }
+      }
+
+      if (neighbourCount == 7 && emptyNeighbourSlot >= 4) // We have a corner
+      {
+        tile->neighbourMask = 16 + (emptyNeighbourSlot - 4);
+      }
+      else if (neighbourCount == 8 && extendedNeighbourCount == 4)
+      {
+        tile->neighbourMask = 20;
+      }
+      else
+      {
+        tile->neighbourMask = neighbourMask & 0b1111;
+      }
+    }
+  }
+}
+
+void update_tiles()
+{
+  update_tiles({0, 0, WORLD_GRID.x, WORLD_GRID.y});
+}
+
+// Occupancy
+//? Outside of the world counts as solid
+bool is_solid(int x, int y)
+{
+  if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+  {
+    return true;
+  }
+  return (gameState->occupancy.rows[y][x / 64] >> (x % 64)) & 1;
+}
+
+OccupancyState &occupancy_mip(int level, int x, int y)
+{
+  return gameState->occupancy.mips[occupancy_mip_offset(level) + y * occupancy_mip_size(level).x + x];
+}
+
+//? Level 0 is the tile itself
+OccupancyState occupancy_get_state(int level, int x, int y)
+{
+  if (!level)
+  {
+    return is_solid(x, y) ? OCCUPANCY_FULL : OCCUPANCY_EMPTY;
+  }
+  return occupancy_mip(level, x, y);
+}
+
+//? State of a cell from its four cells one level down, those outside the world don't count
+OccupancyState occupancy_combine(int level, int x, int y)
+{
+  IVec2 childSize = occupancy_mip_size(level - 1);
+  bool empty = true;
+  bool full = true;
+  for (int child = 0; child < 4; child++)
+  {
+    int childX = x * 2 + (child & 1);
+    int childY = y * 2 + (child >> 1);
+    if (childX >= childSize.x || childY >= childSize.y)
+    {
+      continue;
+    }
+
+    OccupancyState state = occupancy_get_state(level - 1, childX, childY);
+    empty = empty && state == OCCUPANCY_EMPTY;
+    full = full && state == OCCUPANCY_FULL;
+  }
+  return empty ? OCCUPANCY_EMPTY : (full ? OCCUPANCY_FULL : OCCUPANCY_MIXED);
+}
+
+void set_occupancy(int x, int y, bool solid)
+{
+  uint64_t &word = gameState->occupancy.rows[y][x / 64];
+  uint64_t bit = 1ull << (x % 64);
+  if (((word & bit) != 0) == solid)
+  {
+    return;
+  }
+  word ^= bit;
+
+  // Up the pyramid until a cell stays the same
+  for (int level = 1; level <= OCCUPANCY_MIP_TOP; level++)
+  {
+    x /= 2;
+    y /= 2;
+    OccupancyState state = occupancy_combine(level, x, y);
+    OccupancyState &cell = occupancy_mip(level, x, y);
+    if (cell == state)
+    {
+      break;
+    }
+    cell = state;
+  }
+}
+
+void occupancy_visit_rect(IRect rect, int level, int x, int y, bool &anyEmpty, bool &anyFull)
+{
+  int size = 1 << level;
+  int minX = max(x * size, rect.pos.x);
+  int minY = max(y * size, rect.pos.y);
+  int maxX = min(min((x + 1) * size, WORLD_GRID.x), rect.pos.x + rect.size.x);
+  int maxY = min(min((y + 1) * size, WORLD_GRID.y), rect.pos.y + rect.size.y);
+  if (minX >= maxX || minY >= maxY || (anyEmpty && anyFull))
+  {
+    return;
+  }
+
+  OccupancyState state = occupancy_get_state(level, x, y);
+  if (state != OCCUPANCY_MIXED)
+  {
+    anyEmpty = anyEmpty || state == OCCUPANCY_EMPTY;
+    anyFull = anyFull || state == OCCUPANCY_FULL;
+    return;
+  }
+
+  // A mixed cell completely inside the rect has both
+  if (minX == x * size && minY == y * size &&
+      maxX == min((x + 1) * size, WORLD_GRID.x) && maxY == min((y + 1) * size, WORLD_GRID.y))
+  {
+    anyEmpty = true;
+    anyFull = true;
+    return;
+  }
+
+  IVec2 childSize = occupancy_mip_size(level - 1);
+  for (int child = 0; child < 4; child++)
+  {
+    int childX = x * 2 + (child & 1);
+    int childY = y * 2 + (child >> 1);
+    if (childX < childSize.x && childY < childSize.y)
+    {
+      occupancy_visit_rect(rect, level - 1, childX, childY, anyEmpty, anyFull);
+    }
+  }
+}
+
+//? EMPTY or FULL if all tiles of the rect are, MIXED otherwise. Only tiles inside the world count
+OccupancyState occupancy_rect_state(IRect rect)
+{
+  bool anyEmpty = false;
+  bool anyFull = false;
+  occupancy_visit_rect(rect, OCCUPANCY_MIP_TOP, 0, 0, anyEmpty, anyFull);
+  return anyEmpty && anyFull ? OCCUPANCY_MIXED : (anyFull ? OCCUPANCY_FULL : OCCUPANCY_EMPTY);
+}
+
+void minimap_draw_cell(int level, int x, int y, int minimapLevel, Vec2 origin, float scale)
+{
+  if (renderData->transforms.is_full())
+  {
+    return;
+  }
+
+  OccupancyState state = occupancy_get_state(level, x, y);
+  if (state == OCCUPANCY_EMPTY)
+  {
+    return;
+  }
+
+  if (state == OCCUPANCY_MIXED && level > minimapLevel)
+  {
+    IVec2 childSize = occupancy_mip_size(level - 1);
+    for (int child = 0; child < 4; child++)
+    {
+      int childX = x * 2 + (child & 1);
+      int childY = y * 2 + (child >> 1);
+      if (childX < childSize.x && childY < childSize.y)
+      {
+        minimap_draw_cell(level - 1, childX, childY, minimapLevel, origin, scale);
+      }
+    }
+    return;
+  }
+
+  // A full cell is one quad however big it is, a mixed one is drawn half filled
+  int size = 1 << level;
+  float cellSize = size * scale;
+  float quadSize = state == OCCUPANCY_FULL ? cellSize : cellSize * 0.5f;
+  Sprite sprite = get_sprite(SPRITE_MINIMAP_CELL);
+
+  RenderTransform transform = {};
+  transform.pos = origin + Vec2{x * cellSize + (cellSize - quadSize) * 0.5f, y * cellSize + (cellSize - quadSize) * 0.5f};
+  transform.size = {min((float)(WORLD_GRID.x - x * size) * scale, quadSize),
+                    min((float)(WORLD_GRID.y - y * size) * scale, quadSize)};
+  transform.atlasOffset = sprite.atlasOffset;
+  transform.spriteSize = sprite.spriteSize;
+  draw_quad(transform);
+}
+
+//? Solid terrain in the top right corner of the screen, walked down the occupancy mips
+//? so big solid or empty parts of the world cost a single cell
+void draw_minimap()
+{
+  float scale = MINIMAP_WIDTH / WORLD_GRID.x; // Pixels per tile
+
+  // Cells smaller than a pixel are not worth walking into
+  int minimapLevel = 0;
+  while (minimapLevel < OCCUPANCY_MIP_TOP && (1 << minimapLevel) * scale < 1.0f)
+  {
+    minimapLevel++;
+  }
+
+  Rect cameraRect = get_camera_rect(renderData->gameCamera);
+  Vec2 origin = {cameraRect.pos.x + cameraRect.size.x - MINIMAP_WIDTH - MINIMAP_MARGIN,
+                 cameraRect.pos.y + MINIMAP_MARGIN};
+  minimap_draw_cell(OCCUPANCY_MIP_TOP, 0, 0, minimapLevel, origin, scale);
+}
+
+//? Only needed when the worldGrid was written without set_tile_material()
+void rebuild_occupancy()
+{
+  memset(&gameState->occupancy, 0, sizeof(gameState->occupancy));
+  for (int x = 0; x < WORLD_GRID.x; x++)
+  {
+    for (int y = 0; y < WORLD_GRID.y; y++)
+    {
+      set_occupancy(x, y, gameState->worldGrid[x][y].material != MATERIAL_AIR);
+    }
+  }
+}
+
+//? Every change of a tile's material goes through here,
+//? so systems that cache something about the tile can update
+void on_tile_changed(int x, int y, MaterialID oldMaterial, MaterialID newMaterial)
+{
+  set_occupancy(x, y, newMaterial != MATERIAL_AIR);
+  light_on_tile_changed(x, y, oldMaterial, newMaterial);
+  liquid_on_tile_changed(x, y, newMaterial);
+  env_on_tile_changed(x, y, oldMaterial, newMaterial);
+  nav_on_tile_changed(x, y);
+  flow_on_tile_changed(gameState->playerFlow, x, y);
+  integrity_on_tile_changed(x, y, oldMaterial, newMaterial);
+  sdf_on_tile_changed(x, y, oldMaterial, newMaterial);
+  damage_on_tile_changed(x, y, oldMaterial, newMaterial);
+  gameState->savedChunks[x / CHUNK_SIZE][y / CHUNK_SIZE] = false;
+}
+
+// Dirty chunks
+//? Mark every chunk touched by the tiles [minX, maxX] x [minY, maxY] as dirty.
+//? The actual update is deferred to flush_dirty_chunks() so many edits in one
+//? tick only cost a single autotile pass
+void mark_tiles_dirty(int minX, int minY, int maxX, int maxY)
+{
+  // A tile looks 2 tiles away to pick its neighbourMask
+  minX = max(minX - 2, 0);
+  minY = max(minY - 2, 0);
+  maxX = min(maxX + 2, WORLD_GRID.x - 1);
+  maxY = min(maxY + 2, WORLD_GRID.y - 1);
+
+  if (minX > maxX || minY > maxY)
+  {
+    return;
+  }
+
+  for (int chunkY = minY / CHUNK_SIZE; chunkY <= maxY / CHUNK_SIZE; chunkY++)
+  {
+    for (int chunkX = minX / CHUNK_SIZE; chunkX <= maxX / CHUNK_SIZE; chunkX++)
+    {
+      if (gameState->dirtyChunks[chunkX][chunkY])
+      {
+        continue;
+      }
+      gameState->dirtyChunks[chunkX][chunkY] = true;
+      gameState->dirtyChunkList.add({chunkX, chunkY});
+    }
+  }
+}
+
+void mark_tile_dirty(int x, int y)
+{
+  mark_tiles_dirty(x, y, x, y);
+}
+
+void set_tile_material(int x, int y, MaterialID material)
+{
+  Tile *tile = get_tile(x, y);
+  if (!tile || tile->material == material)
+  {
+    return;
+  }
+
+  MaterialID oldMaterial = tile->material;
+  tile->material = material;
+
+  on_tile_changed(x, y, oldMaterial, material);
+  mark_tile_dirty(x, y);
+}
+
+//? Walls don't change anything the tile systems look at, only the render region and the save
+void set_wall_material(int x, int y, MaterialID material)
+{
+  if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y || gameState->wallGrid[x][y] == material)
+  {
+    return;
+  }
+
+  gameState->wallGrid[x][y] = material;
+  gameState->savedChunks[x / CHUNK_SIZE][y / CHUNK_SIZE] = false;
+  mark_tile_dirty(x, y);
+}
+
+IRect get_chunk_rect(IVec2 chunk)
+{
+  return {chunk.x * CHUNK_SIZE, chunk.y * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE};
+}
+
+//? Rebuild the per tile instances of a chunk, the renderer uploads them once.
+//? Walls go into their own list and leave out the ones a covering tile hides
+void build_render_region(IVec2 chunk)
+{
+  IRect chunkRect = get_chunk_rect(chunk);
+  RenderRegion &region = renderData->regions[chunk.y * CHUNK_GRID.x + chunk.x];
+
+  region.bounds = {vec_2(get_tile_pos(chunkRect.pos.x, chunkRect.pos.y)),
+                   vec_2(chunkRect.size * TILESIZE)};
+  region.instances.clear();
+  region.walls.clear();
+  region.hiddenWalls = 0;
+  region.dirty = true;
+
+  // Chunk and the ring around it all solid, every tile is joined on all sides
+  IRect ringRect = {chunkRect.pos.x - 1, chunkRect.pos.y - 1, chunkRect.size.x + 2, chunkRect.size.y + 2};
+  bool chunkCovered = occupancy_rect_state(ringRect) == OCCUPANCY_FULL;
+
+  int maxX = min(chunkRect.pos.x + chunkRect.size.x, WORLD_GRID.x);
+  int maxY = min(chunkRect.pos.y + chunkRect.size.y, WORLD_GRID.y);
+  for (int x = chunkRect.pos.x; x < maxX; x++)
+  {
+    for (int y = chunkRect.pos.y; y < maxY; y++)
+    {
+      MaterialID wallMaterial = gameState->wallGrid[x][y];
+      if (wallMaterial != MATERIAL_AIR)
+      {
+        Tile &tile = gameState->worldGrid[x][y];
+        if (chunkCovered || (tile.material != MATERIAL_AIR && tile.neighbourMask >= FIRST_COVERING_VARIANT))
+        {
+          region.hiddenWalls++;
+        }
+        else
+        {
+          RenderTransform transform = {};
+          transform.pos = vec_2(get_tile_pos(x, y));
+          transform.size = {(float)TILESIZE, (float)TILESIZE};
+          transform.atlasOffset = materialTable.atlasOffsets[wallMaterial][WALL_VARIANT];
+          transform.spriteSize = {TILESIZE, TILESIZE};
+          region.walls.add(transform);
+        }
+      }
+
+      SpriteID overlaySprite = materialTable.overlaySprite[gameState->worldGrid[x][y].material];
+      if (overlaySprite == SPRITE_BLANK)
+      {
+        continue;
+      }
+
+      Sprite sprite = get_sprite(overlaySprite);
+
+      RenderTransform transform = {};
+      transform.pos = vec_2(get_tile_pos(x, y));
+      transform.size = vec_2(sprite.spriteSize);
+      transform.atlasOffset = sprite.atlasOffset;
+      transform.spriteSize = sprite.spriteSize;
+      region.instances.add(transform);
+    }
+  }
+}
+
+void build_all_render_regions()
+{
+  for (int chunkY = 0; chunkY < CHUNK_GRID.y; chunkY++)
+  {
+    for (int chunkX = 0; chunkX < CHUNK_GRID.x; chunkX++)
+    {
+      build_render_region({chunkX, chunkY});
+    }
+  }
+  renderData->regionCount = CHUNK_COUNT;
+}
+
+//? Run the deferred tile updates for all chunks edited since the last flush
+void flush_dirty_chunks()
+{
+  for (int idx = 0; idx < gameState->dirtyChunkList.count; idx++)
+  {
+    IVec2 chunk = gameState->dirtyChunkList[idx];
+
+    update_tiles(get_chunk_rect(chunk));
+    tilemap_mark_dirty(get_chunk_rect(chunk));
+    build_render_region(chunk);
+
+    gameState->dirtyChunks[chunk.x][chunk.y] = false;
+  }
+  gameState->dirtyChunkList.clear();
+}
+
+//? Rebuilds everything derived from the materials, after the worldGrid was written directly
+void refresh_world()
+{
+  rebuild_occupancy();
+  update_tiles();
+  renderData->tilemap.tileUploads.uploadAll = true;
+  build_all_render_regions();
+
+  // Liquids and falling terrain are not part of the world data
+  memset((void *)&gameState->liquid, 0, sizeof(gameState->liquid));
+  debris_reset();
+  gameState->integrity.candidates.clear();
+
+  gameState->light.needsRebuild = true;
+  gameState->environment.initialized = false;
+  gameState->nav.initialized = false;
+  gameState->nav.dirtyClusters.clear();
+  gameState->sdf.initialized = false;
+  gameState->damage.initialized = false;
+  if (gameState->playerFlow.valid || gameState->playerFlow.stage != FLOW_IDLE)
+  {
+    FlowField &field = gameState->playerFlow;
+    flow_start_build(field, field.stage != FLOW_IDLE ? field.buildGoal : field.goal);
+  }
+}
@@ -53,7 +53,8 @@ int main()
         LOG_ERROR("Failed to allocate GameState");
         return -1;
     }
-    soundState = (SoundState *)bump_alloc(&persistentStorage, sizeof(GameState));
+    gameState->transientStorage = &transientStorage;
+    soundState = (SoundState *)bump_alloc(&persistentStorage, sizeof(SoundState));
     if (!soundState)
     {
         LOG_ERROR("Failed to allocate SoundState");
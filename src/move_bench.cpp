@@ -0,0 +1,169 @@
+// Headless benchmark of Move(), swept against the tiles versus stepping pixel by pixel.
+// Both run the same bodies over a cave, the bodies have to come out the same:
+//   moveBench.exe 10000
+#include "bench_utils.h"
+
+constexpr int MOVE_BENCH_TICKS = 60;
+
+//? Move() as it was, one pixel at a time and every tile the rect overlaps tested after each step
+void move_per_pixel(Transform &transform)
+{
+    IVec2 &pos = transform.pos;
+    IRect rect = get_world_AABB(transform);
+    auto overlaps_tile = [](IRect rect)
+    {
+        for (int x = pixel_to_tile(rect.pos.x); x <= pixel_to_tile(rect.pos.x + rect.size.x - 1); x++)
+        {
+            for (int y = pixel_to_tile(rect.pos.y); y <= pixel_to_tile(rect.pos.y + rect.size.y - 1); y++)
+            {
+                Tile *tile = get_tile(x, y);
+                if (tile && materialTable.collides[tile->material])
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    transform.remainder.x += transform.speed.x;
+    int moveX = round(transform.remainder.x);
+    if (moveX != 0)
+    {
+        transform.remainder.x -= moveX;
+        while (moveX)
+        {
+            rect.pos.x += sign(moveX);
+            if (overlaps_tile(rect))
+            {
+                transform.hasCollided = true;
+                transform.speed.x = SimFloat(0.0f);
+                break;
+            }
+            pos.x += sign(moveX);
+            moveX -= sign(moveX);
+            rect = get_world_AABB(transform);
+        }
+    }
+
+    transform.remainder.y += transform.speed.y;
+    int moveY = round(transform.remainder.y);
+    if (moveY != 0)
+    {
+        transform.remainder.y -= moveY;
+        while (moveY)
+        {
+            // Only the first step keeps the x probe that touched a wall
+            rect.pos.y += sign(moveY);
+            if (overlaps_tile(rect))
+            {
+                transform.hasCollided = true;
+                if (transform.speed.y > SimFloat(0.0f))
+                {
+                    transform.isGrounded = true;
+                }
+                transform.speed.y = SimFloat(0.0f);
+                break;
+            }
+            pos.y += sign(moveY);
+            moveY -= sign(moveY);
+            rect = get_world_AABB(transform);
+        }
+    }
+}
+
+bool same_move(Transform &a, Transform &b)
+{
+    return a.pos.x == b.pos.x && a.pos.y == b.pos.y &&
+           a.speed.x == b.speed.x && a.speed.y == b.speed.y &&
+           a.remainder.x == b.remainder.x && a.remainder.y == b.remainder.y &&
+           a.hasCollided == b.hasCollided && a.isGrounded == b.isGrounded;
+}
+
+//? Random speed in [-maxSpeed; maxSpeed]
+float bench_speed(float maxSpeed)
+{
+    return ((bench_random() & 0xFFFF) / 32767.5f - 1.0f) * maxSpeed;
+}
+
+int main(int argc, char **argv)
+{
+    int bodyCount = argc > 1 ? atoi(argv[1]) : 10000;
+    if (bodyCount <= 0)
+    {
+        LOG_ERROR("Body count has to be above 0");
+        return -1;
+    }
+    if (!bench_init())
+    {
+        return -1;
+    }
+    bench_generate_cave(7);
+
+    Transform *swept = (Transform *)calloc(bodyCount, sizeof(Transform));
+    Transform *perPixel = (Transform *)calloc(bodyCount, sizeof(Transform));
+    if (!swept || !perPixel)
+    {
+        LOG_ERROR("Failed to allocate the bodies");
+        return -1;
+    }
+
+    const float maxSpeeds[] = {2.0f, 8.0f, 32.0f, 128.0f};
+    for (float maxSpeed : maxSpeeds)
+    {
+        for (int idx = 0; idx < bodyCount; idx++)
+        {
+            Transform &body = swept[idx];
+            body = {};
+            body.aabb = {8, 16};
+            body.pos = {(int)(bench_random() % WORLD_WIDTH), (int)(bench_random() % (WORLD_GRID.y * TILESIZE))};
+            perPixel[idx] = body;
+        }
+
+        double sweptMs = 0.0;
+        double perPixelMs = 0.0;
+        int differ = 0;
+        for (int tick = 0; tick < MOVE_BENCH_TICKS; tick++)
+        {
+            // Stopped bodies start again in a new direction, also the ones that differ
+            for (int idx = 0; idx < bodyCount; idx++)
+            {
+                Transform &body = swept[idx];
+                body.hasCollided = false;
+                body.isGrounded = false;
+                if (body.speed.x == SimFloat(0.0f))
+                {
+                    body.speed.x = SimFloat(bench_speed(maxSpeed));
+                }
+                if (body.speed.y == SimFloat(0.0f))
+                {
+                    body.speed.y = SimFloat(bench_speed(maxSpeed));
+                }
+                perPixel[idx] = body;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (int idx = 0; idx < bodyCount; idx++)
+            {
+                Move(swept[idx]);
+            }
+            sweptMs += bench_ms_since(start);
+
+            start = std::chrono::steady_clock::now();
+            for (int idx = 0; idx < bodyCount; idx++)
+            {
+                move_per_pixel(perPixel[idx]);
+            }
+            perPixelMs += bench_ms_since(start);
+
+            for (int idx = 0; idx < bodyCount; idx++)
+            {
+                differ += !same_move(swept[idx], perPixel[idx]);
+            }
+        }
+
+        printf("%d bodies up to %3.0f px/tick: swept %.3f ms per tick, per pixel %.3f ms per tick, %d moves differ\n",
+               bodyCount, maxSpeed, sweptMs / MOVE_BENCH_TICKS, perPixelMs / MOVE_BENCH_TICKS, differ);
+    }
+    return 0;
+}
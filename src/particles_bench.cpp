@@ -0,0 +1,68 @@
+// Headless particle benchmark, runs particles_update() without a window or GPU.
+// Keeps the given number of particles alive over a cave and prints the tick cost:
+//   particlesBench.exe 1000000
+#include "game/game.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+constexpr int BENCH_TICKS = 600;
+
+int main(int argc, char **argv)
+{
+    int target = argc > 1 ? atoi(argv[1]) : 100000;
+    if (target <= 0 || target > MAX_PARTICLES)
+    {
+        LOG_ERROR("Particle count has to be in [1; %d]", MAX_PARTICLES);
+        return -1;
+    }
+
+    gameState = (GameState *)calloc(1, sizeof(GameState));
+    renderData = (RenderData *)calloc(1, sizeof(RenderData));
+    if (!gameState || !renderData)
+    {
+        LOG_ERROR("Failed to allocate GameState");
+        return -1;
+    }
+    init_material_table();
+
+    // Floor, ceiling and pillars, so particles bounce on every side
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            bool solid = y < 2 || y >= WORLD_GRID.y - 3 || (x % 10 == 0 && y > WORLD_GRID.y / 2);
+            gameState->worldGrid[x][y].material = solid ? MATERIAL_STONE : MATERIAL_AIR;
+        }
+    }
+    rebuild_occupancy();
+
+    float totalMs = 0.0f;
+    float worstMs = 0.0f;
+    long long bounces = 0;
+    long long updated = 0;
+    for (int tick = 0; tick < BENCH_TICKS; tick++)
+    {
+        // Refill whatever died with bursts from random spots in the air
+        while (gameState->particles.count < target)
+        {
+            Vec2 pos = {(float)(particle_random() % ((WORLD_GRID.x - 2) * TILESIZE) + TILESIZE),
+                        (float)(particle_random() % (WORLD_GRID.y / 2 * TILESIZE) + 2 * TILESIZE)};
+            float life = 0.5f + (particle_random() % 1000) * 0.0015f;
+            int burst = min(64, target - gameState->particles.count);
+            particle_burst(pos, burst, 200.0f, life, SPARK_COLOR);
+        }
+
+        updated += gameState->particles.count;
+        particles_update(UPDATE_DELAY);
+        totalMs += gameState->particles.updateMs;
+        worstMs = max(worstMs, gameState->particles.updateMs);
+        bounces += gameState->particles.bounces;
+    }
+
+    printf("%d particles, %d ticks: %.3f ms per tick on average, %.3f ms worst, %.2f ns per particle, "
+           "%lld bounces per tick\n",
+           target, BENCH_TICKS, totalMs / BENCH_TICKS, worstMs, totalMs * 1e6f / updated,
+           bounces / BENCH_TICKS);
+    return 0;
+}
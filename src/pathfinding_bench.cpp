@@ -0,0 +1,203 @@
+// Headless benchmark of the hierarchical pathfinding. Builds the graph of a generated
+// cave, answers random queries and checks them against a BFS over the full grid, then
+// carves and fills holes and times the incremental rebuild. Meant for the 2048x2048 world:
+//   pathfindingBench.exe 500
+#include "bench_utils.h"
+
+constexpr int PATHFINDING_BENCH_CHECKED = 50; // Queries also run through the BFS, it is slow
+constexpr int PATHFINDING_BENCH_CARVES = 100;
+
+static int *benchDistances;
+static int *benchQueue;
+
+//? Shortest walk over the full grid, -1 if the goal can't be reached
+int bfs_distance(IVec2 start, IVec2 goal)
+{
+    for (int idx = 0; idx < WORLD_GRID.x * WORLD_GRID.y; idx++)
+    {
+        benchDistances[idx] = -1;
+    }
+    int head = 0;
+    int tail = 0;
+    benchDistances[start.x + start.y * WORLD_GRID.x] = 0;
+    benchQueue[tail++] = start.x + start.y * WORLD_GRID.x;
+    while (head < tail)
+    {
+        int idx = benchQueue[head++];
+        int x = idx % WORLD_GRID.x;
+        int y = idx / WORLD_GRID.x;
+        if (x == goal.x && y == goal.y)
+        {
+            return benchDistances[idx];
+        }
+        const int offsets[8] = {0, -1, -1, 0, 1, 0, 0, 1};
+        for (int dir = 0; dir < 4; dir++)
+        {
+            int nx = x + offsets[dir * 2];
+            int ny = y + offsets[dir * 2 + 1];
+            if (is_solid(nx, ny) || benchDistances[nx + ny * WORLD_GRID.x] >= 0)
+            {
+                continue;
+            }
+            benchDistances[nx + ny * WORLD_GRID.x] = benchDistances[idx] + 1;
+            benchQueue[tail++] = nx + ny * WORLD_GRID.x;
+        }
+    }
+    return -1;
+}
+
+IVec2 random_air_tile()
+{
+    while (true)
+    {
+        IVec2 tile = {(int)(bench_random() % WORLD_GRID.x), (int)(bench_random() % WORLD_GRID.y)};
+        if (!is_solid(tile.x, tile.y))
+        {
+            return tile;
+        }
+    }
+}
+
+//? Refines every leg of the path and checks that the steps walk through air one tile at a time
+bool path_is_walkable(NavPath &path)
+{
+    static IVec2 steps[NAV_CLUSTER_SIZE * NAV_CLUSTER_SIZE];
+    int walked = 0;
+    IVec2 from = path.waypoints[0];
+    for (int idx = 1; idx < path.waypoints.count; idx++)
+    {
+        IVec2 to = path.waypoints[idx];
+        int stepCount = nav_refine_segment(from, to, steps, ArraySize(steps));
+        if (!stepCount && (from.x != to.x || from.y != to.y))
+        {
+            return false;
+        }
+        for (int step = 0; step < stepCount; step++)
+        {
+            IVec2 prev = step ? steps[step - 1] : from;
+            if (abs(prev.x - steps[step].x) + abs(prev.y - steps[step].y) != 1 || is_solid(steps[step].x, steps[step].y))
+            {
+                return false;
+            }
+        }
+        walked += stepCount;
+        from = to;
+    }
+    return walked == path.cost;
+}
+
+//? Runs the first checkCount queries against the BFS too, returns how many of those disagree
+int check_queries(int checkCount, double &costRatio)
+{
+    int wrong = 0;
+    int ratioCount = 0;
+    costRatio = 0.0;
+    for (int query = 0; query < checkCount; query++)
+    {
+        IVec2 start = random_air_tile();
+        IVec2 goal = random_air_tile();
+        NavPath path = nav_find_path(start, goal);
+        int distance = bfs_distance(start, goal);
+        if (path.found != (distance >= 0) || (path.found && !path_is_walkable(path)))
+        {
+            wrong++;
+            continue;
+        }
+        if (distance > 0)
+        {
+            costRatio += (double)path.cost / distance;
+            ratioCount++;
+        }
+    }
+    costRatio = ratioCount ? costRatio / ratioCount : 1.0;
+    return wrong;
+}
+
+int main(int argc, char **argv)
+{
+    int queryCount = argc > 1 ? atoi(argv[1]) : 500;
+    if (queryCount <= 0)
+    {
+        LOG_ERROR("Query count has to be above 0");
+        return -1;
+    }
+    if (!bench_init())
+    {
+        return -1;
+    }
+    benchDistances = (int *)malloc(WORLD_GRID.x * WORLD_GRID.y * sizeof(int));
+    benchQueue = (int *)malloc(WORLD_GRID.x * WORLD_GRID.y * sizeof(int));
+    if (!benchDistances || !benchQueue)
+    {
+        LOG_ERROR("Failed to allocate the BFS");
+        return -1;
+    }
+    bench_generate_cave(7);
+
+    auto start = std::chrono::steady_clock::now();
+    nav_update();
+    double buildMs = bench_ms_since(start);
+    printf("%dx%d cave: full build of %d clusters %.1f ms\n", WORLD_GRID.x, WORLD_GRID.y,
+           gameState->nav.rebuiltClusters, buildMs);
+
+    // Unreachable goals search the whole graph of the start's cave, they are timed apart
+    double totalMs[2] = {};
+    double worstMs[2] = {};
+    int found = 0;
+    for (int query = 0; query < queryCount; query++)
+    {
+        IVec2 from = random_air_tile();
+        IVec2 to = random_air_tile();
+        start = std::chrono::steady_clock::now();
+        NavPath path = nav_find_path(from, to);
+        double ms = bench_ms_since(start);
+        totalMs[path.found] += ms;
+        worstMs[path.found] = fmax(worstMs[path.found], ms);
+        found += path.found;
+    }
+    int notFound = queryCount - found;
+    printf("  %d random queries, %d found: avg %.3f ms, worst %.3f ms\n", queryCount, found,
+           found ? totalMs[1] / found : 0.0, worstMs[1]);
+    printf("  %d not found: avg %.3f ms, worst %.3f ms\n", notFound, notFound ? totalMs[0] / notFound : 0.0,
+           worstMs[0]);
+
+    double costRatio;
+    int wrong = check_queries(PATHFINDING_BENCH_CHECKED, costRatio);
+    printf("  %d queries against a BFS: %d wrong, paths %.2fx the shortest on average\n", PATHFINDING_BENCH_CHECKED,
+           wrong, costRatio);
+
+    double rebuildMs = 0.0;
+    int rebuiltClusters = 0;
+    for (int carve = 0; carve < PATHFINDING_BENCH_CARVES; carve++)
+    {
+        carve_circle({(float)(bench_random() % WORLD_GRID.x), (float)(bench_random() % WORLD_GRID.y)}, 3.0f);
+        start = std::chrono::steady_clock::now();
+        nav_update();
+        rebuildMs += bench_ms_since(start);
+        rebuiltClusters += gameState->nav.rebuiltClusters;
+    }
+    printf("  carving a radius 3 hole: rebuild %.3f ms, %.1f clusters on average\n",
+           rebuildMs / PATHFINDING_BENCH_CARVES, (double)rebuiltClusters / PATHFINDING_BENCH_CARVES);
+
+    wrong += check_queries(PATHFINDING_BENCH_CHECKED, costRatio);
+    printf("  %d queries against a BFS after carving: %d wrong in total\n", PATHFINDING_BENCH_CHECKED, wrong);
+
+    // Filled holes can split a cave, the components only notice once a search fails.
+    // Few enough that the default world keeps its air
+    int fillCount = min(PATHFINDING_BENCH_CARVES, WORLD_GRID.x * WORLD_GRID.y / 100);
+    for (int fill = 0; fill < fillCount; fill++)
+    {
+        IVec2 center = random_air_tile();
+        for (int x = center.x - 1; x <= center.x + 1; x++)
+        {
+            for (int y = center.y - 1; y <= center.y + 1; y++)
+            {
+                set_tile_material(x, y, MATERIAL_STONE);
+            }
+        }
+        nav_update();
+    }
+    wrong += check_queries(PATHFINDING_BENCH_CHECKED, costRatio);
+    printf("  %d queries against a BFS after filling: %d wrong in total\n", PATHFINDING_BENCH_CHECKED, wrong);
+    return wrong ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// Headless benchmark of raycast_batch(). Casts rays in random directions through a
+// generated cave, checks every hit against a plain tile by tile walk that skips nothing
+// and prints the time per batch:
+//   raycastBench.exe 100000
+#include "bench_utils.h"
+
+constexpr int RAYCAST_BENCH_TICKS = 20;
+
+//? Tile by tile in double precision, no empty blocks are skipped
+RayHit raycast_tile_by_tile(Ray ray)
+{
+    RayHit result = {};
+    float clippedStart, clippedEnd;
+    IVec2 normal;
+    if (!raycast_clip(ray, clippedStart, clippedEnd, normal))
+    {
+        return result;
+    }
+
+    double t = clippedStart;
+    double originX = ray.origin.x, originY = ray.origin.y;
+    double dirX = ray.dir.x, dirY = ray.dir.y;
+    int x = min(max((int)floor(originX + dirX * t), 0), WORLD_GRID.x - 1);
+    int y = min(max((int)floor(originY + dirY * t), 0), WORLD_GRID.y - 1);
+    int stepX = dirX > 0.0 ? 1 : -1;
+    int stepY = dirY > 0.0 ? 1 : -1;
+    while (t <= clippedEnd)
+    {
+        if (is_solid(x, y))
+        {
+            result = {true, {x, y}, normal, (float)t};
+            return result;
+        }
+
+        double exitX = dirX != 0.0 ? ((stepX > 0 ? x + 1 : x) - originX) / dirX : 1e300;
+        double exitY = dirY != 0.0 ? ((stepY > 0 ? y + 1 : y) - originY) / dirY : 1e300;
+        if (exitX < exitY)
+        {
+            t = exitX;
+            x += stepX;
+            normal = {-stepX, 0};
+        }
+        else
+        {
+            t = exitY;
+            y += stepY;
+            normal = {0, -stepY};
+        }
+        if (x < 0 || x >= WORLD_GRID.x || y < 0 || y >= WORLD_GRID.y)
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+bool same_hit(RayHit &a, RayHit &b)
+{
+    if (a.hit != b.hit)
+    {
+        return false;
+    }
+    return !a.hit || (a.tile.x == b.tile.x && a.tile.y == b.tile.y && a.normal.x == b.normal.x &&
+                      a.normal.y == b.normal.y && fabsf(a.distance - b.distance) <= 1e-3f * max(1.0f, b.distance));
+}
+
+int main(int argc, char **argv)
+{
+    int rayCount = argc > 1 ? atoi(argv[1]) : 100000;
+    if (rayCount <= 0)
+    {
+        LOG_ERROR("Ray count has to be above 0");
+        return -1;
+    }
+    if (!bench_init())
+    {
+        return -1;
+    }
+    bench_generate_cave(7);
+
+    Ray *rays = (Ray *)malloc(rayCount * sizeof(Ray));
+    RayHit *hits = (RayHit *)malloc(rayCount * sizeof(RayHit));
+    RayHit *expected = (RayHit *)malloc(rayCount * sizeof(RayHit));
+    if (!rays || !hits || !expected)
+    {
+        LOG_ERROR("Failed to allocate the rays");
+        return -1;
+    }
+
+    // Mostly from the air, a few from inside rock or outside the world, some along an axis
+    float range = (float)(WORLD_GRID.x + WORLD_GRID.y);
+    for (int idx = 0; idx < rayCount; idx++)
+    {
+        Vec2 origin;
+        int tries = 0;
+        do
+        {
+            origin = {(bench_random() & 0xFFFF) / 65536.0f * WORLD_GRID.x,
+                      (bench_random() & 0xFFFF) / 65536.0f * WORLD_GRID.y};
+        } while (is_solid((int)origin.x, (int)origin.y) && idx % 10 && ++tries < 100);
+        if (idx % 97 == 0)
+        {
+            origin.x = -5.0f;
+        }
+
+        float angle = (bench_random() & 0xFFFF) * (6.2831853f / 65536.0f);
+        Vec2 dir = {cosf(angle), sinf(angle)};
+        if (idx % 50 == 0)
+        {
+            dir = {1.0f, 0.0f};
+        }
+        if (idx % 50 == 1)
+        {
+            dir = {0.0f, -1.0f};
+        }
+        rays[idx] = {origin, dir, idx % 4 == 0 ? 1e9f : range};
+    }
+
+    double batchMs = 1e30;
+    double tileByTileMs = 1e30;
+    for (int tick = 0; tick < RAYCAST_BENCH_TICKS; tick++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        raycast_batch(rays, hits, rayCount);
+        batchMs = fmin(batchMs, bench_ms_since(start));
+
+        start = std::chrono::steady_clock::now();
+        for (int idx = 0; idx < rayCount; idx++)
+        {
+            expected[idx] = raycast_tile_by_tile(rays[idx]);
+        }
+        tileByTileMs = fmin(tileByTileMs, bench_ms_since(start));
+    }
+
+    int hitCount = 0;
+    int differ = 0;
+    for (int idx = 0; idx < rayCount; idx++)
+    {
+        hitCount += expected[idx].hit;
+        differ += !same_hit(hits[idx], expected[idx]);
+    }
+
+    int solid = 0;
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            solid += is_solid(x, y);
+        }
+    }
+    printf("%dx%d cave, %.0f%% solid: %d rays, %d hit\n", WORLD_GRID.x, WORLD_GRID.y,
+           100.0 * solid / (WORLD_GRID.x * WORLD_GRID.y), rayCount, hitCount);
+    printf("  raycast_batch %.3f ms, tile by tile %.3f ms (best of %d), %d hits differ\n", batchMs, tileByTileMs,
+           RAYCAST_BENCH_TICKS, differ);
+    return differ ? 1 : 0;
+}
@@ -0,0 +1,275 @@
+// Headless benchmark of the region file. Saves a generated world, edits and saves it
+// again, reloads it and checks every tile, loads a corrupted copy, then walks a 1 GB mapped file dropping its
+// pages the way load_world() does, to show the memory a load holds on to stays bounded.
+// Writes its files into the given directory:
+//   regionBench.exe C:/temp
+#include "bench_utils.h"
+
+constexpr int REGION_BENCH_EDIT_SAVES = 200;
+constexpr long long REGION_BENCH_BIG_FILE_SIZE = GB(1);
+
+static uint8_t *benchMaterials;
+static uint8_t *benchWalls;
+static volatile uint64_t benchSink; // Keeps the reads of the walk from being optimized away
+
+void remember_materials()
+{
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            benchMaterials[x * WORLD_GRID.y + y] = gameState->worldGrid[x][y].material;
+            benchWalls[x * WORLD_GRID.y + y] = gameState->wallGrid[x][y];
+        }
+    }
+}
+
+//? Tiles whose material or wall differs from the remembered ones
+int count_changed_tiles()
+{
+    int changed = 0;
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            changed += benchMaterials[x * WORLD_GRID.y + y] != gameState->worldGrid[x][y].material ||
+                       benchWalls[x * WORLD_GRID.y + y] != gameState->wallGrid[x][y];
+        }
+    }
+    return changed;
+}
+
+void clear_world()
+{
+    for (int x = 0; x < WORLD_GRID.x; x++)
+    {
+        for (int y = 0; y < WORLD_GRID.y; y++)
+        {
+            gameState->worldGrid[x][y].material = MATERIAL_AIR;
+            gameState->wallGrid[x][y] = MATERIAL_AIR;
+        }
+    }
+}
+
+//? Loads the world again and counts the tiles that came back different, -1 if the load failed
+int reload_and_compare(const char *filePath)
+{
+    clear_world();
+    bool loaded = load_world(filePath);
+    gameState->transientStorage->used = 0;
+    return loaded ? count_changed_tiles() : -1;
+}
+
+int count_unsaved_chunks()
+{
+    int unsaved = 0;
+    for (int chunkX = 0; chunkX < CHUNK_GRID.x; chunkX++)
+    {
+        for (int chunkY = 0; chunkY < CHUNK_GRID.y; chunkY++)
+        {
+            unsaved += !gameState->savedChunks[chunkX][chunkY];
+        }
+    }
+    return unsaved;
+}
+
+//? Overwrites the encoding of the last chunk in the file with one that doesn't exist
+bool corrupt_last_chunk(const char *filePath)
+{
+    FILE *file = fopen(filePath, "r+b");
+    if (!file)
+    {
+        return false;
+    }
+    RegionEntry entry;
+    fseek(file, sizeof(RegionHeader) + (CHUNK_COUNT - 1) * sizeof(RegionEntry), SEEK_SET);
+    bool corrupted = fread(&entry, sizeof(entry), 1, file) == 1 && entry.sector;
+    if (corrupted)
+    {
+        fseek(file, (long)entry.sector * REGION_SECTOR_SIZE, SEEK_SET);
+        corrupted = fputc(0xFF, file) != EOF;
+    }
+    fclose(file);
+    return corrupted;
+}
+
+//? Touches every page of the file, dropping them every releaseSize bytes if that isn't 0.
+//? Returns by how much the memory of the process grew at most
+long long walk_mapped_file(const char *filePath, long long releaseSize, double &ms)
+{
+    MappedFile file;
+    if (!map_file(filePath, false, &file))
+    {
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long long rssBefore = bench_rss_kb();
+    long long peakGrowth = 0;
+    long long released = 0;
+    uint64_t sum = 0;
+    for (long long offset = 0; offset < file.size; offset += 4096)
+    {
+        sum += (uint8_t)file.data[offset];
+        if (releaseSize && offset - released >= releaseSize)
+        {
+            release_mapped_pages(&file, released, offset - released);
+            released = offset;
+        }
+        if (offset % MB(16) == 0)
+        {
+            peakGrowth = max(peakGrowth, bench_rss_kb() - rssBefore);
+        }
+    }
+    peakGrowth = max(peakGrowth, bench_rss_kb() - rssBefore);
+    ms = bench_ms_since(start);
+
+    benchSink = sum;
+    unmap_file(&file);
+    return peakGrowth;
+}
+
+int main(int argc, char **argv)
+{
+    const char *directory = argc > 1 ? argv[1] : ".";
+    char worldPath[512];
+    char bigFilePath[512];
+    snprintf(worldPath, sizeof(worldPath), "%s/bench_world.vbr", directory);
+    snprintf(bigFilePath, sizeof(bigFilePath), "%s/bench_big.bin", directory);
+
+    if (!bench_init())
+    {
+        return -1;
+    }
+    benchMaterials = (uint8_t *)malloc(WORLD_GRID.x * WORLD_GRID.y);
+    benchWalls = (uint8_t *)malloc(WORLD_GRID.x * WORLD_GRID.y);
+    bench_generate_cave(11);
+    remember_materials();
+    remove(worldPath);
+
+    auto start = std::chrono::steady_clock::now();
+    bool saved = save_world(worldPath);
+    double fullSaveMs = bench_ms_since(start);
+    gameState->transientStorage->used = 0;
+    int changed = reload_and_compare(worldPath);
+    printf("%dx%d world, %d chunks: full save %.2f ms, %lld bytes, saved %d, %d tiles differ after loading\n",
+           WORLD_GRID.x, WORLD_GRID.y, CHUNK_COUNT, fullSaveMs, (long long)get_file_size(worldPath), saved, changed);
+
+    // A few edits between saves, only their chunks are written
+    double editSaveMs = 0.0;
+    int badReloads = 0;
+    for (int save = 0; save < REGION_BENCH_EDIT_SAVES; save++)
+    {
+        int edits = 1 + bench_random() % 8;
+        for (int edit = 0; edit < edits; edit++)
+        {
+            set_tile_material(bench_random() % WORLD_GRID.x, bench_random() % WORLD_GRID.y,
+                              (MaterialID)(bench_random() % MATERIAL_COUNT));
+            set_wall_material(bench_random() % WORLD_GRID.x, bench_random() % WORLD_GRID.y,
+                              (MaterialID)(bench_random() % MATERIAL_COUNT));
+        }
+        flush_dirty_chunks();
+        remember_materials();
+
+        start = std::chrono::steady_clock::now();
+        badReloads += !save_world(worldPath);
+        editSaveMs += bench_ms_since(start);
+        gameState->transientStorage->used = 0;
+
+        if (save % 20 == 0)
+        {
+            badReloads += reload_and_compare(worldPath) != 0;
+        }
+    }
+    printf("%d saves of up to 8 edited tiles and walls: %.3f ms per save, %d failed saves or reloads\n",
+           REGION_BENCH_EDIT_SAVES, editSaveMs / REGION_BENCH_EDIT_SAVES, badReloads);
+
+    // A corrupted chunk fails the whole load, the world and what is left to save stay as they were
+    for (int edit = 0; edit < 8; edit++)
+    {
+        set_tile_material(bench_random() % WORLD_GRID.x, bench_random() % WORLD_GRID.y,
+                          (MaterialID)(bench_random() % MATERIAL_COUNT));
+    }
+    flush_dirty_chunks();
+    remember_materials();
+    int unsavedChunks = count_unsaved_chunks();
+    bool corrupted = corrupt_last_chunk(worldPath);
+    bool loaded = load_world(worldPath);
+    gameState->transientStorage->used = 0;
+    printf("Loading with a corrupted chunk: corrupted %d, loaded %d, %d tiles differ, %d of %d unsaved chunks left\n",
+           corrupted, loaded, count_changed_tiles(), count_unsaved_chunks(), unsavedChunks);
+
+    // A file of something else is replaced by a new one, not written into
+    FILE *garbage = fopen(worldPath, "wb");
+    fputs("not a world", garbage);
+    fclose(garbage);
+    saved = save_world(worldPath);
+    gameState->transientStorage->used = 0;
+    printf("Saving over a foreign file: saved %d, %d tiles differ after loading\n", saved, reload_and_compare(worldPath));
+
+    // Loading chunk by chunk, the pages of the file are dropped as load_world() does
+    RegionFile region;
+    WorldLayers *layers = (WorldLayers *)malloc(sizeof(WorldLayers));
+    if (layers && region_open(region, worldPath, false))
+    {
+        clear_world();
+        memset((void *)layers, 0, sizeof(WorldLayers)); // Its pages don't count towards the growth
+        long long rssBefore = bench_rss_kb();
+        long long peakGrowth = 0;
+        start = std::chrono::steady_clock::now();
+        bool loaded = true;
+        for (int idx = 0; idx < CHUNK_COUNT; idx++)
+        {
+            loaded &= region_read_chunk(region, {idx % CHUNK_GRID.x, idx / CHUNK_GRID.x}, *layers);
+            if ((idx + 1) % REGION_RELEASE_CHUNKS == 0)
+            {
+                peakGrowth = max(peakGrowth, bench_rss_kb() - rssBefore);
+                release_mapped_pages(&region.file, 0, region.file.size);
+            }
+        }
+        peakGrowth = max(peakGrowth, bench_rss_kb() - rssBefore);
+        double loadMs = bench_ms_since(start);
+        unmap_file(&region.file);
+        apply_world_layers(*layers);
+        printf("Decoding %d chunks from the mapping: %.2f ms, loaded %d, %d tiles differ, memory grew by %lld kB at most\n",
+               CHUNK_COUNT, loadMs, loaded, count_changed_tiles(), peakGrowth);
+    }
+    remove(worldPath);
+
+    // 1 GB: load_world() never holds more than REGION_RELEASE_CHUNKS chunks of the file
+    FILE *bigFile = fopen(bigFilePath, "wb");
+    if (!bigFile)
+    {
+        LOG_ERROR("Failed creating %s", bigFilePath);
+        return -1;
+    }
+    int blockSize = MB(4);
+    uint8_t *block = (uint8_t *)malloc(blockSize);
+    for (int idx = 0; idx < blockSize; idx++)
+    {
+        block[idx] = (uint8_t)bench_random();
+    }
+    bool written = true;
+    for (long long size = 0; size < REGION_BENCH_BIG_FILE_SIZE && written; size += blockSize)
+    {
+        written = fwrite(block, 1, blockSize, bigFile) == (size_t)blockSize;
+    }
+    fclose(bigFile);
+    free(block);
+    if (!written)
+    {
+        LOG_ERROR("Failed writing %s", bigFilePath);
+        remove(bigFilePath);
+        return -1;
+    }
+
+    long long releaseSize = (long long)REGION_RELEASE_CHUNKS * REGION_MAX_CHUNK_SECTORS * REGION_SECTOR_SIZE;
+    double walkMs = 0.0;
+    long long keptGrowth = walk_mapped_file(bigFilePath, 0, walkMs);
+    printf("1 GB mapped file, pages kept: memory grew by %lld MB at most, %.0f ms\n", keptGrowth / 1024, walkMs);
+    long long releasedGrowth = walk_mapped_file(bigFilePath, releaseSize, walkMs);
+    printf("1 GB mapped file, pages dropped every %lld kB: memory grew by %lld MB at most, %.0f ms\n",
+           releaseSize / 1024, releasedGrowth / 1024, walkMs);
+    remove(bigFilePath);
+    return 0;
+}
@@ -9,6 +9,13 @@
 // ################################     OpenGL Constants    ################################
 const char *TEXTURE_PATH = "assets/textures/Texture_Atlas.png";
 
+const char *QUAD_VERT_PATH = "assets/shaders/quad.vert";
+const char *QUAD_FRAG_PATH = "assets/shaders/quad.frag";
+const char *TILEMAP_VERT_PATH = "assets/shaders/tilemap.vert";
+const char *TILEMAP_FRAG_PATH = "assets/shaders/tilemap.frag";
+const char *PARTICLE_VERT_PATH = "assets/shaders/particle.vert";
+const char *PARTICLE_FRAG_PATH = "assets/shaders/particle.frag";
+
 // ################################     OpenGL Structs    ################################
 struct GLContext
 {
@@ -18,8 +25,33 @@ struct GLContext
     GLuint screenSizeID;
     GLuint orthoProjectionID;
 
+    // Tile layer
+    GLuint tilemapProgramID;
+    GLuint tilemapTextureID;
+    IVec2 tilemapTextureSize;
+    GLuint lightmapTextureID;
+    IVec2 lightmapTextureSize;
+    GLuint tilemapUseLightingID;
+    GLuint tilemapOrthoProjectionID;
+    GLuint tilemapLayerSizeID;
+    GLuint tilemapTileSizeID;
+    GLuint tilemapAtlasOriginsID;
+
+    // Particles, read from storage buffer binding 1
+    GLuint particleProgramID;
+    GLuint particleSBOID;
+    GLuint particleOrthoProjectionID;
+
+    // Two storage buffers per render region, drawn with the quad program
+    GLuint regionSBOIDs[MAX_RENDER_REGIONS];
+    int regionInstanceCounts[MAX_RENDER_REGIONS];
+    GLuint regionWallSBOIDs[MAX_RENDER_REGIONS];
+    int regionWallCounts[MAX_RENDER_REGIONS];
+
     long long textureTimestamp;
     long long shaderTimestamp;
+    long long tilemapShaderTimestamp;
+    long long particleShaderTimestamp;
 };
 // ################################     OpenGL Globals    ################################
 static GLContext glContext;
@@ -40,7 +72,7 @@ static void APIENTRY gl_debug_callback(GLenum source, GLenum type, GLuint id, GL
     }
 }
 
-GLuint gl_create_shader(int shaderType, char *shaderPath, BumpAllocator *transientStorage)
+GLuint gl_create_shader(int shaderType, const char *shaderPath, BumpAllocator *transientStorage)
 {
     int fileSize = 0;
     char *shaderHeader = read_file("src/engine_utils/shader_header.h", &fileSize, transientStorage); //  <-- Hardcoded file adress
@@ -83,6 +115,246 @@ GLuint gl_create_shader(int shaderType, char *shaderPath, BumpAllocator *transie
     return shaderID;
 }
 
+//? Compile and link a vertex + fragment shader, returns 0 on failure
+GLuint gl_create_program(const char *vertPath, const char *fragPath, BumpAllocator *transientStorage)
+{
+    GLuint vertShaderID = gl_create_shader(GL_VERTEX_SHADER, vertPath, transientStorage);
+    GLuint fragShaderID = gl_create_shader(GL_FRAGMENT_SHADER, fragPath, transientStorage);
+    if (!vertShaderID || !fragShaderID)
+    {
+        LOG_ERROR("Failed to create shader");
+        return 0;
+    }
+
+    GLuint programID = glCreateProgram();
+    glAttachShader(programID, vertShaderID);
+    glAttachShader(programID, fragShaderID);
+    glLinkProgram(programID);
+
+    glDetachShader(programID, vertShaderID);
+    glDetachShader(programID, fragShaderID);
+    glDeleteShader(vertShaderID);
+    glDeleteShader(fragShaderID);
+
+    // Validate if program works
+    {
+        int programSuccess;
+        char programInfoLog[512];
+        glGetProgramiv(programID, GL_LINK_STATUS, &programSuccess);
+
+        if (!programSuccess)
+        {
+            glGetProgramInfoLog(programID, 512, 0, programInfoLog);
+
+            LOG_ERROR("Failed to link program: %s", programInfoLog);
+            glDeleteProgram(programID);
+            return 0;
+        }
+    }
+
+    return programID;
+}
+
+long long gl_get_shader_timestamp(const char *vertPath, const char *fragPath)
+{
+    return max(get_timestamp(vertPath), get_timestamp(fragPath));
+}
+
+void gl_load_uniforms()
+{
+    glContext.screenSizeID = glGetUniformLocation(glContext.programID, "screenSize");
+    glContext.orthoProjectionID = glGetUniformLocation(glContext.programID, "orthoProjection");
+
+    glContext.tilemapOrthoProjectionID = glGetUniformLocation(glContext.tilemapProgramID, "orthoProjection");
+    glContext.tilemapLayerSizeID = glGetUniformLocation(glContext.tilemapProgramID, "layerSize");
+    glContext.tilemapTileSizeID = glGetUniformLocation(glContext.tilemapProgramID, "tileSize");
+    glContext.tilemapAtlasOriginsID = glGetUniformLocation(glContext.tilemapProgramID, "materialAtlasOrigins");
+    glContext.tilemapUseLightingID = glGetUniformLocation(glContext.tilemapProgramID, "useLighting");
+
+    glContext.particleOrthoProjectionID = glGetUniformLocation(glContext.particleProgramID, "orthoProjection");
+
+    // The tilemap lives in texture unit 1 and the lightmap in 2, the atlas stays in unit 0
+    glUseProgram(glContext.tilemapProgramID);
+    glUniform1i(glGetUniformLocation(glContext.tilemapProgramID, "tilemap"), 1);
+    glUniform1i(glGetUniformLocation(glContext.tilemapProgramID, "lightmap"), 2);
+    glUseProgram(glContext.programID);
+}
+
+//? Send the changed parts of a tile sized texture to the GPU.
+//? Tiles are stored column by column, so the texture is transposed:
+//? texture x is the tile row and texture y the tile column
+void gl_upload_tile_texture(GLuint textureID, GLenum internalFormat, GLenum format, int bytesPerTile,
+                            uint8_t *data, IVec2 size, IVec2 *textureSize, TileUploads &uploads)
+{
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    // Rows of 1 or 2 byte texels are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (uploads.uploadAll || size.x != textureSize->x || size.y != textureSize->y)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size.y, size.x,
+                     0, format, GL_UNSIGNED_BYTE, data);
+        *textureSize = size;
+        renderData->stats.bytesUploaded += size.x * size.y * bytesPerTile;
+    }
+    else
+    {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, size.y);
+        for (int idx = 0; idx < uploads.rects.count; idx++)
+        {
+            IRect region = uploads.rects[idx];
+            int minX = max(region.pos.x, 0);
+            int minY = max(region.pos.y, 0);
+            int maxX = min(region.pos.x + region.size.x, size.x);
+            int maxY = min(region.pos.y + region.size.y, size.y);
+            if (minX >= maxX || minY >= maxY)
+            {
+                continue;
+            }
+
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, minY);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, minX);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, minY, minX, maxY - minY, maxX - minX,
+                            format, GL_UNSIGNED_BYTE, data);
+            renderData->stats.bytesUploaded += (maxX - minX) * (maxY - minY) * bytesPerTile;
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    uploads.rects.clear();
+    uploads.uploadAll = false;
+}
+
+void gl_upload_tilemap(TilemapLayer &tilemap)
+{
+    if (!tilemap.tiles)
+    {
+        return;
+    }
+
+    glActiveTexture(GL_TEXTURE1);
+    gl_upload_tile_texture(glContext.tilemapTextureID, GL_RG8UI, GL_RG_INTEGER, 2, tilemap.tiles,
+                           tilemap.size, &glContext.tilemapTextureSize, tilemap.tileUploads);
+
+    if (tilemap.lightLevels)
+    {
+        glActiveTexture(GL_TEXTURE2);
+        gl_upload_tile_texture(glContext.lightmapTextureID, GL_R8UI, GL_RED_INTEGER, 1, tilemap.lightLevels,
+                               tilemap.size, &glContext.lightmapTextureSize, tilemap.lightUploads);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+//? Copies instances into the storage buffer, creating it the first time
+void gl_upload_region_buffer(GLuint *bufferID, Array<RenderTransform, MAX_REGION_INSTANCES> &instances)
+{
+    if (!*bufferID)
+    {
+        glGenBuffers(1, bufferID);
+    }
+
+    int size = sizeof(RenderTransform) * instances.count;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, *bufferID);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, instances.elements, GL_STATIC_DRAW);
+    renderData->stats.bytesUploaded += size;
+}
+
+bool gl_region_visible(RenderRegion &region, Rect cameraRect)
+{
+    return region.bounds.pos.x <= cameraRect.pos.x + cameraRect.size.x &&
+           region.bounds.pos.x + region.bounds.size.x >= cameraRect.pos.x &&
+           region.bounds.pos.y <= cameraRect.pos.y + cameraRect.size.y &&
+           region.bounds.pos.y + region.bounds.size.y >= cameraRect.pos.y;
+}
+
+//? Draws the cached region buffers that overlap the camera, a region is
+//? only uploaded again after the game rebuilt it
+void gl_render_regions(Rect cameraRect)
+{
+    for (int regionIdx = 0; regionIdx < renderData->regionCount; regionIdx++)
+    {
+        RenderRegion &region = renderData->regions[regionIdx];
+
+        if (region.dirty)
+        {
+            gl_upload_region_buffer(&glContext.regionSBOIDs[regionIdx], region.instances);
+            gl_upload_region_buffer(&glContext.regionWallSBOIDs[regionIdx], region.walls);
+            glContext.regionInstanceCounts[regionIdx] = region.instances.count;
+            glContext.regionWallCounts[regionIdx] = region.walls.count;
+            region.dirty = false;
+
+            renderData->stats.regionsUploaded++;
+        }
+
+        if (!glContext.regionInstanceCounts[regionIdx] || !gl_region_visible(region, cameraRect))
+        {
+            continue;
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glContext.regionSBOIDs[regionIdx]);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, glContext.regionInstanceCounts[regionIdx]);
+        renderData->stats.regionsDrawn++;
+    }
+
+    // Sprites use binding 0 again next frame
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glContext.transformSBOID);
+}
+
+//? Draws the walls of the regions that overlap the camera, gl_render_regions() uploaded them
+void gl_render_region_walls(Rect cameraRect)
+{
+    for (int regionIdx = 0; regionIdx < renderData->regionCount; regionIdx++)
+    {
+        RenderRegion &region = renderData->regions[regionIdx];
+        if (!gl_region_visible(region, cameraRect))
+        {
+            continue;
+        }
+        renderData->stats.wallsHidden += region.hiddenWalls;
+
+        if (!glContext.regionWallCounts[regionIdx])
+        {
+            continue;
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glContext.regionWallSBOIDs[regionIdx]);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, glContext.regionWallCounts[regionIdx]);
+        renderData->stats.wallsDrawn += glContext.regionWallCounts[regionIdx];
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glContext.transformSBOID);
+}
+
+//? Uploads the particles the game wrote this tick and draws a one pixel quad for each
+void gl_render_particles(Mat4 &orthoProjection)
+{
+    ParticleLayer &particles = renderData->particles;
+    if (!particles.count)
+    {
+        return;
+    }
+
+    // Orphaned every frame, the driver doesn't have to wait for last frame's draw
+    int size = sizeof(ParticleInstance) * particles.count;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, glContext.particleSBOID);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, particles.instances, GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, glContext.particleSBOID);
+    renderData->stats.bytesUploaded += size;
+
+    glUseProgram(glContext.particleProgramID);
+    glUniformMatrix4fv(glContext.particleOrthoProjectionID, 1, GL_FALSE, &orthoProjection.ax);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, particles.count);
+    renderData->stats.particlesDrawn = particles.count;
+
+    glUseProgram(glContext.programID);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, glContext.transformSBOID);
+}
+
 bool gl_init(BumpAllocator *transientStorage)
 {
     load_gl_functions();
@@ -92,29 +364,18 @@ bool gl_init(BumpAllocator *transientStorage)
     glEnable(GL_DEBUG_OUTPUT);
 
     //* Shader creation + hot reloading
-    GLuint vertShaderID = gl_create_shader(GL_VERTEX_SHADER,
-                                           "assets/shaders/quad.vert", transientStorage);
-    GLuint fragShaderID = gl_create_shader(GL_FRAGMENT_SHADER,
-                                           "assets/shaders/quad.frag", transientStorage);
-    if (!vertShaderID || !fragShaderID)
+    glContext.programID = gl_create_program(QUAD_VERT_PATH, QUAD_FRAG_PATH, transientStorage);
+    glContext.tilemapProgramID = gl_create_program(TILEMAP_VERT_PATH, TILEMAP_FRAG_PATH, transientStorage);
+    glContext.particleProgramID = gl_create_program(PARTICLE_VERT_PATH, PARTICLE_FRAG_PATH, transientStorage);
+    if (!glContext.programID || !glContext.tilemapProgramID || !glContext.particleProgramID)
     {
         LOG_ERROR("Failed to create shader");
         return false;
     }
 
-    long long timestampVert = get_timestamp("assets/shaders/quad.vert");
-    long long timestampFrag = get_timestamp("assets/shaders/quad.frag");
-    glContext.shaderTimestamp = max(timestampVert, timestampFrag);
-
-    glContext.programID = glCreateProgram();
-    glAttachShader(glContext.programID, vertShaderID);
-    glAttachShader(glContext.programID, fragShaderID);
-    glLinkProgram(glContext.programID);
-
-    glDetachShader(glContext.programID, vertShaderID);
-    glDetachShader(glContext.programID, fragShaderID);
-    glDeleteShader(vertShaderID);
-    glDeleteShader(fragShaderID);
+    glContext.shaderTimestamp = gl_get_shader_timestamp(QUAD_VERT_PATH, QUAD_FRAG_PATH);
+    glContext.tilemapShaderTimestamp = gl_get_shader_timestamp(TILEMAP_VERT_PATH, TILEMAP_FRAG_PATH);
+    glContext.particleShaderTimestamp = gl_get_shader_timestamp(PARTICLE_VERT_PATH, PARTICLE_FRAG_PATH);
 
     // This has to be done so GL will draw
     GLuint VAO;
@@ -151,6 +412,26 @@ bool gl_init(BumpAllocator *transientStorage)
 
         stbi_image_free(data);
     }
+    // Tilemap and lightmap textures, filled by gl_upload_tilemap()
+    {
+        glGenTextures(1, &glContext.tilemapTextureID);
+        glGenTextures(1, &glContext.lightmapTextureID);
+
+        GLuint textureIDs[2] = {glContext.tilemapTextureID, glContext.lightmapTextureID};
+        for (int idx = 0; idx < 2; idx++)
+        {
+            glActiveTexture(GL_TEXTURE1 + idx);
+            glBindTexture(GL_TEXTURE_2D, textureIDs[idx]);
+
+            // Integer textures can't be filtered
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        glActiveTexture(GL_TEXTURE0);
+    }
     // Transform Storage Buffer
     {
         glGenBuffers(1, &glContext.transformSBOID);
@@ -158,13 +439,14 @@ bool gl_init(BumpAllocator *transientStorage)
         glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(RenderTransform) * renderData->transforms.maxElements,
                      renderData->transforms.elements, GL_DYNAMIC_DRAW);
     }
-
-    // Uniforms
+    // Particle Storage Buffer, sized every frame by gl_render_particles()
     {
-        glContext.screenSizeID = glGetUniformLocation(glContext.programID, "screenSize");
-        glContext.orthoProjectionID = glGetUniformLocation(glContext.programID, "orthoProjection");
+        glGenBuffers(1, &glContext.particleSBOID);
     }
 
+    // Uniforms
+    gl_load_uniforms();
+
     // Tell GPU to use sRGB (otherwise color may be incorrect)
     glEnable(GL_FRAMEBUFFER_SRGB);
     glDisable(0x809D);
@@ -202,55 +484,56 @@ void gl_render(BumpAllocator *transientStorage)
     }
     //* Shader hot reloading
     {
-        long long timestampVert = get_timestamp("assets/shaders/quad.vert");
-        long long timestampFrag = get_timestamp("assets/shaders/quad.frag");
+        long long shaderTimestamp = gl_get_shader_timestamp(QUAD_VERT_PATH, QUAD_FRAG_PATH);
+        long long tilemapShaderTimestamp = gl_get_shader_timestamp(TILEMAP_VERT_PATH, TILEMAP_FRAG_PATH);
+        long long particleShaderTimestamp = gl_get_shader_timestamp(PARTICLE_VERT_PATH, PARTICLE_FRAG_PATH);
 
-        if (timestampVert > glContext.shaderTimestamp || timestampFrag > glContext.shaderTimestamp)
+        if (shaderTimestamp > glContext.shaderTimestamp)
         {
             LOG_INFO("Reloading shaders");
-            //* Shader creation + hot reloading
-            GLuint vertShaderID = gl_create_shader(GL_VERTEX_SHADER,
-                                                   "assets/shaders/quad.vert", transientStorage);
-            GLuint fragShaderID = gl_create_shader(GL_FRAGMENT_SHADER,
-                                                   "assets/shaders/quad.frag", transientStorage);
-            if (!vertShaderID || !fragShaderID)
+            GLuint programID = gl_create_program(QUAD_VERT_PATH, QUAD_FRAG_PATH, transientStorage);
+            if (!programID)
             {
-                LOG_ERROR("Failed to create shader");
                 return;
             }
-            GLuint programID = glCreateProgram();
-            glAttachShader(programID, vertShaderID);
-            glAttachShader(programID, fragShaderID);
-            glLinkProgram(programID);
-
-            glDetachShader(programID, vertShaderID);
-            glDetachShader(programID, fragShaderID);
-            glDeleteShader(vertShaderID);
-            glDeleteShader(fragShaderID);
 
-            // Validate if program works
+            glDeleteProgram(glContext.programID);
+            glContext.programID = programID;
+            glContext.shaderTimestamp = shaderTimestamp;
+            gl_load_uniforms();
+        }
+        if (tilemapShaderTimestamp > glContext.tilemapShaderTimestamp)
+        {
+            LOG_INFO("Reloading tilemap shaders");
+            GLuint programID = gl_create_program(TILEMAP_VERT_PATH, TILEMAP_FRAG_PATH, transientStorage);
+            if (!programID)
             {
-                int programSuccess;
-                char programInfoLog[512];
-                glGetProgramiv(programID, GL_LINK_STATUS, &programSuccess);
-
-                if (!programSuccess)
-                {
-                    glGetProgramInfoLog(programID, 512, 0, programInfoLog);
-
-                    LOG_ERROR("Failed to link program: %s", programInfoLog);
-                    return;
-                }
+                return;
             }
 
-            glDeleteProgram(glContext.programID);
-            glContext.programID = programID;
-            glUseProgram(programID);
+            glDeleteProgram(glContext.tilemapProgramID);
+            glContext.tilemapProgramID = programID;
+            glContext.tilemapShaderTimestamp = tilemapShaderTimestamp;
+            gl_load_uniforms();
+        }
+        if (particleShaderTimestamp > glContext.particleShaderTimestamp)
+        {
+            LOG_INFO("Reloading particle shaders");
+            GLuint programID = gl_create_program(PARTICLE_VERT_PATH, PARTICLE_FRAG_PATH, transientStorage);
+            if (!programID)
+            {
+                return;
+            }
 
-            glContext.shaderTimestamp = max(timestampVert, timestampFrag);
+            glDeleteProgram(glContext.particleProgramID);
+            glContext.particleProgramID = programID;
+            glContext.particleShaderTimestamp = particleShaderTimestamp;
+            gl_load_uniforms();
         }
     }
 
+    renderData->stats = {};
+
     glClearColor(119.0f / 255.0f, 33.0f / 255.0f, 111.0f / 255.0f, 1.0f);
     glClearDepth(0.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -261,24 +544,62 @@ void gl_render(BumpAllocator *transientStorage)
     glUniform2fv(glContext.screenSizeID, 1, &screenSize.x);
 
     //* Game Orthographic Projection
-    {
-        OrthographicCamera2D camera = renderData->gameCamera;
-        Mat4 orthoProjection = orthographic_projection(camera.position.x - camera.dimensions.x / 2.0f,
-                                                       camera.position.x + camera.dimensions.x / 2.0f,
-                                                       camera.position.y - camera.dimensions.y / 2.0f,
-                                                       camera.position.y + camera.dimensions.y / 2.0f);
-        glUniformMatrix4fv(glContext.orthoProjectionID, 1, GL_FALSE, &orthoProjection.ax);
-    }
+    OrthographicCamera2D camera = renderData->gameCamera;
+    Vec2 viewSize = camera.dimensions / camera.zoom; // A zoom above 1 sees less of the world
+    Mat4 orthoProjection = orthographic_projection(camera.position.x - viewSize.x / 2.0f,
+                                                   camera.position.x + viewSize.x / 2.0f,
+                                                   camera.position.y - viewSize.y / 2.0f,
+                                                   camera.position.y + viewSize.y / 2.0f);
+    glUniformMatrix4fv(glContext.orthoProjectionID, 1, GL_FALSE, &orthoProjection.ax);
 
     // Opaque Object
     {
         // Copy transform to the GPU
         glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(RenderTransform) * renderData->transforms.count,
                         renderData->transforms.elements);
+        renderData->stats.bytesUploaded += sizeof(RenderTransform) * renderData->transforms.count;
 
         glDrawArraysInstanced(GL_TRIANGLES, 0, 6, renderData->transforms.count);
 
         // restet for next frame
         renderData->transforms.clear();
     }
+
+    // Particles, in front of everything but the sprites
+    {
+        gl_render_particles(orthoProjection);
+    }
+
+    // Tile overlays, drawn before the tile layer so they end up on top of it
+    {
+        gl_render_regions(get_camera_rect(camera));
+    }
+
+    // Tile layer, one quad over the whole layer. Drawn after the sprites so
+    // the depth test keeps sprites in front of the tiles
+    {
+        TilemapLayer &tilemap = renderData->tilemap;
+        gl_upload_tilemap(tilemap);
+
+        if (tilemap.tiles)
+        {
+            glUseProgram(glContext.tilemapProgramID);
+
+            Vec2 layerSize = vec_2(tilemap.size * tilemap.tileSize);
+            glUniformMatrix4fv(glContext.tilemapOrthoProjectionID, 1, GL_FALSE, &orthoProjection.ax);
+            glUniform2fv(glContext.tilemapLayerSizeID, 1, &layerSize.x);
+            glUniform1i(glContext.tilemapTileSizeID, tilemap.tileSize);
+            glUniform1i(glContext.tilemapUseLightingID, tilemap.lightLevels != nullptr);
+            glUniform2iv(glContext.tilemapAtlasOriginsID, MAX_TILE_MATERIALS, &tilemap.materialAtlasOrigins[0].x);
+
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+
+            glUseProgram(glContext.programID);
+        }
+    }
+
+    // Background walls, drawn last so every layer above hides them
+    {
+        gl_render_region_walls(get_camera_rect(camera));
+    }
 }
@@ -18,6 +18,7 @@ static PFNGLUNIFORM1FPROC glUniform1f_ptr;
 static PFNGLUNIFORM2FVPROC glUniform2fv_ptr;
 static PFNGLUNIFORM3FVPROC glUniform3fv_ptr;
 static PFNGLUNIFORM1IPROC glUniform1i_ptr;
+static PFNGLUNIFORM2IVPROC glUniform2iv_ptr;
 static PFNGLUNIFORMMATRIX4FVPROC glUniformMatrix4fv_ptr;
 static PFNGLVERTEXATTRIBDIVISORPROC glVertexAttribDivisor_ptr;
 static PFNGLACTIVETEXTUREPROC glActiveTexture_ptr;
@@ -76,6 +77,7 @@ void load_gl_functions()
   glUniform2fv_ptr = (PFNGLUNIFORM2FVPROC) platform_load_gl_function("glUniform2fv");
   glUniform3fv_ptr = (PFNGLUNIFORM3FVPROC) platform_load_gl_function("glUniform3fv");
   glUniform1i_ptr = (PFNGLUNIFORM1IPROC) platform_load_gl_function("glUniform1i");
+  glUniform2iv_ptr = (PFNGLUNIFORM2IVPROC) platform_load_gl_function("glUniform2iv");
   glUniformMatrix4fv_ptr = (PFNGLUNIFORMMATRIX4FVPROC) platform_load_gl_function("glUniformMatrix4fv");
   glVertexAttribDivisor_ptr = (PFNGLVERTEXATTRIBDIVISORPROC) platform_load_gl_function("glVertexAttribDivisor");
   glActiveTexture_ptr = (PFNGLACTIVETEXTUREPROC) platform_load_gl_function("glActiveTexture");
@@ -178,6 +180,11 @@ void glUniform1i(GLint location, GLint v0)
     glUniform1i_ptr(location, v0);
 }
 
+void glUniform2iv(GLint location, GLsizei count, const GLint* value)
+{
+    glUniform2iv_ptr(location, count, value);
+}
+
 void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
 {
     glUniformMatrix4fv_ptr(location, count, transpose, value);
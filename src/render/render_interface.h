@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "../engine_utils/assets.h"
 #include "../engine_utils/shader_header.h"
 #include "../vaultEngine_lib.h"
@@ -8,6 +10,16 @@
 int RENDER_OPTION_FLIP_X = BIT(0);
 int RENDER_OPTION_FLIP_Y = BIT(1);
 
+constexpr int MAX_TILEMAP_UPLOADS = 64;
+
+constexpr int RENDER_REGION_SIZE = 16; // In tiles
+#ifdef BENCH_WORLD_TILES
+constexpr int MAX_RENDER_REGIONS = (BENCH_WORLD_TILES / RENDER_REGION_SIZE + 1) * (BENCH_WORLD_TILES / RENDER_REGION_SIZE + 1);
+#else
+constexpr int MAX_RENDER_REGIONS = 256;
+#endif
+constexpr int MAX_REGION_INSTANCES = RENDER_REGION_SIZE * RENDER_REGION_SIZE; // Per layer
+
 // ################################     Render Structs   ################################
 struct OrthographicCamera2D
 {
@@ -21,12 +33,71 @@ struct DrawData
     int renderOptions;
 };
 
+// Regions (in tiles) of a tile sized texture that changed since the last upload
+struct TileUploads
+{
+    Array<IRect, MAX_TILEMAP_UPLOADS> rects;
+    bool uploadAll;
+};
+
+// The tile layer is drawn as one quad that looks up a tilemap texture,
+// only the regions listed in the uploads are sent to the GPU again
+struct TilemapLayer
+{
+    // Stored column by column, same layout as the worldGrid so it can be uploaded without a copy
+    uint8_t *tiles;       // 2 bytes per tile (materialID, neighbourMask)
+    uint8_t *lightLevels; // 1 byte per tile [0; MAX_LIGHT_LEVEL]
+    IVec2 size;           // In tiles
+    int tileSize;
+    IVec2 materialAtlasOrigins[MAX_TILE_MATERIALS];
+
+    TileUploads tileUploads;
+    TileUploads lightUploads;
+};
+
+// Per tile instances (overlays, cracks) for a block of tiles. The renderer keeps
+// one GPU buffer per region and only uploads it again when the game marks it dirty
+struct RenderRegion
+{
+    Rect bounds; // In world pixels, used for culling
+    bool dirty;
+    Array<RenderTransform, MAX_REGION_INSTANCES> instances;
+    Array<RenderTransform, MAX_REGION_INSTANCES> walls; // Drawn behind the tile layer
+    int hiddenWalls; // Left out because the tile in front covers them
+};
+
+// Live particles, written by the game straight into its own memory.
+// Uploaded as they are every frame, nothing is copied on the CPU
+struct ParticleLayer
+{
+    ParticleInstance *instances;
+    int count;
+};
+
+// Filled by the renderer every frame
+struct RenderStats
+{
+    int bytesUploaded;
+    int regionsUploaded;
+    int regionsDrawn;
+    int wallsDrawn;
+    int wallsHidden; // In the regions that were drawn
+    int particlesDrawn;
+};
+
 struct RenderData
 {
     OrthographicCamera2D gameCamera;
     OrthographicCamera2D uiCamera;
 
     Array<RenderTransform, 1000> transforms;
+    TilemapLayer tilemap;
+    ParticleLayer particles;
+
+    int regionCount;
+    RenderRegion regions[MAX_RENDER_REGIONS];
+
+    RenderStats stats;
 };
 
 // ################################     Render Globals   ################################
@@ -36,24 +107,36 @@ static RenderData *renderData;
 IVec2 screen_to_world(IVec2 screenPos)
 {
     OrthographicCamera2D camera = renderData->gameCamera;
+    Vec2 viewSize = camera.dimensions / camera.zoom;
 
     int xPos = (float)screenPos.x /
                (float)input->screenSize.x *
-               camera.dimensions.x; // [0; dimensions.x]
+               viewSize.x; // [0; viewSize.x]
 
     // Offset using dimensions and position
-    xPos += -camera.dimensions.x / 2.0f + camera.position.x;
+    xPos += -viewSize.x / 2.0f + camera.position.x;
 
     int yPos = (float)screenPos.y /
                (float)input->screenSize.y *
-               camera.dimensions.y; // [0; dimensions.y]
+               viewSize.y; // [0; viewSize.y]
 
     // Offset using dimensions and position
-    yPos += camera.dimensions.y / 2.0f + camera.position.y;
+    yPos += viewSize.y / 2.0f + camera.position.y;
 
     return {xPos, yPos};
 }
 
+//? The part of the world (in pixels) the camera sees.
+//? The projection flips y, so a camera at position.y looks at -position.y
+Rect get_camera_rect(OrthographicCamera2D camera)
+{
+    Rect rect;
+    rect.size = camera.dimensions / camera.zoom;
+    rect.pos = {camera.position.x - rect.size.x / 2.0f,
+                -camera.position.y - rect.size.y / 2.0f};
+    return rect;
+}
+
 //? return a index for which frame a animation should have
 int animate_spritesheet(float *time, int frameCount, float duration = 1.0f)
 {
@@ -71,6 +154,34 @@ int animate_spritesheet(float *time, int frameCount, float duration = 1.0f)
 }
 
 // ################################     Render Functions   ################################
+//? Queue a region (in tiles) to be uploaded before the next draw
+void tile_uploads_mark_dirty(TileUploads &uploads, IRect region)
+{
+    if (uploads.uploadAll)
+    {
+        return;
+    }
+
+    // Too many small uploads, just send everything
+    if (uploads.rects.is_full())
+    {
+        uploads.rects.clear();
+        uploads.uploadAll = true;
+        return;
+    }
+    uploads.rects.add(region);
+}
+
+void tilemap_mark_dirty(IRect region)
+{
+    tile_uploads_mark_dirty(renderData->tilemap.tileUploads, region);
+}
+
+void lightmap_mark_dirty(IRect region)
+{
+    tile_uploads_mark_dirty(renderData->tilemap.lightUploads, region);
+}
+
 void draw_quad(RenderTransform transform)
 {
     renderData->transforms.add(transform);
@@ -8,6 +8,16 @@
 #include <sys/stat.h> //edit timestamp of files
 #include <math.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h> //memory mapped files
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 // ################################     Constants    ################################
 // WAV Files
 constexpr int NUM_CHANNELS = 2;
@@ -231,6 +241,23 @@ bool file_exists(const char *filePath)
   return true;
 }
 
+//? Moves newFilePath over filePath in one step, readers see either the old or the new file
+bool replace_file(const char *newFilePath, const char *filePath)
+{
+  LOG_ASSERT(newFilePath && filePath, "No filePath supplied!");
+
+#ifdef _WIN32
+  bool replaced = MoveFileExA(newFilePath, filePath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+  bool replaced = !rename(newFilePath, filePath);
+#endif
+  if (!replaced)
+  {
+    LOG_ERROR("Failed replacing File: %s", filePath);
+  }
+  return replaced;
+}
+
 long get_file_size(const char *filePath)
 {
   LOG_ASSERT(filePath, "No filePath supplied!");
@@ -352,6 +379,199 @@ bool copy_file(const char *fileName, const char *outputName, BumpAllocator *bump
 }
 #pragma endregion
 
+// ################################     Memory Mapped Files    ################################
+#pragma region
+/*
+ * The whole file is mapped into memory, pages are only read
+ * from disk when they are touched. Resizing the file moves
+ * the mapping, pointers into data have to be fetched again
+ */
+struct MappedFile
+{
+  char *data;
+  long long size;
+  bool writable;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#else
+  int file;
+#endif
+};
+
+bool map_file_view(MappedFile *mappedFile)
+{
+  mappedFile->data = nullptr;
+  if (!mappedFile->size)
+  {
+    return true;
+  }
+
+#ifdef _WIN32
+  mappedFile->mapping = CreateFileMappingA(mappedFile->file, 0, mappedFile->writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, 0);
+  if (!mappedFile->mapping)
+  {
+    return false;
+  }
+  mappedFile->data = (char *)MapViewOfFile(mappedFile->mapping, mappedFile->writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+#else
+  void *data = mmap(0, mappedFile->size, mappedFile->writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, mappedFile->file, 0);
+  mappedFile->data = data == MAP_FAILED ? nullptr : (char *)data;
+#endif
+  return mappedFile->data;
+}
+
+void unmap_file_view(MappedFile *mappedFile)
+{
+#ifdef _WIN32
+  if (mappedFile->data)
+  {
+    UnmapViewOfFile(mappedFile->data);
+  }
+  if (mappedFile->mapping)
+  {
+    CloseHandle(mappedFile->mapping);
+  }
+  mappedFile->mapping = 0;
+#else
+  if (mappedFile->data)
+  {
+    munmap(mappedFile->data, mappedFile->size);
+  }
+#endif
+  mappedFile->data = nullptr;
+}
+
+void unmap_file(MappedFile *mappedFile)
+{
+  unmap_file_view(mappedFile);
+#ifdef _WIN32
+  if (mappedFile->file != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(mappedFile->file);
+  }
+  mappedFile->file = INVALID_HANDLE_VALUE;
+#else
+  if (mappedFile->file >= 0)
+  {
+    close(mappedFile->file);
+  }
+  mappedFile->file = -1;
+#endif
+}
+
+/*
+ * Writable files are created if they don't exist. An empty
+ * file has no data until it is resized
+ */
+bool map_file(const char *filePath, bool writable, MappedFile *mappedFile)
+{
+  LOG_ASSERT(filePath, "No filePath supplied!");
+  LOG_ASSERT(mappedFile, "No mappedFile supplied!");
+
+  *mappedFile = {};
+  mappedFile->writable = writable;
+
+#ifdef _WIN32
+  mappedFile->file = CreateFileA(filePath, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, 0,
+                                 writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  LARGE_INTEGER fileSize = {};
+  if (mappedFile->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(mappedFile->file, &fileSize))
+  {
+    LOG_ERROR("Failed opening File: %s", filePath);
+    unmap_file(mappedFile);
+    return false;
+  }
+  mappedFile->size = fileSize.QuadPart;
+#else
+  mappedFile->file = open(filePath, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+  struct stat fileStat = {};
+  if (mappedFile->file < 0 || fstat(mappedFile->file, &fileStat))
+  {
+    LOG_ERROR("Failed opening File: %s", filePath);
+    unmap_file(mappedFile);
+    return false;
+  }
+  mappedFile->size = fileStat.st_size;
+#endif
+
+  if (!map_file_view(mappedFile))
+  {
+    LOG_ERROR("Failed mapping File: %s", filePath);
+    unmap_file(mappedFile);
+    return false;
+  }
+  return true;
+}
+
+//? Grows or shrinks the file, new bytes are 0
+bool resize_mapped_file(MappedFile *mappedFile, long long size)
+{
+  LOG_ASSERT(mappedFile->writable, "Can't resize a read only file");
+
+  unmap_file_view(mappedFile);
+#ifdef _WIN32
+  LARGE_INTEGER fileSize = {};
+  fileSize.QuadPart = size;
+  bool resized = SetFilePointerEx(mappedFile->file, fileSize, 0, FILE_BEGIN) && SetEndOfFile(mappedFile->file);
+#else
+  bool resized = !ftruncate(mappedFile->file, size);
+#endif
+  if (resized)
+  {
+    mappedFile->size = size;
+  }
+
+  if (!map_file_view(mappedFile) || !resized)
+  {
+    LOG_ERROR("Failed resizing mapped File to %lld bytes", size);
+    return false;
+  }
+  return true;
+}
+
+//? Writes the changed pages in [offset, offset + size) to disk and waits for it
+void flush_mapped_file(MappedFile *mappedFile, long long offset, long long size)
+{
+  if (!mappedFile->data || size <= 0)
+  {
+    return;
+  }
+
+#ifdef _WIN32
+  FlushViewOfFile(mappedFile->data + offset, size);
+  FlushFileBuffers(mappedFile->file);
+#else
+  // msync wants the start on a page
+  long long pageSize = sysconf(_SC_PAGESIZE);
+  long long start = offset - offset % pageSize;
+  msync(mappedFile->data + start, offset + size - start, MS_SYNC);
+#endif
+}
+
+/*
+ * Drops the pages in [offset, offset + size) from the process,
+ * they are read again when touched. Keeps the memory of
+ * walking over a huge file bounded
+ */
+void release_mapped_pages(MappedFile *mappedFile, long long offset, long long size)
+{
+  if (!mappedFile->data || size <= 0)
+  {
+    return;
+  }
+
+#ifdef _WIN32
+  // Unlocking pages that aren't locked takes them out of the working set
+  VirtualUnlock(mappedFile->data + offset, size);
+#else
+  long long pageSize = sysconf(_SC_PAGESIZE);
+  long long start = offset - offset % pageSize;
+  madvise(mappedFile->data + start, offset + size - start, MADV_DONTNEED);
+#endif
+}
+#pragma endregion
+
 // ################################     Math    ################################
 #pragma region
 int sign(int x)
@@ -497,6 +717,109 @@ IVec2 lerp(IVec2 a, IVec2 b, float t)
   return result;
 }
 
+// 16.16 fixed point, integer math gives the same bits on every machine and with
+// every compiler flag. Floats and ints convert implicitly, so code written for
+// float mostly compiles for Fixed as well
+constexpr int FIXED_SHIFT = 16;
+constexpr int FIXED_ONE = 1 << FIXED_SHIFT;
+
+struct Fixed
+{
+  int32_t raw;
+
+  Fixed() = default;
+  Fixed(int value) : raw(value * FIXED_ONE) {}
+  Fixed(float value) : raw((int32_t)roundf(value * FIXED_ONE)) {}
+
+  static Fixed from_raw(int32_t raw)
+  {
+    Fixed result;
+    result.raw = raw;
+    return result;
+  }
+
+  float to_float() const
+  {
+    return raw * (1.0f / FIXED_ONE);
+  }
+
+  Fixed operator+(Fixed other) const
+  {
+    return from_raw(raw + other.raw);
+  }
+
+  Fixed operator-(Fixed other) const
+  {
+    return from_raw(raw - other.raw);
+  }
+
+  Fixed operator-() const
+  {
+    return from_raw(-raw);
+  }
+
+  Fixed operator*(Fixed other) const
+  {
+    return from_raw((int32_t)(((int64_t)raw * other.raw) >> FIXED_SHIFT));
+  }
+
+  Fixed operator/(Fixed other) const
+  {
+    return from_raw((int32_t)(((int64_t)raw << FIXED_SHIFT) / other.raw));
+  }
+
+  Fixed &operator+=(Fixed other)
+  {
+    raw += other.raw;
+    return *this;
+  }
+
+  Fixed &operator-=(Fixed other)
+  {
+    raw -= other.raw;
+    return *this;
+  }
+
+  bool operator<(Fixed other) const { return raw < other.raw; }
+  bool operator>(Fixed other) const { return raw > other.raw; }
+  bool operator<=(Fixed other) const { return raw <= other.raw; }
+  bool operator>=(Fixed other) const { return raw >= other.raw; }
+  bool operator==(Fixed other) const { return raw == other.raw; }
+  bool operator!=(Fixed other) const { return raw != other.raw; }
+};
+
+//? Nearest whole number, halves away from zero like roundf()
+int round(Fixed value)
+{
+  int32_t half = FIXED_ONE / 2;
+  return value.raw >= 0 ? (value.raw + half) >> FIXED_SHIFT : -((-value.raw + half) >> FIXED_SHIFT);
+}
+
+Fixed approach(Fixed current, Fixed target, Fixed increase)
+{
+  if (current < target)
+  {
+    Fixed next = current + increase;
+    return next < target ? next : target;
+  }
+  Fixed next = current - increase;
+  return next > target ? next : target;
+}
+
+// Movement math runs on SimFloat. Building with -DFIXED_SIMULATION makes it
+// Fixed, so replays and runs on other machines stay bit exact
+#ifdef FIXED_SIMULATION
+typedef Fixed SimFloat;
+#else
+typedef float SimFloat;
+#endif
+
+struct SimVec2
+{
+  SimFloat x;
+  SimFloat y;
+};
+
 struct Vec4
 {
   union